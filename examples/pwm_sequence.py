@@ -0,0 +1,28 @@
+# -*- coding: utf-8 -*-
+"""Frequency sweep run by the on-device setpoint sequencer
+
+Other than pwm_test.py, the step timing does not depend on the network.
+"""
+import requests
+
+host = "http://192.168.4.1"
+
+# Durations in seconds, frequency in kHz, duty in %, dead-times in ns.
+# Omitted values are left unchanged.
+steps = [
+    {"duration": 2.0, "frequency": 500},
+    {"duration": 2.0, "frequency": 100},
+]
+
+def upload(steps=steps):
+    response = requests.post(host + "/sequence", json=steps)
+    print(response, response.text)
+
+def start(loop=False):
+    requests.get(host + "/cmd", {"set_sequencer_loop": "true" if loop else "false"})
+    response = requests.get(host + "/cmd", {"sequencer_start": ""})
+    print(response)
+
+def stop():
+    response = requests.get(host + "/cmd", {"sequencer_stop": ""})
+    print(response)
@@ -0,0 +1,71 @@
+# -*- coding: utf-8 -*-
+"""Polling the application state as compact binary telegram
+
+Keys, types and scales of the values are read from the /state.schema
+endpoint. Decoded values are in the same units as in the JSON telegram.
+The same telegram is sent base64-encoded as "hw_app_state_bin" event
+on the /events_bin Server-Sent Events endpoint.
+"""
+import base64
+import struct
+import time
+
+import requests
+
+host = "http://192.168.4.1"
+
+SUPPORTED_FORMAT_VERSION = 1
+HEADER = struct.Struct("<BxHI")
+TYPE_FORMATS = {"bool": "?", "u8": "B", "u32": "I", "f32": "f"}
+
+
+class StateDecoder:
+    def __init__(self, schema):
+        if schema["version"] != SUPPORTED_FORMAT_VERSION:
+            raise ValueError(f"Unsupported state telegram version: {schema['version']}")
+        self.schema = schema
+        self.fields = schema["fields"]
+        self.values = struct.Struct(
+            "<" + "".join(TYPE_FORMATS[field["type"]] for field in self.fields))
+
+    def decode(self, data):
+        """Decode a binary telegram given as bytes into a dict.
+        Raises ValueError when the telegram does not match the schema,
+        e.g. after a firmware update. Fetch the schema again in this case.
+        """
+        if len(data) != HEADER.size + self.values.size:
+            raise ValueError("State telegram does not match the schema")
+        version, n_fields, schema_hash = HEADER.unpack_from(data)
+        if (version != self.schema["version"] or n_fields != len(self.fields)
+                or schema_hash != self.schema["hash"]):
+            raise ValueError("State telegram does not match the schema")
+        state = {}
+        for field, value in zip(self.fields, self.values.unpack_from(data, HEADER.size)):
+            if field["type"] == "f32" or (field["type"] == "u32" and field["scale"] != 1):
+                value = round(value * field["scale"], field["decimals"])
+            state[field["key"]] = value
+        return state
+
+    def decode_base64(self, text):
+        return self.decode(base64.b64decode(text))
+
+
+def get_decoder(session=requests):
+    response = session.get(host + "/state.schema")
+    response.raise_for_status()
+    return StateDecoder(response.json())
+
+def get_state(decoder, session=requests):
+    response = session.get(host + "/state.bin")
+    response.raise_for_status()
+    return decoder.decode(response.content)
+
+def poll(n=100):
+    """Poll the state n times and print the achieved rate"""
+    with requests.Session() as session:
+        decoder = get_decoder(session)
+        t_start = time.perf_counter()
+        for _ in range(n):
+            state = get_state(decoder, session)
+        t_end = time.perf_counter()
+    print(f"{n / (t_end - t_start):.1f} telegrams/s, last: {state}")
@@ -0,0 +1,65 @@
+/* Debug build option counting the heap allocations of a task
+ *
+ * License: GPL v.3
+ */
+#include "alloc_counter.hpp"
+
+#ifdef COUNT_HEAP_ALLOCATIONS
+#include <cstddef>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+
+namespace {
+// Written by the counted task only
+volatile TaskHandle_t counted_task = nullptr;
+volatile uint32_t count = 0;
+
+inline void count_allocation() {
+    // Before the scheduler is started, there is no current task
+    if (counted_task && xTaskGetCurrentTaskHandle() == counted_task) {
+        count = count + 1;
+    }
+}
+} // namespace
+
+void AllocCounter::start() {
+    count = 0;
+    counted_task = xTaskGetCurrentTaskHandle();
+}
+
+uint32_t AllocCounter::get_count() {
+    return count;
+}
+
+uint32_t AllocCounter::stop() {
+    counted_task = nullptr;
+    return count;
+}
+
+// Linker wrappers, see main/CMakeLists.txt
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    count_allocation();
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    count_allocation();
+    return __real_calloc(n, size);
+}
+
+// Also counted when the block is only resized
+void *__wrap_realloc(void *ptr, size_t size) {
+    if (size) {
+        count_allocation();
+    }
+    return __real_realloc(ptr, size);
+}
+}
+#endif
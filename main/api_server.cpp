@@ -6,12 +6,18 @@
  * License: GPL v.3 
  * U. Lukas 2020-11-18
  */
+#include <cstdio>
+#include <cstring>
+
 #include <Update.h>
 #include <SPIFFS.h>
 #include "esp_spiffs.h"
+#include "esp_timer.h"
 
 #include "api_server.hpp"
 #include "http_content.hpp"
+#include "fixed_point_format.hpp"
+#include "alloc_counter.hpp"
 
 #undef LOG_LOCAL_LEVEL
 #define LOG_LOCAL_LEVEL ESP_LOG_INFO
@@ -23,10 +29,16 @@ static const char* TAG = "APIServer";
 APIServer::APIServer(AsyncWebServer* http_backend)
     : backend{http_backend}
     , event_source{nullptr}
+    , event_source_bin{nullptr}
+    , web_socket{nullptr}
+    , web_socket_bin{nullptr}
 {}
 
 APIServer::~APIServer() {
     delete event_source;
+    delete event_source_bin;
+    delete web_socket;
+    delete web_socket_bin;
 }
 
 /** Begin operation.
@@ -51,6 +63,9 @@ void APIServer::begin() {
     if (srv_conf.use_sse) {
         _add_event_source();
     }
+    if (srv_conf.ws_endpoint) {
+        _add_web_sockets();
+    }
 }
 
 // Set an entry in the template processor string <=> string mapping 
@@ -91,6 +106,39 @@ void APIServer::register_api_cb(const char* cmd_name, CbVoidT cmd_callback) {
     ESP_LOGI(TAG, "Registered void command: %s", cmd_name);
 }
 
+// Set a function handling "/cmd" request parameters before the cmd_map
+void APIServer::set_cmd_dispatcher(CmdDispatchFnT dispatch, void *context) {
+    _cmd_dispatch_context = context;
+    _cmd_dispatch = dispatch;
+}
+
+// Set a callback which is called when a client connects to the SSE source
+void APIServer::on_sse_client_connect(CbVoidT callback) {
+    _sse_on_connect_cb = callback;
+}
+
+// Any client of the JSON state channels may drop the next message
+bool APIServer::have_full_client_queue() {
+    if (event_source) {
+        // Sum of all queue lengths, rounded up
+        const auto n_clients = event_source->count();
+        if ((event_source->avgPacketsWaiting() + 1) * n_clients >= SSE_MAX_QUEUED_MESSAGES) {
+            return true;
+        }
+    }
+    return web_socket && !web_socket->availableForWriteAll();
+}
+
+// Set a callback for complete WebSocket text messages
+void APIServer::on_ws_message(CbWsMessageT callback) {
+    _ws_message_cb = callback;
+}
+
+// Set a callback returning additional Server-Timing metrics
+void APIServer::on_server_timing(CbTimingT callback) {
+    _server_timing_cb = callback;
+}
+
 
 ////// Implementation
 class AsyncWebRewriteAppCatchall : public AsyncWebRewrite
@@ -172,7 +220,7 @@ void APIServer::_add_handlers() {
 void APIServer::_add_event_source() {
     event_source = new AsyncEventSource(srv_conf.sse_endpoint);
     if (event_source) {
-        _register_sse_on_connect_callback();
+        _register_sse_on_connect_callback(event_source);
         // HTTP Basic Authentication
         //if (USE_AUTH) {
         //    event_source.setAuthentication(http_user, http_pass);
@@ -182,17 +230,85 @@ void APIServer::_add_event_source() {
         ESP_LOGE(TAG, "Event Source could not be initialised!");
         abort();
     }
+    if (srv_conf.sse_bin_endpoint) {
+        event_source_bin = new AsyncEventSource(srv_conf.sse_bin_endpoint);
+        if (!event_source_bin) {
+            ESP_LOGE(TAG, "Binary Event Source could not be initialised!");
+            abort();
+        }
+        _register_sse_on_connect_callback(event_source_bin);
+        backend->addHandler(event_source_bin);
+    }
 }
 
 // Sends "Hello" message when a client connects to the Server-Sent Event Source
-void APIServer::_register_sse_on_connect_callback() {
-    event_source->onConnect([](AsyncEventSourceClient *client) {
+void APIServer::_register_sse_on_connect_callback(AsyncEventSource *source) {
+    source->onConnect([this](AsyncEventSourceClient *client) {
         if(client->lastId()){
             ESP_LOGI(TAG, "Client connected! Last msg ID: %d", client->lastId());
         }
         // Send confirmation message via SSE source when connection has been
         // established, ID is current millis. Set reconnect delay to 1 second.
         client->send("Hello Message from ESP32!", NULL, millis(), 1000);
+        if (_sse_on_connect_cb) {
+            _sse_on_connect_cb();
+        }
+    });
+}
+
+// Activate the WebSockets if srv_conf.ws_endpoint is set
+void APIServer::_add_web_sockets() {
+    web_socket = new AsyncWebSocket(srv_conf.ws_endpoint);
+    if (!web_socket) {
+        ESP_LOGE(TAG, "WebSocket could not be initialised!");
+        abort();
+    }
+    _register_ws_event_callback(web_socket);
+    backend->addHandler(web_socket);
+    if (srv_conf.ws_bin_endpoint) {
+        web_socket_bin = new AsyncWebSocket(srv_conf.ws_bin_endpoint);
+        if (!web_socket_bin) {
+            ESP_LOGE(TAG, "Binary WebSocket could not be initialised!");
+            abort();
+        }
+        _register_ws_event_callback(web_socket_bin);
+        backend->addHandler(web_socket_bin);
+    }
+}
+
+// Passes complete text messages on to the on_ws_message() callback.
+// Commands are short, so fragmented messages are not supported.
+void APIServer::_register_ws_event_callback(AsyncWebSocket *socket) {
+    socket->onEvent([this](AsyncWebSocket *server, AsyncWebSocketClient *client,
+                           AwsEventType type, void *arg, uint8_t *data, size_t len) {
+        switch (type) {
+        case WS_EVT_CONNECT:
+            ESP_LOGI(TAG, "WebSocket client %u connected to: %s",
+                     client->id(), server->url());
+            server->cleanupClients(srv_conf.ws_max_clients);
+            if (_sse_on_connect_cb) {
+                _sse_on_connect_cb();
+            }
+            break;
+        case WS_EVT_DISCONNECT:
+            ESP_LOGI(TAG, "WebSocket client %u disconnected", client->id());
+            break;
+        case WS_EVT_DATA: {
+            const auto info = static_cast<AwsFrameInfo*>(arg);
+            if (!info->final || info->index != 0 || info->len != len
+                    || info->opcode != WS_TEXT) {
+                ESP_LOGW(TAG, "Ignoring fragmented or binary WebSocket message");
+                break;
+            }
+            if (_ws_message_cb) {
+                _ws_message_cb(client, std::string_view{
+                    reinterpret_cast<const char*>(data), len});
+            }
+            break;
+        }
+        default:
+            break;
+        }
     });
 }
 
@@ -216,30 +332,47 @@ void APIServer::_on_root_request(AsyncWebServerRequest *request) {
 }
 
 // on("/cmd")
+//
+// Parameter names and values are passed to the dispatcher as views of the
+// request parameters, so dispatching and value parsing do not allocate.
 void APIServer::_on_cmd_request(AsyncWebServerRequest *request) {
+    const auto t_start_us = esp_timer_get_time();
+    AllocCounter::start();
     auto n_params = request->params();
     ESP_LOGD(TAG, "Number of parameters received: %d", n_params);
+    // Nothing is applied if any of the values is invalid
     for (size_t i = 0; i < n_params; ++i) {
-        auto p = request->getParam(i);
-        const auto &name = p->name();
-        const auto &value_str = p->value();
-        ESP_LOGD(TAG, "-->Param name: %s  with value: %s", name.c_str(), value_str.c_str());
-        auto cb_iterator = cmd_map.find(name);
-        if (cb_iterator == cmd_map.end()) {
-            ESP_LOGE(TAG, "Error: Not registered in command mapping: %s", name.c_str());
-            continue;
+        auto param = request->getParam(i);
+        if (_dispatch_cmd(param, false) == ESP_ERR_INVALID_ARG) {
+            AllocCounter::stop();
+            ESP_LOGE(TAG, "Invalid value for: %s", param->name().c_str());
+            char text[64];
+            snprintf(text, sizeof(text), "Invalid value for: %s", param->name().c_str());
+            request->send(400, "text/plain", text);
+            return;
         }
-        auto cmd_callback = (*cb_iterator).second; // = cmd_map[name];
-        if (!cmd_callback) {
-            ESP_LOGE(TAG, "Error: Not a callable object!: %s", name.c_str());
-            continue;
-        }
-        // Finally call callback
-        cmd_callback(value_str);
     }
+    for (size_t i = 0; i < n_params; ++i) {
+        _dispatch_cmd(request->getParam(i), true);
+    }
+    const auto n_dispatch_allocs = AllocCounter::get_count();
     if (srv_conf.api_is_ajax) {
         // For AJAX interface: Return a plain string, default is empty string.
-        request->send(200, "text/plain", srv_conf.ajax_return_text);
+        auto response = request->beginResponse(200, "text/plain",
+                                               srv_conf.ajax_return_text);
+        if (srv_conf.server_timing_header) {
+            // Server-Timing durations are in milliseconds
+            auto dispatch_ms = (esp_timer_get_time() - t_start_us) * 1e-3f;
+            char timing[192];
+            auto len = snprintf(timing, sizeof(timing), "dispatch;dur=%s",
+                                FixedPoint::Text{dispatch_ms, 3}.c_str());
+            if (_server_timing_cb && len + 2 < static_cast<int>(sizeof(timing))) {
+                strcpy(timing + len, ", ");
+                _server_timing_cb(timing + len + 2, sizeof(timing) - len - 2);
+            }
+            response->addHeader("Server-Timing", timing);
+        }
+        request->send(response);
     } else if (!srv_conf.serve_static_from_spiffs) {
         // Static content is handled by default handler for static content
         if (srv_conf.template_processing_activated) {
@@ -252,6 +385,40 @@ void APIServer::_on_cmd_request(AsyncWebServerRequest *request) {
             request->send_P(200, "text/html", api_return_html);
         }
     }
+    const auto n_allocs = AllocCounter::stop();
+    if (AllocCounter::enabled) {
+        ESP_LOGI(TAG, "Heap allocations of /cmd dispatch: %u, incl. response: %u",
+                 n_dispatch_allocs, n_allocs);
+    }
+}
+
+// Check or apply one "/cmd" request parameter using the dispatcher,
+// or the callbacks registered by register_api_cb()
+esp_err_t APIServer::_dispatch_cmd(const AsyncWebParameter *param, bool apply) {
+    const auto &name = param->name();
+    const auto &value = param->value();
+    ESP_LOGD(TAG, "-->Param name: %s  with value: %s", name.c_str(), value.c_str());
+    if (_cmd_dispatch) {
+        auto err = _cmd_dispatch(_cmd_dispatch_context,
+                                 std::string_view{name.c_str(), name.length()},
+                                 std::string_view{value.c_str(), value.length()},
+                                 apply);
+        if (err != ESP_ERR_NOT_FOUND) {
+            return err;
+        }
+    }
+    auto cb_iterator = cmd_map.find(name);
+    if (cb_iterator == cmd_map.end() || !cb_iterator->second) {
+        // Only reported once
+        if (apply) {
+            ESP_LOGE(TAG, "Error: Not registered in command mapping: %s", name.c_str());
+        }
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (apply) {
+        cb_iterator->second(value);
+    }
+    return ESP_OK;
 }
 
 // on("/update")
@@ -11,14 +11,26 @@
  * License: GPL v.3 
  * U. Lukas 2021-01-21
  */
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/timers.h"
-#include "freertos/event_groups.h"
 #include <Arduino.h>
+#include "AsyncJson.h"
+#include "mbedtls/base64.h"
 
 #include "ps_pwm.h"
 #include "app_controller.hpp"
+#include "api_cmd_table.hpp"
+#include "strict_parse.hpp"
+#include "fixed_point_format.hpp"
+#include "json_stream_writer.hpp"
+#include "fs_io.hpp"
 
 #undef LOG_LOCAL_LEVEL
 // When setting log level to ESP_LOG_DEBUG:
@@ -27,39 +39,56 @@
 #include "esp_log.h"
 static auto TAG = "AppController";
 
-/* Perform setpoint rate throttling, see definition at bottom of this file
- */
-bool throttle_value(float *x_current, float x_target, float x_increment);
-
-/** FreeRTOS event group bits definition for application event_task event loop
+/** FreeRTOS task notification bits definition for application event_task
+ * event loop. These are used like an event group, but are set directly
+ * in the task notification value, which is faster and also works from ISRs.
  */
 struct EventFlags
 {
-    enum {TIMER_FAST, TIMER_SLOW, STATE_CHANGED, CONFIG_CHANGED};
-    static constexpr EventBits_t timer_fast{1<<TIMER_FAST};
-    static constexpr EventBits_t timer_slow{1<<TIMER_SLOW};
-    static constexpr EventBits_t state_changed{1<<STATE_CHANGED};
-    static constexpr EventBits_t config_changed{1<<CONFIG_CHANGED};
+    enum {TIMER_FAST, TIMER_SLOW, STATE_CHANGED, CONFIG_CHANGED, CMD_QUEUED,
+          KEYFRAME_REQUESTED, HW_FAULT, APP_STARTED, SEQUENCE_DUE, RAMP_STEP};
+    static constexpr uint32_t timer_fast{1<<TIMER_FAST};
+    static constexpr uint32_t timer_slow{1<<TIMER_SLOW};
+    static constexpr uint32_t state_changed{1<<STATE_CHANGED};
+    static constexpr uint32_t config_changed{1<<CONFIG_CHANGED};
+    static constexpr uint32_t cmd_queued{1<<CMD_QUEUED};
+    static constexpr uint32_t keyframe_requested{1<<KEYFRAME_REQUESTED};
+    static constexpr uint32_t hw_fault{1<<HW_FAULT};
+    static constexpr uint32_t app_started{1<<APP_STARTED};
+    static constexpr uint32_t sequence_due{1<<SEQUENCE_DUE};
+    static constexpr uint32_t ramp_step{1<<RAMP_STEP};
 
-    const EventBits_t value;
+    const uint32_t value;
 
-    EventFlags(EventBits_t event_bitset)
+    EventFlags(uint32_t event_bitset)
         : value{event_bitset}
     {}
 
     /** Returns true if event flags are set at input bitmask position.
      * Bitmask values are defined in this struct.
      */
-    bool have(EventBits_t bitmask) const {
+    bool have(uint32_t bitmask) const {
         return (value & bitmask) == bitmask;
     }
 };
 
 
+/** Names of the LatencyStage histograms for the stats endpoint
+ */
+static constexpr const char *latency_stage_names[] = {
+    "fast_tick",
+    "tick_lateness",
+    "temp_eval",
+    "push_update",
+};
+static_assert(std::size(latency_stage_names) == static_cast<size_t>(LatencyStage::_count),
+              "Missing LatencyStage name");
+
+
 // FreeRTOS task handle for application event task
 TaskHandle_t AppController::_app_event_task_handle;
-// FreeRTOS event group handle for triggering event task actions
-EventGroupHandle_t AppController::_app_event_group;
+volatile uint32_t AppController::_fast_timer_seq = 0;
+volatile uint32_t AppController::_fast_timer_time_us = 0;
 
 AppController::AppController(AppState &state, APIServer *api_server)
     // HTTP AJAX API server instance was created before
@@ -69,6 +98,8 @@ AppController::AppController(AppState &state, APIServer *api_server)
     assert(api_server);
     // Reads this.constants and sets this.state
     _initialize_ps_pwm_drv();
+    _initialize_ramp_generator();
+    _initialize_control_loops();
     state.aux_hw_drv_state = &aux_hw_drv.state;
     _create_app_event_task();
 }
@@ -76,8 +107,6 @@ AppController::AppController(AppState &state, APIServer *api_server)
 AppController::~AppController() {
     event_timer_fast.detach();
     event_timer_slow.detach();
-    oc_reset_timer.detach();
-    power_output_timer.detach();
 }
 
 
@@ -86,15 +115,55 @@ AppController::~AppController() {
  * This will fail if networking etc. is not set up correctly!
  */
 void AppController::begin() {
+    _cpu_mhz = getCpuFrequencyMhz();
     restore_settings();
+    // Initial sensor values were acquired by restore_settings()
+    _acquisition_mailbox.write(AcquisitionResult{aux_hw_drv.state.temp_1,
+                                                 aux_hw_drv.state.temp_2,
+                                                 0, 0});
+    _create_acquisition_task();
+    // Compares with the settings stored or migrated by restore_settings()
+    if (_settings_store.begin(constants.settings_store_task_stack_size,
+                              constants.settings_store_task_priority,
+                              constants.settings_store_task_core_id) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start settings store!");
+        abort();
+    }
     _connect_timer_callbacks();
+    _connect_fault_interrupt();
     _register_http_api(api_server);
+    // The application task was waiting for this. Clients connected before
+    // this point need the complete state.
+    xTaskNotify(_app_event_task_handle,
+                EventFlags::app_started | EventFlags::keyframe_requested,
+                eSetBits);
 }
 
 
+/* Queue a command for the application task. Thread-safe.
+ */
+void AppController::submit(AppCmd cmd, CmdArg arg) {
+    _cmd_queue.push(cmd, arg);
+    xTaskNotify(_app_event_task_handle, EventFlags::cmd_queued, eSetBits);
+}
+
+/* Queue several commands, these are drained and applied in one go.
+ * Thread-safe.
+ */
+uint32_t AppController::submit_batch(const CmdQueue::Entry *entries, size_t n_entries) {
+    auto seq = _cmd_queue.push_batch(entries, n_entries);
+    xTaskNotify(_app_event_task_handle, EventFlags::cmd_queued, eSetBits);
+    return seq;
+}
+
 //////////// Application API ///////////
 void AppController::set_setpoint_throttling_enabled(bool new_val) {
     state.setpoint_throttling_enabled = new_val;
+    if (!new_val) {
+        // Finish any ramp in progress immediately
+        ramp_generator.jump_to(frequency_ramp, state.frequency_target);
+        ramp_generator.jump_to(duty_ramp, state.duty_target);
+    }
     _send_state_changed_event();
 }
 
@@ -110,16 +179,16 @@ void AppController::set_frequency_max_khz(float n) {
 void AppController::set_frequency_khz(float n) {
     auto f_requested = std::max(n*1e3f, state.frequency_min);
     state.frequency_target = std::min(f_requested, state.frequency_max);
-    if (!state.setpoint_throttling_enabled) {
-        _set_frequency_raw(state.frequency_target);
+    if (state.setpoint_throttling_enabled) {
+        ramp_generator.set_target(frequency_ramp, state.frequency_target);
+    } else {
+        ramp_generator.jump_to(frequency_ramp, state.frequency_target);
     }
+    _send_state_changed_event();
 }
 void AppController::set_frequency_changerate_khz_sec(float n) {
-    state.frequency_increment = n * constants.timer_fast_interval_ms;
-}
-void AppController::_set_frequency_raw(float n) {
-    // state.pspwm_setpoint->frequency = n;
-    pspwm_set_frequency(constants.mcpwm_num, n);
+    state.frequency_changerate = n * 1e3f;
+    ramp_generator.set_rate(frequency_ramp, state.frequency_changerate);
     _send_state_changed_event();
 }
 
@@ -134,33 +203,50 @@ void AppController::set_duty_max_percent(float n) {
 void AppController::set_duty_percent(float n) {
     auto d_requested = std::max(n*0.01f, state.duty_min);
     state.duty_target = std::min(d_requested, state.duty_max);
-    if (!state.setpoint_throttling_enabled) {
-        _set_duty_raw(state.duty_target);
+    if (state.setpoint_throttling_enabled) {
+        ramp_generator.set_target(duty_ramp, state.duty_target);
+    } else {
+        ramp_generator.jump_to(duty_ramp, state.duty_target);
     }
+    _send_state_changed_event();
 }
 void AppController::set_duty_changerate_percent_sec(float n) {
-    state.duty_increment = n * constants.timer_fast_interval_ms * 1e-5f;
+    state.duty_changerate = n * 0.01f;
+    ramp_generator.set_rate(duty_ramp, state.duty_changerate);
     _send_state_changed_event();
 }
-void AppController::_set_duty_raw(float n) {
-    // state.pspwm_setpoint->ps_duty = n;
-    pspwm_set_ps_duty(constants.mcpwm_num, n);
+
+/* Set profile of the setpoint throttling ramps, see enum RampProfile
+ */
+void AppController::set_ramp_profile(int n) {
+    if (n < 0 || n >= static_cast<int>(RampProfile::_count)) {
+        ESP_LOGE(TAG, "Invalid ramp profile: %d", n);
+        return;
+    }
+    state.ramp_profile = static_cast<RampProfile>(n);
+    ramp_generator.configure(state.ramp_profile,
+                             constants.ramp_s_curve_time_ms * 1000,
+                             constants.ramp_exp_time_constant_ms * 1000);
     _send_state_changed_event();
 }
 
 void AppController::set_lag_dt_ns(float n) {
     state.pspwm_setpoint->lag_red = n * 1e-9f;
-    pspwm_set_deadtimes_symmetrical(constants.mcpwm_num,
-                                    state.pspwm_setpoint->lead_red,
-                                    state.pspwm_setpoint->lag_red);
+    _write_deadtimes();
     _send_state_changed_event();
 }
 void AppController::set_lead_dt_ns(float n) {
     state.pspwm_setpoint->lead_red = n * 1e-9f;
+    _write_deadtimes();
+    _send_state_changed_event();
+}
+
+/* Write both dead-time setpoints to the PWM hardware
+ */
+void AppController::_write_deadtimes() {
     pspwm_set_deadtimes_symmetrical(constants.mcpwm_num,
                                     state.pspwm_setpoint->lead_red,
                                     state.pspwm_setpoint->lag_red);
-    _send_state_changed_event();
 }
 
 /* Activate PWM power output if arg is true
@@ -175,8 +261,8 @@ void AppController::set_power_pwm_active(bool new_val) {
         }
         if (state.setpoint_throttling_enabled) {
             // Begin with duty = 0.0 for soft start
-            // state.pspwm_setpoint->ps_duty = n;
-            pspwm_set_ps_duty(constants.mcpwm_num, 0.0f);
+            ramp_generator.jump_to(duty_ramp, 0.0f);
+            ramp_generator.set_target(duty_ramp, state.duty_target);
         }
         // aux_hw_drv.set_drv_disabled(false);
         pspwm_resync_enable_output(constants.mcpwm_num);
@@ -190,15 +276,32 @@ void AppController::set_power_pwm_active(bool new_val) {
 /* Set power output oneshot pulse timer pulse length in seconds
  */
 void AppController::set_oneshot_len(float n) {
-    state.oneshot_power_pulse_length_ms = static_cast<uint32_t>(n * 1000.0f);
+    state.oneshot_power_pulse_length_us = static_cast<uint32_t>(n * 1e6f);
     _send_state_changed_event();
 }
 
 /* Trigger the power output oneshot pulse
  */
 void AppController::trigger_oneshot() {
-    // The timer callback also sends a state_changed event
-    power_output_timer.start(state.oneshot_power_pulse_length_ms);
+    // The sequence also sends a state_changed event
+    if (sequence_runner.start(power_pulse_sequence) != ESP_OK) {
+        ESP_LOGE(TAG, "Maximum number of active sequences reached!");
+    }
+}
+
+/* Start or stop the setpoint sequencer
+ */
+void AppController::sequencer_start() {
+    sequencer.start();
+    _send_state_changed_event();
+}
+void AppController::sequencer_stop() {
+    sequencer.stop();
+    _send_state_changed_event();
+}
+void AppController::set_sequencer_loop(bool new_val) {
+    sequencer.set_loop(new_val);
+    _send_state_changed_event();
 }
 
 // The output is /not/ enabled again, it must be re-enabled explicitly.
@@ -208,9 +311,12 @@ void AppController::clear_shutdown() {
     // the temperature still be above limits.
     aux_hw_drv.evaluate_temperature_sensors();
     if (state.hw_oc_fault_occurred) {
-        // The timer callback generates a three-cycle reset pulse and
+        // The sequence generates the reset pulse and
         // sends a state_changed event when finished.
-        oc_reset_timer.start();
+        ESP_LOGD(TAG, "Resetting overcurrent detect output...");
+        if (sequence_runner.start(oc_reset_sequence) != ESP_OK) {
+            ESP_LOGE(TAG, "Maximum number of active sequences reached!");
+        }
     } else {
         _send_state_changed_event();
     }
@@ -244,6 +350,25 @@ void AppController::set_fan_override(bool new_val) {
     _send_state_changed_event();
 }
 
+/* Fan control loop parameters. ControlLoop::set_param() is thread-safe,
+ * these are still applied from the application task like all others.
+ */
+void AppController::set_fan_setpoint(float n) {
+    state.fan_setpoint = n;
+    fan_loop.set_param(ControlLoop::Param::setpoint, n);
+    _send_state_changed_event();
+}
+void AppController::set_fan_kp(float n) {
+    state.fan_kp = n;
+    fan_loop.set_param(ControlLoop::Param::kp, n);
+    _send_state_changed_event();
+}
+void AppController::set_fan_ki(float n) {
+    state.fan_ki = n;
+    fan_loop.set_param(ControlLoop::Param::ki, n);
+    _send_state_changed_event();
+}
+
 
 /* Save all runtime configurable settings to SPI flash.
  * The settings are a subset of all values in struct AppState.
@@ -251,33 +376,52 @@ void AppController::set_fan_override(bool new_val) {
  * The stored settings are restored on reboot.
  */
 void AppController::save_settings() {
-    state.save_to_file(constants.settings_filename);
+    _settings_store.request_save(_get_settings(), esp_timer_get_time(),
+                                 constants.settings_save_delay_ms);
     _send_state_changed_event();
 }
 
-/* Read state back from SPI flash file and initialize the hardware
- * with these settings.
+/* Read state back from NVS and initialize the hardware with these settings.
+ *
+ * Settings files written by earlier firmware versions are migrated to NVS.
  * 
  * Called on boot when the application task event loop is not yet running.
  */
 void AppController::restore_settings() {
-    ESP_LOGI(TAG, "Restoring state from settings.json...");
-    state.restore_from_file(constants.settings_filename);
-    // We only need to run the setters for properties which affect the hardware.
-    // Again: Other values are polled and need no further setting..
-    set_frequency_khz(state.frequency_target * 1e-3f);
-    set_duty_percent(state.duty_target * 100.0f);
-    set_lead_dt_ns(state.pspwm_setpoint->lead_red * 1e9f);
-    set_lag_dt_ns(state.pspwm_setpoint->lag_red * 1e9f);
-    set_current_limit(state.aux_hw_drv_state->current_limit);
-    set_relay_ref_active(state.aux_hw_drv_state->relay_ref_active);
-    set_relay_dut_active(state.aux_hw_drv_state->relay_dut_active);
-    set_fan_override(state.aux_hw_drv_state->fan_override);
+    ESP_LOGI(TAG, "Restoring state from NVS...");
+    // Without stored settings, the initial values are applied
+    auto settings = _get_settings();
+    auto err = AppState::restore_from_nvs(settings);
+    if (err == ESP_ERR_NVS_NOT_FOUND
+            && AppState::restore_from_file(constants.legacy_settings_filename, settings)
+            && AppState::save_to_nvs(settings)) {
+        ESP_LOGI(TAG, "Migrated settings file to NVS");
+        // The file is in the public static web root
+        FSIO::remove_file(constants.legacy_settings_filename);
+    }
+    // This runs the setters for all persisted values, see state_schema.
+    // Other values are polled and need no further setting.
+    AppState::apply_settings(settings, [this](AppCmd cmd, CmdArg arg) {
+        _apply_command(cmd, arg);
+    });
     aux_hw_drv.update_temperature_sensors();
     _evaluate_temperature_sensors();
     // There is no API for this at the moment, so this is always active..
     ESP_LOGI(TAG, "Activating Gate driver power supply...");
     aux_hw_drv.set_drv_supply_active(true);
+    state.publish_snapshot();
+}
+
+/* Called on boot or from the application task, which is the only writer
+ * of the live values. Thus, a fresh snapshot contains all pending changes.
+ */
+AppStateSnapshot AppController::_get_settings() const {
+    // The snapshot has the ramp outputs, which differ from the setpoints
+    // while a ramp is running
+    auto settings = state.take_snapshot();
+    settings.frequency = state.frequency_target;
+    settings.duty = state.duty_target;
+    return settings;
 }
 
 /////////// Setup functions called from this constructor //////
@@ -313,6 +457,40 @@ void AppController::_initialize_ps_pwm_drv() {
     }
 }
 
+void AppController::_initialize_ramp_generator() {
+    // The timer wakes up the application task, which does the ramp steps
+    auto errors = ramp_generator.begin(
+        constants.ramp_step_interval_us,
+        _notify_from_timer_isr,
+        reinterpret_cast<void*>(uintptr_t{EventFlags::ramp_step}),
+        // State update is pushed when the ramps have finished
+        [](void*) {_send_state_changed_event();});
+    ramp_generator.set_catch_up(constants.ramp_catch_up,
+                                constants.ramp_catch_up_max_steps);
+    errors |= ramp_generator.add_axis(frequency_ramp);
+    errors |= ramp_generator.add_axis(duty_ramp);
+    if (errors != ESP_OK) {
+        ESP_LOGE(TAG, "Error initializing the setpoint ramp generator!");
+        abort();
+    }
+    ramp_generator.configure(state.ramp_profile,
+                             constants.ramp_s_curve_time_ms * 1000,
+                             constants.ramp_exp_time_constant_ms * 1000);
+    ramp_generator.set_rate(frequency_ramp, state.frequency_changerate);
+    ramp_generator.set_rate(duty_ramp, state.duty_changerate);
+    // Ramps start from the values the PWM module was initialized with
+    frequency_ramp.jump_to(state.pspwm_setpoint->frequency, false);
+    duty_ramp.jump_to(state.pspwm_setpoint->ps_duty, false);
+}
+
+void AppController::_initialize_control_loops() {
+    auto errors = control_loops.add_loop(fan_loop);
+    if (errors != ESP_OK) {
+        ESP_LOGE(TAG, "Error initializing the control loops!");
+        abort();
+    }
+}
+
 void AppController::_create_app_event_task() {
     xTaskCreatePinnedToCore(_app_event_task,
                             "app_event_task", 
@@ -321,174 +499,398 @@ void AppController::_create_app_event_task() {
                             constants.app_event_task_priority,
                             &_app_event_task_handle,
                             constants.app_event_task_core_id);
-    _app_event_group = xEventGroupCreate();
-    if (!_app_event_task_handle || !_app_event_group) {
-        ESP_LOGE(TAG, "Failed to create application event task or event group!");
+    if (!_app_event_task_handle) {
+        ESP_LOGE(TAG, "Failed to create application event task!");
         abort();
     }
 }
 
+void AppController::_create_acquisition_task() {
+    xTaskCreatePinnedToCore(_acquisition_task,
+                            "acquisition_task",
+                            constants.acquisition_task_stack_size,
+                            static_cast<void*>(this),
+                            constants.acquisition_task_priority,
+                            &_acquisition_task_handle,
+                            constants.acquisition_task_core_id);
+    if (!_acquisition_task_handle) {
+        ESP_LOGE(TAG, "Failed to create acquisition task!");
+        abort();
+    }
+}
+
+
+/* Look up a command in the compile-time command table and convert
+ * its value into the command argument.
+ */
+esp_err_t AppController::_parse_api_cmd(std::string_view name, std::string_view value,
+                                        CmdQueue::Entry *entry) {
+    const auto api_cmd = api_cmd_table.find(name.data(), name.size());
+    if (!api_cmd) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    auto arg = CmdArg{};
+    auto is_valid = true;
+    switch (api_cmd->arg_type) {
+    case CmdArgType::none: break;
+    case CmdArgType::boolean: is_valid = StrictParse::to_bool(value, &arg.b); break;
+    case CmdArgType::integer: is_valid = StrictParse::to_int(value, &arg.i); break;
+    case CmdArgType::real: is_valid = StrictParse::to_float(value, &arg.f); break;
+    }
+    if (!is_valid) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *entry = CmdQueue::Entry{api_cmd->cmd, arg};
+    return ESP_OK;
+}
+
+/* Check a "/cmd" request parameter and submit the command when apply is set.
+ *
+ * Called from the AsyncTCP task.
+ */
+esp_err_t AppController::_dispatch_api_cmd(void *context, std::string_view name,
+                                           std::string_view value, bool apply) {
+    auto entry = CmdQueue::Entry{};
+    auto err = _parse_api_cmd(name, value, &entry);
+    if (err == ESP_OK && apply) {
+        static_cast<AppController*>(context)->submit(entry.cmd, entry.arg);
+    }
+    return err;
+}
+
+/* Parse one command into the batch. The batch has room for every
+ * command once, so it can not overflow.
+ */
+esp_err_t AppController::_parse_batch_entry(std::string_view name, std::string_view value,
+                                            CmdQueue::Batch &batch, size_t *n_entries) {
+    auto entry = CmdQueue::Entry{};
+    auto err = _parse_api_cmd(name, value, &entry);
+    if (err != ESP_OK) {
+        return err;
+    }
+    auto end = batch.begin() + *n_entries;
+    auto it = std::find_if(batch.begin(), end, [&entry](const CmdQueue::Entry &e) {
+        return e.cmd == entry.cmd;
+    });
+    *it = entry;
+    if (it == end) {
+        ++*n_entries;
+    }
+    return ESP_OK;
+}
+
+void AppController::_format_batch_error(esp_err_t err, std::string_view name,
+                                        char *buf, size_t buf_len) {
+    snprintf(buf, buf_len, "%s: %.*s",
+             err == ESP_ERR_NOT_FOUND ? "Unknown command" : "Invalid value for",
+             static_cast<int>(name.size()), name.data());
+}
+
+/* Parse one command of a "/cmd_batch" request into the batch.
+ *
+ * Called from the AsyncTCP task.
+ */
+bool AppController::_add_batch_entry(AsyncWebServerRequest *request,
+                                     std::string_view name, std::string_view value,
+                                     CmdQueue::Batch &batch, size_t *n_entries) {
+    auto err = _parse_batch_entry(name, value, batch, n_entries);
+    if (err != ESP_OK) {
+        char text[64];
+        _format_batch_error(err, name, text, sizeof(text));
+        ESP_LOGE(TAG, "%s", text);
+        request->send(400, "text/plain", text);
+        return false;
+    }
+    return true;
+}
+
+/* Submit the commands of a "/cmd_batch" request. The response contains
+ * the state version, i.e. the value of cmd_seq in the state telegram
+ * from which on the commands have been applied.
+ */
+void AppController::_submit_batch_request(AsyncWebServerRequest *request,
+                                          const CmdQueue::Batch &batch,
+                                          size_t n_entries) {
+    if (n_entries == 0) {
+        request->send(400, "text/plain", "No commands");
+        return;
+    }
+    auto seq = submit_batch(batch.data(), n_entries);
+    char text[32];
+    snprintf(text, sizeof(text), "{\"cmd_seq\":%u}", static_cast<unsigned>(seq));
+    request->send(200, "application/json", text);
+}
+
+/* Handle a command message received on a WebSocket.
+ *
+ * Message format is a sequence number chosen by the client, followed by
+ * the commands in the same form as a "/cmd" query string, without
+ * URL encoding, e.g.: "17?set_frequency=100&set_duty=45"
+ *
+ * As for "/cmd_batch", all commands are validated first and are then
+ * applied together in one control tick. Reply is a JSON text message:
+ *   {"ack":17,"cmd_seq":1234}, see _submit_batch_request(), or
+ *   {"nak":17,"error":"Invalid value for: set_duty"}
+ *
+ * Called from the AsyncTCP task.
+ */
+void AppController::_on_ws_message(AsyncWebSocketClient *client, std::string_view message) {
+    char text[96];
+    const auto query_pos = message.find('?');
+    auto seq = 0;
+    if (query_pos == std::string_view::npos
+            || !StrictParse::to_int(message.substr(0, query_pos), &seq) || seq < 0) {
+        client->text("{\"error\":\"Invalid message\"}");
+        return;
+    }
+    auto batch = CmdQueue::Batch{};
+    auto n_entries = size_t{0};
+    auto query = message.substr(query_pos + 1);
+    while (!query.empty()) {
+        auto param = query.substr(0, query.find('&'));
+        query.remove_prefix(std::min(param.size() + 1, query.size()));
+        const auto value_pos = param.find('=');
+        const auto name = param.substr(0, value_pos);
+        const auto value = value_pos == std::string_view::npos
+                           ? std::string_view{} : param.substr(value_pos + 1);
+        auto err = _parse_batch_entry(name, value, batch, &n_entries);
+        if (err != ESP_OK) {
+            char error[64];
+            _format_batch_error(err, name, error, sizeof(error));
+            // The error contains the client-supplied name
+            char nak_text[32 + 6 * sizeof(error)];
+            auto writer = JsonStreamWriter{nak_text, sizeof(nak_text)};
+            writer.begin_object();
+            writer.key("nak");
+            writer.value(static_cast<uint32_t>(seq));
+            writer.key("error");
+            writer.value(error);
+            writer.end_object();
+            writer.finish();
+            client->text(nak_text);
+            return;
+        }
+    }
+    if (n_entries == 0) {
+        snprintf(text, sizeof(text), "{\"nak\":%d,\"error\":\"No commands\"}", seq);
+        client->text(text);
+        return;
+    }
+    const auto cmd_seq = submit_batch(batch.data(), n_entries);
+    snprintf(text, sizeof(text), "{\"ack\":%d,\"cmd_seq\":%u}",
+             seq, static_cast<unsigned>(cmd_seq));
+    client->text(text);
+}
 
-/* Register all application HTTP GET API callbacks into the HTPP server
+/* Register all application HTTP GET API callbacks into the HTPP server.
+ *
+ * The callbacks are run from the async_tcp task. Commands are only queued
+ * here and are applied later by the application task.
  */
 void AppController::_register_http_api(APIServer* api_server) {
-    CbVoidT cb_void;
-    CbFloatT cb_float;
-    CbStringT cb_text;
-    // Activate/deactivate the setpoint throttling / soft-start feature
-    // "set_setpoint_throttling_enabled"
-    cb_text = [this](const String &text) {set_setpoint_throttling_enabled(text=="true");};
-    api_server->register_api_cb("set_setpoint_throttling_enabled", cb_text);
-    // User setpoint limits (custom adjustment range) for output frequency [kHz]
-    // "set_frequency_min"
-    cb_float = [this](float n) {set_frequency_min_khz(n);};
-    api_server->register_api_cb("set_frequency_min", cb_float);
-    // "set_frequency_max"
-    cb_float = [this](float n) {set_frequency_max_khz(n);};
-    api_server->register_api_cb("set_frequency_max", cb_float);
-    // PWM output frequency setpoint [kHz]
-    // "set_frequency"
-    cb_float = [this](float n) {set_frequency_khz(n);};
-    api_server->register_api_cb("set_frequency", cb_float);
-    // Setpoint throttling / soft-start speed for output frequency [kHz/sec]
-    // "set_frequency_changerate"
-    cb_float = [this](float n) {set_frequency_changerate_khz_sec(n);};
-    api_server->register_api_cb("set_frequency_changerate", cb_float);
-    // User setpoint limits (custom adjustment range) for PWM result duty cycle [%]
-    // "set_duty_min"
-    cb_float = [this](float n) {set_duty_min_percent(n);};
-    api_server->register_api_cb("set_duty_min", cb_float);
-    // "set_duty_max"
-    cb_float = [this](float n) {set_duty_max_percent(n);};
-    api_server->register_api_cb("set_duty_max", cb_float);
-    // PWM result duty cycle setpoint [%]
-    // "set_duty"
-    cb_float = [this](float n) {set_duty_percent(n);};
-    api_server->register_api_cb("set_duty", cb_float);
-    // Setpoint throttling / soft-start speed for PWM result duty cycle [kHz/sec]
-    // "set_duty_changerate"
-    cb_float = [this](float n) {set_duty_changerate_percent_sec(n);};
-    api_server->register_api_cb("set_duty_changerate", cb_float);
-    // Dead-time setpoint for leading and lagging half-bridge leg [ns]
-    // "set_lag_dt"
-    cb_float = [this](float n) {set_lag_dt_ns(n);};
-    api_server->register_api_cb("set_lag_dt", cb_float);
-    // "set_lead_dt"
-    cb_float = [this](float n) {set_lead_dt_ns(n);};
-    api_server->register_api_cb("set_lead_dt", cb_float);
-    // Activate/deactivated the PWM output signal
-    // "set_power_pwm_active"
-    cb_text = [this](const String &text) {set_power_pwm_active(text=="true");};
-    api_server->register_api_cb("set_power_pwm_active", cb_text);
-    // Length of the power output one-shot timer pulse [sec]
-    // "set_oneshot_len"
-    cb_float = [this](float n){set_oneshot_len(n);};
-    api_server->register_api_cb("set_oneshot_len", cb_float);
-    // Trigger a one-shot output power pulse of configurable length [sec]
-    // "trigger_oneshot"
-    cb_void = [this](){trigger_oneshot();};
-    api_server->register_api_cb("trigger_oneshot", cb_void);
-    // Clear the hardware error shutdown latch
-    // "clear_shutdown"
-    cb_void = [this](){clear_shutdown();};
-    api_server->register_api_cb("clear_shutdown", cb_void);
-    // Power stage overcurrent limit (depends on measurement shunt value) [A]
-    // "set_current_limit"
-    cb_float = [this](float n) {set_current_limit(n);};
-    api_server->register_api_cb("set_current_limit", cb_float);
-    // Overtemperature protection limits for sensor channels 1 and 2 [°C]
-    // "set_temp_1_limit"
-    cb_float = [this](float n) {set_temp_1_limit(n);};
-    api_server->register_api_cb("set_temp_1_limit", cb_float);
-    // "set_temp_2_limit"
-    cb_float = [this](float n) {set_temp_2_limit(n);};
-    api_server->register_api_cb("set_temp_2_limit", cb_float);
-    // Activate/deactivate power output relays/contactors
-    // "set_relay_ref_active"
-    cb_text = [this](const String &text) {set_relay_ref_active(text=="true");};
-    api_server->register_api_cb("set_relay_ref_active", cb_text);
-    // "set_relay_dut_active"
-    cb_text = [this](const String &text) {set_relay_dut_active(text=="true");};
-    api_server->register_api_cb("set_relay_dut_active", cb_text);
-    // Fan override activated/deactivated:
-    // When set to "true", fan is always ON. Otherwise, fan is temperature-controlled
-    // "set_fan_override"
-    cb_text = [this](const String &text) {set_fan_override(text=="true");};
-    api_server->register_api_cb("set_fan_override", cb_text);
-    // Save all runtime settings to SPI flash for persistence accross hardware restarts
-    // "save_settings"
-    cb_void = [this](){save_settings();};
-    api_server->register_api_cb("save_settings", cb_void);
+    // All setters and action commands, see api_cmd_table.hpp
+    api_server->set_cmd_dispatcher(_dispatch_api_cmd, this);
+    // Several commands via HTTP POST, all validated first and then applied
+    // together in one control tick. Body is either a JSON object with the
+    // command names as keys or a form with the same names as for "/cmd".
+    auto cmd_batch_json_handler = new AsyncCallbackJsonWebHandler(
+        constants.cmd_batch_endpoint,
+        [this](AsyncWebServerRequest *request, JsonVariant &jv) {
+            if (!jv.is<JsonObject>()) {
+                request->send(400, "text/plain", "Expected a JSON object");
+                return;
+            }
+            auto batch = CmdQueue::Batch{};
+            auto n_entries = size_t{0};
+            for (auto kv : jv.as<JsonObjectConst>()) {
+                // JSON numbers and booleans are converted back to text, so
+                // that the same strict parsing applies as for "/cmd"
+                char text[32];
+                auto value = std::string_view{};
+                if (kv.value().is<const char*>()) {
+                    value = kv.value().as<const char*>();
+                } else if (!kv.value().isNull()) {
+                    value = std::string_view{text, serializeJson(kv.value(), text, sizeof(text))};
+                }
+                if (!_add_batch_entry(request, kv.key().c_str(), value, batch, &n_entries)) {
+                    return;
+                }
+            }
+            _submit_batch_request(request, batch, n_entries);
+        },
+        constants.cmd_batch_json_buf_size
+    );
+    api_server->backend->addHandler(cmd_batch_json_handler);
+    // Form body, only reached if the content type is not JSON
+    api_server->backend->on(constants.cmd_batch_endpoint, HTTP_POST,
+                            [this](AsyncWebServerRequest *request) {
+        auto batch = CmdQueue::Batch{};
+        auto n_entries = size_t{0};
+        for (size_t i = 0; i < request->params(); ++i) {
+            const auto param = request->getParam(i);
+            const auto &name = param->name();
+            const auto &value = param->value();
+            if (!_add_batch_entry(request, std::string_view{name.c_str(), name.length()},
+                                  std::string_view{value.c_str(), value.length()},
+                                  batch, &n_entries)) {
+                return;
+            }
+        }
+        _submit_batch_request(request, batch, n_entries);
+    });
+    // Sequencer step table upload via HTTP POST, see setpoint_sequencer.hpp.
+    // This is not queued, the sequencer table is thread-safe on its own.
+    auto sequence_upload_handler = new AsyncCallbackJsonWebHandler(
+        constants.sequencer_endpoint,
+        [this](AsyncWebServerRequest *request, JsonVariant &jv) {
+            auto errors = sequencer.load_from_json(jv.as<JsonArrayConst>());
+            if (errors == ESP_ERR_INVALID_STATE) {
+                request->send(409, "text/plain", "Sequencer is running");
+            } else if (errors != ESP_OK) {
+                request->send(400, "text/plain", "Invalid sequence");
+            } else {
+                request->send(200, "text/plain", "OK");
+                _send_state_changed_event();
+            }
+        },
+        constants.sequencer_json_buf_size
+    );
+    api_server->backend->addHandler(sequence_upload_handler);
+
+    // Binary state telegram and its schema, see AppState::serialize_snapshot_bin()
+    api_server->backend->on(constants.state_bin_endpoint, HTTP_GET,
+                            [this](AsyncWebServerRequest *request) {
+        _on_state_bin_request(request);
+    });
+    api_server->backend->on(constants.state_schema_endpoint, HTTP_GET,
+                            [this](AsyncWebServerRequest *request) {
+        _on_state_schema_request(request);
+    });
+
+    // Event loop latency histograms, see LatencyStage
+    api_server->backend->on(constants.stats_endpoint, HTTP_GET,
+                            [this](AsyncWebServerRequest *request) {
+        _on_stats_request(request);
+    });
+    api_server->on_server_timing([this](char *buf, size_t buf_len) {
+        _get_server_timing(buf, buf_len);
+    });
+
+    // Commands on the WebSockets, state telegrams are sent by _push_state_update()
+    api_server->on_ws_message([this](AsyncWebSocketClient *client, std::string_view message) {
+        _on_ws_message(client, message);
+    });
+
+    // Newly connected clients need the complete state
+    api_server->on_sse_client_connect([](){
+        xTaskNotify(_app_event_task_handle, EventFlags::keyframe_requested, eSetBits);
+    });
+}
+
+/* Send the latency histograms as JSON. Durations are in µs, bucket i of
+ * each histogram counts durations of 2^i up to 2^(i+1) - 1 CPU cycles.
+ * Trailing empty buckets are omitted.
+ */
+void AppController::_on_stats_request(AsyncWebServerRequest *request) {
+    if (request->hasParam("reset")) {
+        for (auto &histogram : _latency_stats) {
+            histogram.request_reset();
+        }
+    }
+    const auto cpu_mhz = getCpuFrequencyMhz();
+    auto response = request->beginResponseStream("application/json");
+    response->printf("{\"cpu_mhz\":%u,\"stages\":{", static_cast<unsigned>(cpu_mhz));
+    for (size_t i = 0; i < _latency_stats.size(); ++i) {
+        const auto &histogram = _latency_stats[i];
+        response->printf("%s\"%s\":{\"count\":%u,\"mean_us\":%s,\"max_us\":%s,\"buckets\":[",
+                         i ? "," : "", latency_stage_names[i],
+                         static_cast<unsigned>(histogram.get_count()),
+                         FixedPoint::Text{histogram.get_mean() / static_cast<float>(cpu_mhz), 2}.c_str(),
+                         FixedPoint::Text{histogram.get_max() / static_cast<float>(cpu_mhz), 2}.c_str());
+        const auto &buckets = histogram.get_buckets();
+        auto n_buckets = buckets.size();
+        while (n_buckets > 0 && buckets[n_buckets - 1] == 0) {
+            --n_buckets;
+        }
+        for (size_t j = 0; j < n_buckets; ++j) {
+            response->printf("%s%u", j ? "," : "", static_cast<unsigned>(buckets[j]));
+        }
+        response->print("]}");
+    }
+    response->print("}}");
+    request->send(response);
+}
+
+/* Send the binary telegram of the last published snapshot
+ */
+void AppController::_on_state_bin_request(AsyncWebServerRequest *request) {
+    auto bin_buf = std::array<uint8_t, AppState::bin_buf_len>{};
+    const auto bin_len = AppState::serialize_snapshot_bin(state.snapshot.read(),
+                                                          bin_buf.data(), bin_buf.size());
+    auto response = request->beginResponseStream("application/octet-stream", bin_len);
+    response->write(bin_buf.data(), bin_len);
+    request->send(response);
+}
+
+/* Send keys, types, scales and decimal places of the binary telegram values,
+ * in telegram order. Decoded values multiplied by scale are in the units of
+ * the JSON telegram.
+ */
+void AppController::_on_state_schema_request(AsyncWebServerRequest *request) {
+    // In FieldType order
+    static constexpr const char *type_names[] = {"bool", "u8", "u32", "f32"};
+    auto response = request->beginResponseStream("application/json");
+    response->printf("{\"version\":%u,\"hash\":%u,\"size\":%u,\"fields\":[",
+                     static_cast<unsigned>(AppState::bin_format_version),
+                     static_cast<unsigned>(AppState::bin_schema_hash),
+                     static_cast<unsigned>(AppState::bin_buf_len));
+    auto is_first = true;
+    for (const auto &field : state_schema) {
+        response->printf("%s{\"key\":\"%s\",\"type\":\"%s\",\"scale\":%g,\"decimals\":%u}",
+                         is_first ? "" : ",", field.key,
+                         type_names[static_cast<size_t>(field.type)],
+                         static_cast<double>(field.scale),
+                         static_cast<unsigned>(field.decimal_places));
+        is_first = false;
+    }
+    response->print("]}");
+    request->send(response);
+}
+
+/* Metrics for the Server-Timing header of API responses, in milliseconds
+ */
+void AppController::_get_server_timing(char *buf, size_t buf_len) const {
+    const auto cycles_per_ms = getCpuFrequencyMhz() * 1e3f;
+    const auto &tick = _latency_stats[static_cast<size_t>(LatencyStage::fast_tick)];
+    const auto &late = _latency_stats[static_cast<size_t>(LatencyStage::tick_lateness)];
+    snprintf(buf, buf_len,
+             "tick;dur=%s;desc=\"Fast tick mean\", tick_max;dur=%s, late_max;dur=%s",
+             FixedPoint::Text{tick.get_mean() / cycles_per_ms, 3}.c_str(),
+             FixedPoint::Text{tick.get_max() / cycles_per_ms, 3}.c_str(),
+             FixedPoint::Text{late.get_max() / cycles_per_ms, 3}.c_str());
 }
 
 /* Connect timer callbacks. These are run from esp_timer task.
  */
 void AppController::_connect_timer_callbacks(){
-    esp_err_t errors;
     // Configure timers triggering periodic events.
     // Fast events are used for triggering ADC conversion etc.
-    event_timer_fast.attach_ms(
-        constants.timer_fast_interval_ms,
-        [](){xEventGroupSetBits(_app_event_group, EventFlags::timer_fast);}
-        );
+    // When the application task is self-clocked, it does not need this timer.
+    if (!constants.app_task_self_clocked) {
+        _attach_fast_timer();
+    }
     // Slow events are used for sending periodic SSE push messages updating the
     // application state as displayed by the remote clients
     event_timer_slow.attach_ms(
         constants.timer_slow_interval_ms,
-        [](){xEventGroupSetBits(_app_event_group, EventFlags::timer_slow);}
-        );
-    // Timer for generating output pulses
-    errors = power_output_timer.attach_static_ms(
-        state.oneshot_power_pulse_length_ms,
-        2,
-        [](AppController *self, uint32_t repeat_count){
-            ESP_LOGD(TAG, "Power pulse callback called. Counter: %d    ms: %lu",
-                     repeat_count, millis());
-            if (repeat_count == 1) {
-                self->set_power_pwm_active(true);
-            } else {
-                // Output was activated before. Disable it again.
-                self->set_power_pwm_active(false);
-            }
-            self->_send_state_changed_event();
-        }, 
-        this,
-        true
-        );
-    // Hardware overcurrent reset needs a pulse which is generated by this timer
-    //
-    // FIXME: Hardware has redundant latch but no separate oc detect line.
-    //        So this currently does not recognize if error is still
-    //        present or only latched.
-    //if (pspwm_get_hw_fault_shutdown_present(mcpwm_num)) {
-    //    ESP_LOGE(TAG, "Will Not Clear: Fault Shutdown Pin Still Active!");
-    //    return;
-    //}
-    //
-    // This multitimer instance calls the lambda three times in a row.
-    // First call sets the hardware reset line active. Second call resets it.
-    // Third call resets the PSPWM module internal error flag and sends a
-    // notification event to the application.
-    // The power output is /not/ enabled again, it must be re-enabled explicitly.
-    errors |= oc_reset_timer.attach_static_ms(
-        aux_hw_drv.aux_hw_conf.oc_reset_pulse_length_ms,
-        3,
-        [](AppController* self, uint32_t repeat_count){
-            ESP_LOGD(TAG, "Reset called. Counter: %d    ms: %lu",
-                     repeat_count, millis());
-            if (repeat_count == 1) {
-                self->aux_hw_drv.reset_oc_shutdown_start();
-            } else if (repeat_count == 2) {
-                self->aux_hw_drv.reset_oc_shutdown_finish();
-            } else if (repeat_count == 3) {
-                ESP_LOGD(TAG, "External HW reset done. Resetting SOC fault latch...");
-                pspwm_clear_hw_fault_shutdown_occurred(self->constants.mcpwm_num);
-                self->_send_state_changed_event();
-            }
-        },
-        this,
-        true
+        [](){xTaskNotify(_app_event_task_handle, EventFlags::timer_slow, eSetBits);}
         );
+    // Common timer for the power output pulse and the overcurrent reset
+    // sequences, see _power_pulse_sequence() and _oc_reset_sequence().
+    // The timer wakes up the application task, which runs the steps.
+    auto errors = sequence_runner.begin(
+        _notify_from_timer_isr,
+        reinterpret_cast<void*>(uintptr_t{EventFlags::sequence_due}));
     // Timers are essential
     if (errors != ESP_OK) {
         ESP_LOGE(TAG, "Application timer initialization failed! Abort..");
@@ -496,57 +898,456 @@ void AppController::_connect_timer_callbacks(){
     }
 }
 
+/* (Re-)start the fast timer with the current tick interval
+ */
+void AppController::_attach_fast_timer() {
+    event_timer_fast.detach();
+    event_timer_fast.attach_ms(
+        state.tick_interval_ms,
+        [](){
+            // Ticks merged in the notification value are detected
+            // by the application task using the sequence number
+            _fast_timer_time_us = static_cast<uint32_t>(esp_timer_get_time());
+            _fast_timer_seq = _fast_timer_seq + 1;
+            xTaskNotify(_app_event_task_handle, EventFlags::timer_fast, eSetBits);
+        });
+}
+
+/* Wakes up the application task from the esp_timer ISR.
+ * This must be IRAM-safe.
+ */
+void IRAM_ATTR AppController::_notify_from_timer_isr(void *event_flags) {
+    auto higher_priority_task_woken = BaseType_t{pdFALSE};
+    xTaskNotifyFromISR(_app_event_task_handle,
+                       static_cast<uint32_t>(reinterpret_cast<uintptr_t>(event_flags)),
+                       eSetBits, &higher_priority_task_woken);
+    if (higher_priority_task_woken) {
+        // Instead of portYIELD_FROM_ISR() for the esp_timer ISR dispatch
+        esp_timer_isr_dispatch_need_yield();
+    }
+}
+
+/* Setup the GPIO interrupt on the hardware fault input.
+ *
+ * The MCPWM fault interrupt is owned by the ps_pwm driver, so this uses a
+ * GPIO edge interrupt on the same input pin instead.
+ */
+void AppController::_connect_fault_interrupt() {
+    if (!constants.fault_interrupt_enabled) {
+        return;
+    }
+    auto errors = fault_notifier.begin(
+        constants.gpio_fault_shutdown,
+        constants.fault_pin_active_level == MCPWM_LOW_LEVEL_TGR,
+        _app_event_task_handle,
+        EventFlags::hw_fault);
+    if (errors != ESP_OK) {
+        // Not fatal, fault is still detected by polling in the fast tick
+        ESP_LOGE(TAG, "Could not setup fault interrupt, using polling only!");
+    }
+}
+
+//////////// Timed hardware sequences, see timed_sequence.hpp ///////////
+
+/* Hardware overcurrent reset needs a pulse which is generated here.
+ *
+ * FIXME: Hardware has redundant latch but no separate oc detect line.
+ *        So this currently does not recognize if error is still
+ *        present or only latched.
+ * if (pspwm_get_hw_fault_shutdown_present(mcpwm_num)) {
+ *     ESP_LOGE(TAG, "Will Not Clear: Fault Shutdown Pin Still Active!");
+ *     return;
+ * }
+ *
+ * First step sets the hardware reset line active, second step resets it.
+ * After another pulse length, the PSPWM module internal error flag is reset
+ * and a notification event is sent to the application.
+ * The power output is /not/ enabled again, it must be re-enabled explicitly.
+ */
+int64_t AppController::_oc_reset_sequence(TimedSequence &seq) {
+    SEQ_BEGIN(seq);
+    aux_hw_drv.reset_oc_shutdown_start();
+    SEQ_DELAY_US(seq, aux_hw_drv.aux_hw_conf.oc_reset_pulse_length_us);
+    aux_hw_drv.reset_oc_shutdown_finish();
+    SEQ_DELAY_US(seq, aux_hw_drv.aux_hw_conf.oc_reset_pulse_length_us);
+    ESP_LOGD(TAG, "External HW reset done. Resetting SOC fault latch...");
+    pspwm_clear_hw_fault_shutdown_occurred(constants.mcpwm_num);
+    _send_state_changed_event();
+    SEQ_END(seq);
+}
+
+/* Power output one-shot pulse. Both setter calls send a state_changed event.
+ * The pulse length accuracy is limited by the application task wake-up
+ * latency, see timed_sequence.hpp.
+ */
+int64_t AppController::_power_pulse_sequence(TimedSequence &seq) {
+    SEQ_BEGIN(seq);
+    ESP_LOGD(TAG, "Power pulse start. us: %lld", esp_timer_get_time());
+    set_power_pwm_active(true);
+    SEQ_DELAY_US(seq, state.oneshot_power_pulse_length_us);
+    ESP_LOGD(TAG, "Power pulse end. us: %lld", esp_timer_get_time());
+    set_power_pwm_active(false);
+    SEQ_END(seq);
+}
+
+/* Submit one setpoint sequencer step as a command batch.
+ *
+ * The step goes through the same setters as the /cmd API, i.e. setpoints are
+ * limited to the user limits, update the targets in the app state and start
+ * a ramp when setpoint throttling is enabled. The batch is applied as one in
+ * the next loop of the application task.
+ */
+void AppController::_apply_sequencer_step(const SequencerStep &step) {
+    auto entries = std::array<CmdQueue::Entry, 6>{};
+    auto n_entries = size_t{0};
+    // Output off first, on last, so that the soft start uses the new duty
+    if (step.output_enabled == 0) {
+        entries[n_entries++] = {AppCmd::set_power_pwm_active, CmdArg{false}};
+    }
+    if (!std::isnan(step.frequency_khz)) {
+        entries[n_entries++] = {AppCmd::set_frequency, CmdArg{step.frequency_khz}};
+    }
+    if (!std::isnan(step.duty_percent)) {
+        entries[n_entries++] = {AppCmd::set_duty, CmdArg{step.duty_percent}};
+    }
+    if (!std::isnan(step.lead_dt_ns)) {
+        entries[n_entries++] = {AppCmd::set_lead_dt, CmdArg{step.lead_dt_ns}};
+    }
+    if (!std::isnan(step.lag_dt_ns)) {
+        entries[n_entries++] = {AppCmd::set_lag_dt, CmdArg{step.lag_dt_ns}};
+    }
+    if (step.output_enabled == 1) {
+        entries[n_entries++] = {AppCmd::set_power_pwm_active, CmdArg{true}};
+    }
+    if (n_entries) {
+        submit_batch(entries.data(), n_entries);
+    }
+}
+
 //////////// Application task related functions ///////////
 
 /* AppHwControl application event task
+ *
+ * When constants.app_task_self_clocked is set, the fast timer events are
+ * generated here with vTaskDelayUntil() semantics, i.e. the task waits for
+ * notifications only until the next fast tick is due.
+ * Ticks which could not be processed in time are counted as overruns.
  */
 void AppController::_app_event_task(void *pVParameters) {
     auto self = static_cast<AppController*>(pVParameters);
+    // This task is created by the constructor. No ticks are run and no
+    // updates are pushed before begin() has restored the settings and
+    // connected the API server. Events from before are passed on.
+    auto start_bits = uint32_t{0};
+    while (!EventFlags{start_bits}.have(EventFlags::app_started)) {
+        auto bits = uint32_t{0};
+        xTaskNotifyWait(0, ULONG_MAX, &bits, portMAX_DELAY);
+        start_bits |= bits;
+    }
+    xTaskNotify(_app_event_task_handle, start_bits & ~EventFlags::app_started, eSetBits);
     ESP_LOGI(TAG, "Starting AppController event task");
+    constexpr auto us_per_rtos_tick = int64_t{portTICK_PERIOD_MS} * 1000;
+    auto tick_period = pdMS_TO_TICKS(self->state.tick_interval_ms);
+    // Start right after a FreeRTOS tick, so that the scheduled fast tick
+    // times in µs (for the tick lateness) are aligned with the tick count.
+    vTaskDelay(1);
+    auto next_tick = xTaskGetTickCount() + tick_period;
+    auto next_tick_us = esp_timer_get_time() + tick_period * us_per_rtos_tick;
     // Main application event loop
     while (true) {
-        const auto flags = EventFlags{
-            xEventGroupWaitBits(
-                _app_event_group, 0xFF, pdTRUE, pdFALSE, portMAX_DELAY)};
+        auto notified_bits = uint32_t{0};
+        if (constants.app_task_self_clocked) {
+            auto ticks_to_wait = static_cast<int32_t>(next_tick - xTaskGetTickCount());
+            auto timeout = std::min(static_cast<TickType_t>(std::max(ticks_to_wait, 0)),
+                                    self->_ticks_until_push_due());
+            xTaskNotifyWait(0, ULONG_MAX, &notified_bits, timeout);
+            auto ticks_late = static_cast<int32_t>(xTaskGetTickCount() - next_tick);
+            if (ticks_late >= 0) {
+                auto lateness_us = std::max(esp_timer_get_time() - next_tick_us, int64_t{0});
+                // Any full period elapsed in addition is a missed tick
+                auto missed_ticks = static_cast<uint32_t>(ticks_late) / tick_period;
+                self->_update_tick_sequence(missed_ticks, static_cast<uint32_t>(lateness_us));
+                next_tick += (missed_ticks + 1) * tick_period;
+                next_tick_us += (missed_ticks + 1) * tick_period * us_per_rtos_tick;
+                notified_bits |= EventFlags::timer_fast;
+            }
+        } else {
+            xTaskNotifyWait(0, ULONG_MAX, &notified_bits,
+                            self->_ticks_until_push_due());
+            if (notified_bits & EventFlags::timer_fast) {
+                const auto seq = _fast_timer_seq;
+                const auto lateness_us = static_cast<uint32_t>(esp_timer_get_time())
+                                         - _fast_timer_time_us;
+                self->_update_tick_sequence(seq - self->state.tick_seq - 1, lateness_us);
+            }
+        }
+        const auto flags = EventFlags{notified_bits};
+        // Commands are applied before any other action. This is done for
+        // every loop pass, the cmd_queued flag only serves to wake up the task.
+        self->_apply_queued_commands();
+        // Timed hardware sequences, see timed_sequence.hpp
+        if (flags.have(EventFlags::sequence_due)) {
+            self->sequence_runner.run_due(esp_timer_get_time());
+        }
+        // Setpoint ramps, see ramp_generator.hpp
+        if (flags.have(EventFlags::ramp_step)) {
+            self->ramp_generator.run_due(esp_timer_get_time());
+        }
         if (flags.have(EventFlags::timer_fast)) {
+            auto t_start_us = esp_timer_get_time();
+            auto t_start_cycles = LatencyHistogram::now_cycles();
             self->_on_fast_timer_event_update_state();
+            self->_latency(LatencyStage::fast_tick).record_since(t_start_cycles);
+            self->_update_tick_statistics(esp_timer_get_time() - t_start_us);
+        }
+        // Checked on every pass, so that commands starting a ramp
+        // switch to the active tick rate immediately.
+        if (self->_update_tick_interval()) {
+            const auto new_period = pdMS_TO_TICKS(self->state.tick_interval_ms);
+            // Next tick is rescheduled relative to the last one,
+            // but not into the past, which would count as missed ticks.
+            auto new_next_tick = next_tick - tick_period + new_period;
+            const auto now_tick = xTaskGetTickCount();
+            if (static_cast<int32_t>(new_next_tick - now_tick) < 0) {
+                new_next_tick = now_tick;
+            }
+            next_tick_us += static_cast<int32_t>(new_next_tick - next_tick) * us_per_rtos_tick;
+            next_tick = new_next_tick;
+            tick_period = new_period;
+        }
+        if (flags.have(EventFlags::hw_fault)) {
+            self->_on_hw_fault_event();
         }
         if (flags.have(EventFlags::timer_slow)) {
+            auto t_start_cycles = LatencyHistogram::now_cycles();
             self->_evaluate_temperature_sensors();
-            self->_push_state_update();
+            self->_latency(LatencyStage::temp_eval).record_since(t_start_cycles);
         }
-        if (flags.have(EventFlags::state_changed)) {
+        // Bursts of state changes result in only one update telegram
+        if (flags.have(EventFlags::timer_slow)
+            || flags.have(EventFlags::state_changed)) {
+            self->_push_scheduler.request();
+        }
+        self->state.pushes_suppressed = self->_push_scheduler.get_suppressed_count();
+        // All state changes of this loop pass are done. Publish a consistent
+        // snapshot for the serializers before pushing any updates.
+        self->state.publish_snapshot();
+        const auto now_us = esp_timer_get_time();
+        if (flags.have(EventFlags::hw_fault)) {
+            // Fault alerts are not delayed
+            self->_push_scheduler.mark_pushed(now_us);
+            self->_push_state_update(flags.have(EventFlags::keyframe_requested));
+            self->_push_fault_alert();
+        } else if (flags.have(EventFlags::keyframe_requested)) {
+            // Keyframes for newly connected clients are not delayed
+            self->_push_scheduler.mark_pushed(now_us);
+            self->_push_state_update(true);
+        } else if (self->_push_scheduler.poll(now_us)) {
             self->_push_state_update();
         }
     }
 }
 
+/* Temperature sensor acquisition task
+ *
+ * With averaging of 64 samples, both channels acquisition takes approx. 9 ms
+ * combined. This is done here on the other core so that it does not delay
+ * the application task. Results are published via the lock-free (for the
+ * reader) _acquisition_mailbox.
+ */
+void AppController::_acquisition_task(void *pVParameters) {
+    auto self = static_cast<AppController*>(pVParameters);
+    ESP_LOGI(TAG, "Starting acquisition task");
+    auto result = AcquisitionResult{};
+    auto last_wake_time = xTaskGetTickCount();
+    while (true) {
+        // Acquisition is slowed down together with the fast tick when idle
+        const auto interval = pdMS_TO_TICKS(std::max(constants.acquisition_interval_ms,
+                                                     self->state.tick_interval_ms));
+        vTaskDelayUntil(&last_wake_time, interval);
+        auto t_start_us = esp_timer_get_time();
+        self->aux_hw_drv.read_temperature_sensors(&result.temp_1, &result.temp_2);
+        result.exec_time_us = static_cast<uint32_t>(esp_timer_get_time() - t_start_us);
+        ++result.count;
+        self->_acquisition_mailbox.write(result);
+    }
+}
+
+/* Apply all commands submitted since the last call.
+ * Repeated commands were already merged by the queue.
+ */
+void AppController::_apply_queued_commands() {
+    auto batch = CmdQueue::Batch{};
+    auto seq = uint32_t{0};
+    auto n_cmds = _cmd_queue.drain(batch, &seq);
+    auto settings_changed = false;
+    auto deadtimes_changed = false;
+    for (auto i = 0u; i < n_cmds; ++i) {
+        const auto &entry = batch[i];
+        // Both dead-times are written to the hardware in one go below
+        if (entry.cmd == AppCmd::set_lag_dt) {
+            state.pspwm_setpoint->lag_red = entry.arg.f * 1e-9f;
+            deadtimes_changed = true;
+        } else if (entry.cmd == AppCmd::set_lead_dt) {
+            state.pspwm_setpoint->lead_red = entry.arg.f * 1e-9f;
+            deadtimes_changed = true;
+        } else {
+            _apply_command(entry.cmd, entry.arg);
+        }
+        settings_changed |= is_persisted_setter(entry.cmd);
+    }
+    if (deadtimes_changed) {
+        _write_deadtimes();
+        _send_state_changed_event();
+    }
+    state.cmd_seq = seq;
+    if (settings_changed && constants.settings_autosave_delay_ms) {
+        _settings_store.request_save(_get_settings(), esp_timer_get_time(),
+                                     constants.settings_autosave_delay_ms, true);
+    }
+}
+
+/* Call the API setter corresponding to cmd
+ */
+void AppController::_apply_command(AppCmd cmd, CmdArg arg) {
+    switch (cmd) {
+    case AppCmd::set_setpoint_throttling_enabled:
+        set_setpoint_throttling_enabled(arg.b); break;
+    case AppCmd::set_frequency_min: set_frequency_min_khz(arg.f); break;
+    case AppCmd::set_frequency_max: set_frequency_max_khz(arg.f); break;
+    case AppCmd::set_frequency: set_frequency_khz(arg.f); break;
+    case AppCmd::set_frequency_changerate:
+        set_frequency_changerate_khz_sec(arg.f); break;
+    case AppCmd::set_duty_min: set_duty_min_percent(arg.f); break;
+    case AppCmd::set_duty_max: set_duty_max_percent(arg.f); break;
+    case AppCmd::set_duty: set_duty_percent(arg.f); break;
+    case AppCmd::set_duty_changerate:
+        set_duty_changerate_percent_sec(arg.f); break;
+    case AppCmd::set_ramp_profile: set_ramp_profile(arg.i); break;
+    case AppCmd::set_lag_dt: set_lag_dt_ns(arg.f); break;
+    case AppCmd::set_lead_dt: set_lead_dt_ns(arg.f); break;
+    case AppCmd::set_power_pwm_active: set_power_pwm_active(arg.b); break;
+    case AppCmd::set_oneshot_len: set_oneshot_len(arg.f); break;
+    case AppCmd::trigger_oneshot: trigger_oneshot(); break;
+    case AppCmd::clear_shutdown: clear_shutdown(); break;
+    case AppCmd::set_current_limit: set_current_limit(arg.f); break;
+    case AppCmd::set_temp_1_limit: set_temp_1_limit(arg.f); break;
+    case AppCmd::set_temp_2_limit: set_temp_2_limit(arg.f); break;
+    case AppCmd::set_relay_ref_active: set_relay_ref_active(arg.b); break;
+    case AppCmd::set_relay_dut_active: set_relay_dut_active(arg.b); break;
+    case AppCmd::set_fan_override: set_fan_override(arg.b); break;
+    case AppCmd::set_fan_setpoint: set_fan_setpoint(arg.f); break;
+    case AppCmd::set_fan_kp: set_fan_kp(arg.f); break;
+    case AppCmd::set_fan_ki: set_fan_ki(arg.f); break;
+    case AppCmd::save_settings: save_settings(); break;
+    case AppCmd::sequencer_start: sequencer_start(); break;
+    case AppCmd::sequencer_stop: sequencer_stop(); break;
+    case AppCmd::set_sequencer_loop: set_sequencer_loop(arg.b); break;
+    case AppCmd::_count: break;
+    }
+}
+
 /* Update all application state settings which need fast polling.
  * This is e.g. ADC conversion and HW overcurrent detection handling
  */
 void AppController::_on_fast_timer_event_update_state() {
+    const auto t_start_us = esp_timer_get_time();
     // True when hardware OC shutdown condition is present
     state.hw_oc_fault_present = pspwm_get_hw_fault_shutdown_present(constants.mcpwm_num);
     // Hardware Fault Shutdown Status is latched using this flag
     state.hw_oc_fault_occurred = pspwm_get_hw_fault_shutdown_occurred(constants.mcpwm_num);
-    // Update temperature sensor values on this occasion.
-    // With averaging of 64 samples, both channels acquisition
-    // takes approx. 9 ms combined.
-    aux_hw_drv.update_temperature_sensors();
-    // Apply setpoint throttling
-    if (state.setpoint_throttling_enabled) {
-        auto values_differ = throttle_value(&state.pspwm_setpoint->ps_duty,
-                                            state.duty_target,
-                                            state.duty_increment);
-        if (values_differ) {
-            _set_duty_raw(state.pspwm_setpoint->ps_duty);
-        }
-        values_differ = throttle_value(&state.pspwm_setpoint->frequency,
-                                       state.frequency_target,
-                                       state.frequency_increment);
-        if (values_differ) {
-            _set_frequency_raw(state.pspwm_setpoint->frequency);
-        }
+    const auto t_fault_done_us = esp_timer_get_time();
+    // Temperature sensor values are acquired by the acquisition task.
+    // This only fetches the latest results, it never blocks.
+    const auto acquisition = _acquisition_mailbox.read();
+    aux_hw_drv.state.temp_1 = acquisition.temp_1;
+    aux_hw_drv.state.temp_2 = acquisition.temp_2;
+    state.acq_exec_time_us = acquisition.exec_time_us;
+    const auto t_acq_done_us = esp_timer_get_time();
+    // Setpoint sequencer progress
+    state.sequencer_active = sequencer.is_active();
+    state.sequencer_loop = sequencer.get_loop();
+    state.sequencer_step = sequencer.get_step_index();
+    state.sequencer_n_steps = sequencer.get_n_steps();
+    state.sequencer_pass = sequencer.get_pass_count();
+    // Setpoint ramps are clocked by their own timer. While in progress,
+    // updates are requested here and rate-limited by the push scheduler.
+    if (ramp_generator.is_active()) {
+        _send_state_changed_event();
+    }
+    // Closed-loop control functions, each running at its own rate
+    control_loops.run_due(t_acq_done_us);
+    _update_fan_output(t_acq_done_us);
+    state.loop_overruns = control_loops.get_overruns();
+    state.ramp_steps_missed = ramp_generator.get_missed_steps();
+    state.ramp_steps_caught_up = ramp_generator.get_caught_up_steps();
+    state.stage_time_fault_us = static_cast<uint32_t>(t_fault_done_us - t_start_us);
+    state.stage_time_acq_us = static_cast<uint32_t>(t_acq_done_us - t_fault_done_us);
+    state.stage_time_ctrl_us = static_cast<uint32_t>(esp_timer_get_time() - t_acq_done_us);
+}
+
+/* Switch the fan according to fan control loop output or manual override
+ */
+void AppController::_update_fan_output(int64_t now_us) {
+    auto fan_active = fan_switching.update(state.fan_duty, now_us)
+                      || aux_hw_drv.state.fan_override;
+    if (fan_active != aux_hw_drv.state.fan_active) {
+        aux_hw_drv.set_fan_active(fan_active);
+        _send_state_changed_event();
+    }
+}
+
+/* Select the fast tick interval depending on activity: The active interval
+ * is used while a ramp or sequence is running plus the idle delay afterwards.
+ */
+bool AppController::_update_tick_interval() {
+    if (!constants.timer_fast_adaptive) {
+        return false;
+    }
+    const auto now_us = esp_timer_get_time();
+    if (ramp_generator.is_active() || sequencer.is_active()) {
+        _last_active_time_us = now_us;
+    }
+    const auto is_idle = now_us - _last_active_time_us
+                         >= constants.timer_fast_idle_delay_ms * 1000ll;
+    const auto interval_ms = is_idle ? constants.timer_fast_interval_idle_ms
+                                     : constants.timer_fast_interval_active_ms;
+    if (interval_ms == state.tick_interval_ms) {
+        return false;
+    }
+    ESP_LOGD(TAG, "Fast tick interval: %d ms", interval_ms);
+    state.tick_interval_ms = interval_ms;
+    if (!constants.app_task_self_clocked) {
+        _attach_fast_timer();
+    }
+    _send_state_changed_event();
+    return true;
+}
+
+/* Update tick sequence number, missed tick and lateness statistics.
+ * Missed ticks are not run again, all fast tick functions use the current
+ * time or run from their own timers (e.g. the setpoint ramps).
+ */
+void AppController::_update_tick_sequence(uint32_t missed_ticks, uint32_t lateness_us) {
+    state.tick_seq += missed_ticks + 1;
+    state.tick_missed += missed_ticks;
+    state.tick_lateness_us = lateness_us;
+    if (lateness_us > state.tick_lateness_max_us) {
+        state.tick_lateness_max_us = lateness_us;
+    }
+    _latency(LatencyStage::tick_lateness).record(lateness_us * _cpu_mhz);
+}
+
+/* Record execution time of the fast tick. An execution time longer than the
+ * fast tick period is counted as an overrun.
+ */
+void AppController::_update_tick_statistics(int64_t exec_time_us) {
+    state.tick_exec_time_us = static_cast<uint32_t>(exec_time_us);
+    if (state.tick_exec_time_us > state.tick_exec_time_max_us) {
+        state.tick_exec_time_max_us = state.tick_exec_time_us;
+    }
+    if (exec_time_us > state.tick_interval_ms * 1000ll) {
+        ++state.tick_overruns;
     }
 }
 
@@ -561,11 +1362,49 @@ void AppController::_evaluate_temperature_sensors() {
     }
 }
 
+/* Handle hardware fault event from the fault interrupt.
+ * The output was already disabled by the MCPWM hardware.
+ */
+void AppController::_on_hw_fault_event() {
+    if (!fault_notifier.take_event(esp_timer_get_time(), &_last_fault_event)) {
+        return;
+    }
+    state.hw_oc_fault_present = pspwm_get_hw_fault_shutdown_present(constants.mcpwm_num);
+    state.hw_oc_fault_occurred = pspwm_get_hw_fault_shutdown_occurred(constants.mcpwm_num);
+    state.oc_fault_count = _last_fault_event.count;
+    state.oc_fault_latency_us = _last_fault_event.latency_us;
+    state.oc_fault_latency_max_us = std::max(state.oc_fault_latency_max_us,
+                                             _last_fault_event.latency_us);
+    ESP_LOGW(TAG, "Hardware fault at %lld us, notification latency: %u us",
+             _last_fault_event.fault_time_us, _last_fault_event.latency_us);
+}
+
+/* Send an SSE alert message for the last hardware fault event.
+ * This is sent as a separate event type so that clients can react on it
+ * without comparing the state telegrams.
+ */
+void AppController::_push_fault_alert() {
+    assert(api_server && api_server->event_source);
+    auto json_buf = std::array<char, 96>{};
+    snprintf(json_buf.data(), json_buf.size(),
+             "{\"fault_time_us\":%lld,\"latency_us\":%u,\"count\":%u}",
+             _last_fault_event.fault_time_us,
+             _last_fault_event.latency_us,
+             _last_fault_event.count);
+    api_server->event_source->send(json_buf.data(), "hw_fault");
+    if (api_server->web_socket && api_server->web_socket->count() > 0) {
+        // Distinguished from the state telegrams by the key
+        auto ws_buf = std::array<char, 112>{};
+        snprintf(ws_buf.data(), ws_buf.size(), "{\"hw_fault\":%s}", json_buf.data());
+        api_server->web_socket->textAll(ws_buf.data());
+    }
+}
+
 /* Called when app state is changed and triggers the respective event.
  * Used for sending push updates to the clients.
  */
 void AppController::_send_state_changed_event() {
-    xEventGroupSetBits(_app_event_group, EventFlags::state_changed);
+    xTaskNotify(_app_event_task_handle, EventFlags::state_changed, eSetBits);
 }
 
 /* Send SSE push update to all connected clients.
@@ -573,30 +1412,78 @@ void AppController::_send_state_changed_event() {
  * Called periodicly (default once per second) but also asynchronously
  * on demand when state_change event is received.
  */
-void AppController::_push_state_update() {
+void AppController::_push_state_update(bool keyframe) {
     assert(api_server && api_server->event_source);
-    auto json_buf = std::array<char, AppState::json_buf_len>{};
-    state.serialize_full_state(json_buf.data(), AppState::json_buf_len);
-    api_server->event_source->send(json_buf.data(), "hw_app_state");
+    const auto t_start_cycles = LatencyHistogram::now_cycles();
+    // Serializes the last published snapshot, see _app_event_task()
+    const auto snap = state.snapshot.read();
+    const auto now_us = esp_timer_get_time();
+    if (!constants.sse_delta_telegrams
+        || now_us - _last_keyframe_time_us >= constants.sse_keyframe_interval_ms * 1000ll) {
+        keyframe = true;
+    }
+    // A telegram dropped for a client with a full send queue leaves its
+    // delta baseline out of sync. All clients share the baseline, so all
+    // get a keyframe as soon as the queues have room again.
+    if (api_server->have_full_client_queue()) {
+        _resync_pending = true;
+    } else if (_resync_pending) {
+        _resync_pending = false;
+        keyframe = true;
+    }
+    if (keyframe) {
+        AppState::serialize_snapshot(snap, _json_buf.data(), _json_buf.size());
+        _last_sent_state = snap;
+        _last_keyframe_time_us = now_us;
+    } else {
+        // Empty delta telegrams are sent as well, clients use the periodic
+        // updates as a heartbeat.
+        AppState::serialize_snapshot(snap, _json_buf.data(), _json_buf.size(),
+                                     &_last_sent_state);
+    }
+    api_server->event_source->send(_json_buf.data(), "hw_app_state");
+    if (api_server->web_socket && api_server->web_socket->count() > 0) {
+        api_server->web_socket->textAll(_json_buf.data());
+    }
+    if ((api_server->event_source_bin && api_server->event_source_bin->count() > 0)
+            || (api_server->web_socket_bin && api_server->web_socket_bin->count() > 0)) {
+        _push_state_update_bin(snap);
+    }
+    _latency(LatencyStage::push_update).record_since(t_start_cycles);
 }
 
-/* Perform setpoint change rate throttling to a value at ptr x_current
- * by adding or subtracting a maximum x_increment for each invocation
- * of this function until the final value x_target is reached.
- * This does float equality evaluation w/o epsilon which should be safe here
- * as it is done only after adding/subtracting an exact float type difference.
+/* SSE data must be text, so the binary telegram is base64-encoded.
+ * WebSocket clients get binary frames without encoding.
+ * This is always the complete state, there are no binary delta telegrams.
  */
-bool throttle_value(float *x_current, float x_target, float x_increment) {
-    auto dx = x_target - *x_current;
-    if (dx == 0.0f) {
-        return false;
+void AppController::_push_state_update_bin(const AppStateSnapshot &snap) {
+    const auto bin_len = AppState::serialize_snapshot_bin(snap, _bin_buf.data(),
+                                                          _bin_buf.size());
+    if (api_server->web_socket_bin && api_server->web_socket_bin->count() > 0) {
+        api_server->web_socket_bin->binaryAll(reinterpret_cast<const char*>(_bin_buf.data()),
+                                              bin_len);
     }
-    ESP_LOGD(TAG, "Throttling. Value is: %f.  Target: %f.  Increment: %f.",
-                  *x_current, x_target, x_increment);
-    if (dx > 0.0f) {
-        *x_current += std::min(dx, x_increment);
-    } else { // (dx < 0.0f)
-        *x_current += std::max(dx, -x_increment);
+    if (!api_server->event_source_bin || api_server->event_source_bin->count() == 0) {
+        return;
     }
-    return true;
+    auto b64_len = size_t{0};
+    auto errors = mbedtls_base64_encode(reinterpret_cast<unsigned char*>(_b64_buf.data()),
+                                        _b64_buf.size(), &b64_len, _bin_buf.data(), bin_len);
+    if (errors) {
+        ESP_LOGE(TAG, "Base64 encoding of the binary state telegram failed!");
+        return;
+    }
+    api_server->event_source_bin->send(_b64_buf.data(), "hw_app_state_bin");
+}
+
+/* Number of FreeRTOS ticks until the next rate-limited state update is due
+ */
+TickType_t AppController::_ticks_until_push_due() const {
+    auto due_us = _push_scheduler.get_next_due_time();
+    if (due_us == PushScheduler::none_pending) {
+        return portMAX_DELAY;
+    }
+    auto wait_us = std::max(due_us - esp_timer_get_time(), int64_t{0});
+    // Round up, waking up early would only cause an extra loop pass
+    return pdMS_TO_TICKS((wait_us + 999) / 1000);
 }
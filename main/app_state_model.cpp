@@ -1,7 +1,12 @@
 #include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
 
-#include "MD5Builder.h"
 #include "SPIFFS.h"
+#include "nvs.h"
+#include "esp_rom_crc.h"
 
 #undef LOG_LOCAL_LEVEL
 #define LOG_LOCAL_LEVEL ESP_LOG_INFO
@@ -9,146 +14,509 @@
 static auto TAG = "app_state_model.cpp";
 
 #include "fs_io.hpp"
+#include "json_stream_writer.hpp"
 #include "app_state_model.hpp"
 
 
-/* Serialize application runtime state and configurable settings
- * into buffer as a JSON string.
+/* Copy all live values into a new AppStateSnapshot
  */
-size_t AppState::serialize_full_state(char *buf, size_t buf_len) {
+AppStateSnapshot AppState::take_snapshot() const {
     assert(pspwm_clk_conf && pspwm_setpoint && pspwm_setpoint_limits && aux_hw_drv_state);
-    // ArduinoJson JsonDocument object, see https://arduinojson.org
-    auto json_doc = StaticJsonDocument<_json_objects_size>{};
-    // Setpoint throttling / soft-start feature activated/deactivated
-    json_doc["setpoint_throttling_enabled"] = setpoint_throttling_enabled;
-    // Clock divider settings (read-only) [number factor]
-    json_doc["base_div"] = pspwm_clk_conf->base_clk_prescale;
-    json_doc["timer_div"] = pspwm_clk_conf->timer_clk_prescale;
-    // Hardware setpoint limits (maximum adjustment range) for output frequency [kHz]
-    json_doc["frequency_min_hw"] = pspwm_setpoint_limits->frequency_min * 1e-3f;
-    json_doc["frequency_max_hw"] = pspwm_setpoint_limits->frequency_max * 1e-3f;
-    // User setpoint limits (custom adjustment range) for output frequency [kHz]
-    json_doc["frequency_min"] = frequency_min * 1e-3f;
-    json_doc["frequency_max"] = frequency_max * 1e-3f;
-    // PWM output frequency setpoint [kHz]
-    json_doc["frequency"] = pspwm_setpoint->frequency * 1e-3f;
-    //json_doc["frequency"] = frequency_target * 1e-3f;
-    // Setpoint throttling / soft-start speed for output frequency [kHz/sec]
-    json_doc["frequency_changerate"] = frequency_increment / constants.timer_fast_interval_ms;
-    // User setpoint limits (custom adjustment range) for PWM result duty cycle [%]
-    json_doc["duty_min"] = duty_min * 100.0f;
-    json_doc["duty_max"] = duty_max * 100.0f;
-    // PWM result duty cycle setpoint [%]
-    json_doc["duty"] = pspwm_setpoint->ps_duty * 100.0f;
-    //json_doc["duty"] = duty_target * 100.0f;
-    // Setpoint throttling / soft-start speed for PWM result duty cycle [kHz/sec]
-    json_doc["duty_changerate"] = duty_increment * 1e5f / constants.timer_fast_interval_ms;
-    // Hardware limits for dead-time adjustment [ns]. Sum of dead-times must be smaller.
-    json_doc["dt_sum_max_hw"] = pspwm_setpoint_limits->dt_sum_max * 1e9f;
-    // Dead-time setpoint for leading and lagging half-bridge leg [ns]
-    json_doc["lead_dt"] = pspwm_setpoint->lead_red * 1e9f;
-    json_doc["lag_dt"] = pspwm_setpoint->lag_red * 1e9f;
-    // Power stage overcurrent limit (depends on measurement shunt value) [A]
-    json_doc["current_limit"] = aux_hw_drv_state->current_limit;
-    // Overtemperature protection limits for sensor channels 1 and 2 [°C]
-    json_doc["temp_1_limit"] = aux_hw_drv_state->temp_1_limit;
-    json_doc["temp_2_limit"] = aux_hw_drv_state->temp_2_limit;
-    // Temperature sensor readout for channels 1 and 2 [°C]
-    json_doc["temp_1"] = aux_hw_drv_state->temp_1;
-    json_doc["temp_2"] = aux_hw_drv_state->temp_2;
-    // Heatsink fan activated/deactivated
-    json_doc["fan_active"] = aux_hw_drv_state->fan_active;
-    // Fan override activated/deactivated:
-    // When set to "true", fan is always ON. Otherwise, fan is temperature-controlled
-    json_doc["fan_override"] = aux_hw_drv_state->fan_override;
-    // Power output relays on/off
-    json_doc["relay_ref_active"] = aux_hw_drv_state->relay_ref_active;
-    json_doc["relay_dut_active"] = aux_hw_drv_state->relay_dut_active;
-    // Gate driver supply and disable signal status (reat-only)
-    json_doc["drv_supply_active"] = aux_hw_drv_state->drv_supply_active;
-    json_doc["drv_disabled"] = aux_hw_drv_state->drv_disabled;
-    // PWM output signal activated/deactivated
-    json_doc["power_pwm_active"] = pspwm_setpoint->output_enabled;
-    // Hardware Fault Shutdown Status is latched using this flag (read-only)
-    json_doc["hw_oc_fault"] = hw_oc_fault_occurred;
-    // Overtemperature shutdown active flag (read-only)
-    json_doc["hw_overtemp"] = aux_hw_drv_state->hw_overtemp;
-    // Length of the power output one-shot timer pulse [seconds]
-    json_doc["oneshot_len"] = oneshot_power_pulse_length_ms * 1e-3f;
-    // Do the serialization
-    auto json_size = serializeJson(json_doc, buf, buf_len);
-    // Should the API increase in the future, we need to observe stack usage...
-    // (See app_event_task_stack_size in app_config.hpp)
-    //auto stack_usage = uxTaskGetStackHighWaterMark(NULL);
-    //ESP_LOGD(TAG, "JSON serialisation task minimum stack size: %d", stack_usage);
+    auto snap = AppStateSnapshot{};
+    snap.setpoint_throttling_enabled = setpoint_throttling_enabled;
+    snap.base_clk_prescale = pspwm_clk_conf->base_clk_prescale;
+    snap.timer_clk_prescale = pspwm_clk_conf->timer_clk_prescale;
+    snap.frequency_min_hw = pspwm_setpoint_limits->frequency_min;
+    snap.frequency_max_hw = pspwm_setpoint_limits->frequency_max;
+    snap.frequency_min = frequency_min;
+    snap.frequency_max = frequency_max;
+    snap.frequency = pspwm_setpoint->frequency;
+    snap.frequency_changerate = frequency_changerate;
+    snap.duty_min = duty_min;
+    snap.duty_max = duty_max;
+    snap.duty = pspwm_setpoint->ps_duty;
+    snap.duty_changerate = duty_changerate;
+    snap.ramp_profile = ramp_profile;
+    snap.dt_sum_max_hw = pspwm_setpoint_limits->dt_sum_max;
+    snap.lead_dt = pspwm_setpoint->lead_red;
+    snap.lag_dt = pspwm_setpoint->lag_red;
+    snap.power_pwm_active = pspwm_setpoint->output_enabled;
+    snap.hw_oc_fault_occurred = hw_oc_fault_occurred;
+    snap.oneshot_power_pulse_length_us = oneshot_power_pulse_length_us;
+    snap.sequencer_active = sequencer_active;
+    snap.sequencer_loop = sequencer_loop;
+    snap.sequencer_step = sequencer_step;
+    snap.sequencer_n_steps = sequencer_n_steps;
+    snap.sequencer_pass = sequencer_pass;
+    snap.stage_time_fault_us = stage_time_fault_us;
+    snap.stage_time_acq_us = stage_time_acq_us;
+    snap.stage_time_ctrl_us = stage_time_ctrl_us;
+    snap.acq_exec_time_us = acq_exec_time_us;
+    snap.oc_fault_count = oc_fault_count;
+    snap.oc_fault_latency_us = oc_fault_latency_us;
+    snap.oc_fault_latency_max_us = oc_fault_latency_max_us;
+    snap.fan_setpoint = fan_setpoint;
+    snap.fan_kp = fan_kp;
+    snap.fan_ki = fan_ki;
+    snap.fan_duty = fan_duty;
+    snap.loop_overruns = loop_overruns;
+    snap.tick_interval_ms = tick_interval_ms;
+    snap.tick_seq = tick_seq;
+    snap.tick_missed = tick_missed;
+    snap.tick_lateness_us = tick_lateness_us;
+    snap.tick_lateness_max_us = tick_lateness_max_us;
+    snap.ramp_steps_missed = ramp_steps_missed;
+    snap.ramp_steps_caught_up = ramp_steps_caught_up;
+    snap.tick_overruns = tick_overruns;
+    snap.tick_exec_time_us = tick_exec_time_us;
+    snap.tick_exec_time_max_us = tick_exec_time_max_us;
+    snap.pushes_suppressed = pushes_suppressed;
+    snap.cmd_seq = cmd_seq;
+    snap.aux = *aux_hw_drv_state;
+    return snap;
+}
+
+/* Take a snapshot and publish it for the readers of "snapshot".
+ */
+void AppState::publish_snapshot() {
+    snapshot.write(take_snapshot());
+}
+
+namespace {
+// Snapshot values have the same size as in the binary telegram
+static_assert(sizeof(bool) == 1 && sizeof(float) == 4, "Unsupported platform");
+
+template<typename T>
+T read_field(const AppStateSnapshot &snap, const StateField &field) {
+    auto value = T{};
+    std::memcpy(&value, reinterpret_cast<const char*>(&snap) + field.offset, sizeof(T));
+    return value;
+}
+
+/* For delta telegrams, see StateField
+ */
+bool has_changed(const StateField &field,
+                 const AppStateSnapshot &snap, const AppStateSnapshot &last) {
+    switch (field.type) {
+    case FieldType::boolean:
+        return read_field<bool>(snap, field) != read_field<bool>(last, field);
+    case FieldType::uint8:
+        return read_field<uint8_t>(snap, field) != read_field<uint8_t>(last, field);
+    case FieldType::uint32: {
+        auto value = read_field<uint32_t>(snap, field);
+        auto last_value = read_field<uint32_t>(last, field);
+        auto diff = value > last_value ? value - last_value : last_value - value;
+        return diff * field.scale > field.epsilon;
+    }
+    case FieldType::float32: {
+        auto value = read_field<float>(snap, field);
+        auto last_value = read_field<float>(last, field);
+        auto diff = std::fabs((value - last_value) * field.scale);
+        return diff > field.epsilon || (field.epsilon == 0.0f && value != last_value);
+    }
+    }
+    return true;
+}
+
+void write_field(JsonStreamWriter &writer, const StateField &field,
+                 const AppStateSnapshot &snap) {
+    writer.key(field.key);
+    switch (field.type) {
+    case FieldType::boolean:
+        writer.value(read_field<bool>(snap, field));
+        break;
+    case FieldType::uint8:
+        writer.value(uint32_t{read_field<uint8_t>(snap, field)});
+        break;
+    case FieldType::uint32:
+        if (field.scale == 1.0f) {
+            writer.value(read_field<uint32_t>(snap, field));
+        } else {
+            writer.value(read_field<uint32_t>(snap, field) * field.scale,
+                         field.decimal_places);
+        }
+        break;
+    case FieldType::float32:
+        writer.value(read_field<float>(snap, field) * field.scale,
+                     field.decimal_places);
+        break;
+    }
+}
+
+/* Writes the values listed in state_schema directly into the output
+ * buffer. For delta telegrams, see StateField.
+ */
+size_t write_telegram(const AppStateSnapshot &snap, char *buf, size_t buf_len,
+                      AppStateSnapshot *last_sent) {
+    auto writer = JsonStreamWriter{buf, buf_len};
+    writer.begin_object();
+    for (const auto &field : state_schema) {
+        if (last_sent) {
+            if (!has_changed(field, snap, *last_sent)) {
+                continue;
+            }
+            std::memcpy(reinterpret_cast<char*>(last_sent) + field.offset,
+                        reinterpret_cast<const char*>(&snap) + field.offset,
+                        state_field_bin_size(field.type));
+        }
+        write_field(writer, field, snap);
+    }
+    writer.end_object();
+    auto json_size = writer.finish();
+    if (writer.has_overflowed()) {
+        ESP_LOGE(TAG, "State telegram buffer too small!");
+    }
     return json_size;
 }
 
-/* Restore application runtime configurable settings
- * from json string in buffer back into this instance.
+template<typename T>
+void write_snapshot_field(AppStateSnapshot &snap, const StateField &field, T value) {
+    std::memcpy(reinterpret_cast<char*>(&snap) + field.offset, &value, sizeof(T));
+}
+
+/* Stores a JSON value in telegram units into the snapshot.
+ * Returns false if the JSON type does not match.
  */
-bool AppState::deserialize_settings(const char *buf, size_t buf_len) {
-    assert(pspwm_clk_conf && pspwm_setpoint && pspwm_setpoint_limits && aux_hw_drv_state);
-    // Size of the ArduinoJSON doc object must be larger here than when serializing..
-    auto json_doc = StaticJsonDocument<json_buf_len>{};
+bool read_json_field(const StateField &field, JsonVariantConst json_value,
+                     AppStateSnapshot &snap) {
+    switch (field.type) {
+    case FieldType::boolean:
+        if (!json_value.is<bool>()) {
+            return false;
+        }
+        write_snapshot_field(snap, field, json_value.as<bool>());
+        return true;
+    case FieldType::uint8:
+        if (!json_value.is<uint8_t>()) {
+            return false;
+        }
+        write_snapshot_field(snap, field, json_value.as<uint8_t>());
+        return true;
+    case FieldType::uint32:
+        if (!json_value.is<float>()) {
+            return false;
+        }
+        write_snapshot_field(snap, field, static_cast<uint32_t>(
+            std::lround(json_value.as<float>() / field.scale)));
+        return true;
+    case FieldType::float32:
+        if (!json_value.is<float>()) {
+            return false;
+        }
+        write_snapshot_field(snap, field, json_value.as<float>() / field.scale);
+        return true;
+    }
+    return false;
+}
+
+/* Setter argument in telegram units
+ */
+CmdArg get_setter_arg(const StateField &field, const AppStateSnapshot &snap) {
+    switch (field.type) {
+    case FieldType::boolean:
+        return CmdArg{read_field<bool>(snap, field)};
+    case FieldType::uint8:
+        return CmdArg{static_cast<int>(read_field<uint8_t>(snap, field))};
+    case FieldType::uint32:
+        if (field.scale == 1.0f) {
+            return CmdArg{static_cast<int>(read_field<uint32_t>(snap, field))};
+        }
+        return CmdArg{read_field<uint32_t>(snap, field) * field.scale};
+    case FieldType::float32:
+        return CmdArg{read_field<float>(snap, field) * field.scale};
+    }
+    return CmdArg{};
+}
+
+void put_uint16(uint8_t *buf, uint16_t value) {
+    buf[0] = static_cast<uint8_t>(value);
+    buf[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void put_uint32(uint8_t *buf, uint32_t value) {
+    for (auto i = 0; i < 4; ++i) {
+        buf[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+uint16_t get_uint16(const uint8_t *buf) {
+    return static_cast<uint16_t>(buf[0] | buf[1] << 8);
+}
+
+uint32_t get_uint32(const uint8_t *buf) {
+    return uint32_t{buf[0]} | uint32_t{buf[1]} << 8
+           | uint32_t{buf[2]} << 16 | uint32_t{buf[3]} << 24;
+}
+
+const StateField *find_persisted_field(const char *key) {
+    for (const auto &field : state_schema) {
+        if (field.persisted && std::strcmp(field.key, key) == 0) {
+            return &field;
+        }
+    }
+    return nullptr;
+}
+
+/* Match the key directory of a settings blob written with a different
+ * schema against state_schema. Values which are no longer persisted or
+ * changed their type are skipped.
+ */
+bool migrate_settings_values(const uint8_t *keys, size_t keys_len,
+                             const uint8_t *values, size_t values_len,
+                             size_t n_fields, AppStateSnapshot &settings) {
+    auto key_pos = size_t{0};
+    auto value_pos = size_t{0};
+    for (size_t i = 0; i < n_fields; ++i) {
+        const auto key = reinterpret_cast<const char*>(keys + key_pos);
+        const auto key_len = strnlen(key, keys_len - key_pos);
+        // Key, null and type byte must be inside the directory
+        if (key_pos + key_len + 2 > keys_len) {
+            return false;
+        }
+        const auto type = static_cast<FieldType>(keys[key_pos + key_len + 1]);
+        key_pos += key_len + 2;
+        const auto size = state_field_bin_size(type);
+        if (size == 0 || value_pos + size > values_len) {
+            return false;
+        }
+        const auto field = find_persisted_field(key);
+        if (field && field->type == type) {
+            std::memcpy(reinterpret_cast<char*>(&settings) + field->offset,
+                        values + value_pos, size);
+        } else {
+            ESP_LOGW(TAG, "Stored setting not restored: %s", key);
+        }
+        value_pos += size;
+    }
+    return true;
+}
+} // namespace
+
+/* Serialize an application state snapshot into buffer as a JSON string.
+ */
+size_t AppState::serialize_snapshot(const AppStateSnapshot &snap,
+                                    char *buf, size_t buf_len,
+                                    AppStateSnapshot *last_sent) {
+    return write_telegram(snap, buf, buf_len, last_sent);
+}
+
+/* Serialize an application state snapshot into buffer as a binary telegram.
+ *
+ * Values are copied as-is, as the ESP32 is little-endian.
+ */
+size_t AppState::serialize_snapshot_bin(const AppStateSnapshot &snap,
+                                        uint8_t *buf, size_t buf_len) {
+    if (buf_len < bin_buf_len) {
+        ESP_LOGE(TAG, "Binary state telegram buffer too small!");
+        return 0;
+    }
+    buf[0] = bin_format_version;
+    buf[1] = 0;
+    buf[2] = static_cast<uint8_t>(n_state_fields);
+    buf[3] = static_cast<uint8_t>(n_state_fields >> 8);
+    for (auto i = 0; i < 4; ++i) {
+        buf[4 + i] = static_cast<uint8_t>(bin_schema_hash >> (8 * i));
+    }
+    auto pos = bin_header_len;
+    for (const auto &field : state_schema) {
+        const auto size = state_field_bin_size(field.type);
+        std::memcpy(buf + pos, reinterpret_cast<const char*>(&snap) + field.offset, size);
+        pos += size;
+    }
+    return pos;
+}
+
+/* Read application runtime configurable settings from json string in
+ * buffer into the persisted values of settings.
+ *
+ * Values missing in the JSON string are left unchanged.
+ */
+bool AppState::deserialize_settings(const char *buf, size_t buf_len,
+                                    AppStateSnapshot &settings) {
+    auto json_doc = StaticJsonDocument<json_doc_size>{};
     auto errors = deserializeJson(json_doc, buf, buf_len);
     if (errors != DeserializationError::Ok) {
         ESP_LOGE(TAG, "Error deserialising the JSON settings!\n Error code: %s", errors.c_str());
         return false;
     }
-    ///// We restore only a limited sub-set of all values...
-    setpoint_throttling_enabled = json_doc["setpoint_throttling_enabled"];
-    // Clock divider settings
-    pspwm_clk_conf->base_clk_prescale = uint8_t{json_doc["base_div"]};
-    pspwm_clk_conf->timer_clk_prescale = uint8_t{json_doc["timer_div"]};
-    // Runtime user setpoint limits for output frequency
-    frequency_min = float{json_doc["frequency_min"]} * 1e3f;
-    frequency_max = float{json_doc["frequency_max"]} * 1e3f;
-    // Operational setpoints for PSPWM module
-    frequency_target = float{json_doc["frequency"]} * 1e3f;
-    frequency_increment = float{json_doc["frequency_changerate"]} * constants.timer_fast_interval_ms;
-    duty_min = float{json_doc["duty_min"]} * 0.01f;
-    duty_max = float{json_doc["duty_max"]} * 0.01f;
-    duty_target = float{json_doc["duty"]} * 0.01f;
-    duty_increment = float{json_doc["duty_changerate"]} * constants.timer_fast_interval_ms * 1e-5f;;
-    pspwm_setpoint->lead_red = float{json_doc["lead_dt"]} * 1e-9f;
-    pspwm_setpoint->lag_red = float{json_doc["lag_dt"]} * 1e-9f;
-    // Power stage current limit
-    aux_hw_drv_state->current_limit = float{json_doc["current_limit"]};
-    // Overtemperature shutdown limits and fan control
-    aux_hw_drv_state->temp_1_limit = float{json_doc["temp_1_limit"]};
-    aux_hw_drv_state->temp_2_limit = float{json_doc["temp_2_limit"]};
-    aux_hw_drv_state->fan_override = json_doc["fan_override"];
-    // Power output relays
-    aux_hw_drv_state->relay_ref_active = json_doc["relay_ref_active"];
-    aux_hw_drv_state->relay_dut_active = json_doc["relay_dut_active"];
-    // Length of the power output one-shot timer pulse
-    oneshot_power_pulse_length_ms = static_cast<uint32_t>(float{json_doc["oneshot_len"]} * 1e3f);
+    for (const auto &field : state_schema) {
+        if (!field.persisted) {
+            continue;
+        }
+        auto json_value = json_doc[field.key].as<JsonVariantConst>();
+        if (json_value.isNull()) {
+            continue;
+        }
+        if (!read_json_field(field, json_value, settings)) {
+            ESP_LOGE(TAG, "Invalid type of setting: %s", field.key);
+        }
+    }
     return true;
 }
 
-/* Write application runtime configurable settings as JSON to SPIFFs file.
+/* Call the setters of all persisted values in state_schema order
  */
-bool AppState::save_to_file(const char *filename) {
-    auto json_buf = std::array<char, json_buf_len>{};
-    auto json_size = serialize_full_state(json_buf.data(), json_buf_len);
-    auto json_buf_uint8 = reinterpret_cast<uint8_t*>(json_buf.data());
-    auto is_ok = FSIO::write_to_file_uint8(filename, json_buf_uint8, json_size);
-    auto md5_builder = MD5Builder{};
-    md5_builder.begin();
-    md5_builder.add(json_buf_uint8, json_size);
-    md5_builder.calculate();
-    // MD5 sum of JSON string has length 32 + null byte = 33.
-    auto json_md5 = std::array<char, 33>{};
-    md5_builder.getChars(json_md5.data());
-    ESP_LOGI(TAG, "MD5 sum: %s", json_md5.data());
-    return is_ok;
-}
-
-/* Restore application runtime configurable settings
- * from SPIFFs file back into this instance.
- */
-bool AppState::restore_from_file(const char *filename) {
+void AppState::apply_settings(const AppStateSnapshot &settings,
+                              const SettingSetterT &apply_setting) {
+    for (const auto &field : state_schema) {
+        if (field.persisted) {
+            apply_setting(field.setter, get_setter_arg(field, settings));
+        }
+    }
+}
+
+/* Serialize the persisted values of a snapshot into buffer as a binary
+ * settings blob. Values are copied as-is, as the ESP32 is little-endian.
+ */
+size_t AppState::serialize_settings_blob(const AppStateSnapshot &snap,
+                                         uint8_t *buf, size_t buf_len) {
+    if (buf_len < settings_blob_len) {
+        ESP_LOGE(TAG, "Settings blob buffer too small!");
+        return 0;
+    }
+    auto key_pos = settings_header_len;
+    auto value_pos = settings_header_len + settings_keys_len;
+    for (const auto &field : state_schema) {
+        if (!field.persisted) {
+            continue;
+        }
+        const auto key_size = std::strlen(field.key) + 1;
+        std::memcpy(buf + key_pos, field.key, key_size);
+        key_pos += key_size;
+        buf[key_pos++] = static_cast<uint8_t>(field.type);
+        const auto size = state_field_bin_size(field.type);
+        std::memcpy(buf + value_pos, reinterpret_cast<const char*>(&snap) + field.offset, size);
+        value_pos += size;
+    }
+    put_uint32(buf, settings_blob_magic);
+    put_uint16(buf + 4, settings_blob_version);
+    put_uint16(buf + 6, static_cast<uint16_t>(n_persisted_fields));
+    put_uint32(buf + 8, settings_schema_hash);
+    put_uint16(buf + 12, static_cast<uint16_t>(settings_keys_len));
+    put_uint16(buf + 14, static_cast<uint16_t>(settings_values_len));
+    put_uint32(buf + 16, esp_rom_crc32_le(0, buf + settings_header_len,
+                                          settings_blob_len - settings_header_len));
+    return settings_blob_len;
+}
+
+/* Read a settings blob into the persisted values of settings.
+ *
+ * Blobs written with the current schema are copied directly, others are
+ * migrated using the key directory of the blob.
+ */
+esp_err_t AppState::deserialize_settings_blob(const uint8_t *buf, size_t buf_len,
+                                              AppStateSnapshot &settings) {
+    if (buf_len < settings_header_len || get_uint32(buf) != settings_blob_magic) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    const auto version = get_uint16(buf + 4);
+    const auto n_fields = get_uint16(buf + 6);
+    const auto schema_hash = get_uint32(buf + 8);
+    const size_t keys_len = get_uint16(buf + 12);
+    const size_t values_len = get_uint16(buf + 14);
+    // Future blob format versions must be handled here
+    if (version != settings_blob_version) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    if (settings_header_len + keys_len + values_len != buf_len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (get_uint32(buf + 16) != esp_rom_crc32_le(0, buf + settings_header_len,
+                                                 buf_len - settings_header_len)) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    const auto keys = buf + settings_header_len;
+    const auto values = keys + keys_len;
+    if (schema_hash == settings_schema_hash && n_fields == n_persisted_fields
+            && values_len == settings_values_len) {
+        auto pos = size_t{0};
+        for (const auto &field : state_schema) {
+            if (field.persisted) {
+                const auto size = state_field_bin_size(field.type);
+                std::memcpy(reinterpret_cast<char*>(&settings) + field.offset,
+                            values + pos, size);
+                pos += size;
+            }
+        }
+        return ESP_OK;
+    }
+    ESP_LOGI(TAG, "Migrating settings from schema %08x", schema_hash);
+    // Settings stay unchanged if the key directory is inconsistent
+    auto migrated = settings;
+    if (!migrate_settings_values(keys, keys_len, values, values_len,
+                                 n_fields, migrated)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    settings = migrated;
+    return ESP_OK;
+}
+
+/* Write a settings blob to NVS.
+ *
+ * NVS updates an item only after the new data has been written completely,
+ * so a power loss during the write keeps the previous blob.
+ */
+esp_err_t AppState::write_settings_blob(const uint8_t *buf, size_t len) {
+    auto nvs_handle = nvs_handle_t{};
+    auto err = nvs_open(constants.settings_nvs_namespace, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(nvs_handle, constants.settings_nvs_key, buf, len);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+/* Read the settings blob from NVS into buf. On input, len is the buffer size.
+ */
+esp_err_t AppState::read_settings_blob(uint8_t *buf, size_t *len) {
+    auto nvs_handle = nvs_handle_t{};
+    // Namespace does not exist before the first save
+    auto err = nvs_open(constants.settings_nvs_namespace, NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_get_blob(nvs_handle, constants.settings_nvs_key, buf, len);
+    nvs_close(nvs_handle);
+    return err;
+}
+
+/* Write application runtime configurable settings to NVS as binary blob
+ */
+bool AppState::save_to_nvs(const AppStateSnapshot &settings) {
+    auto blob = std::array<uint8_t, settings_blob_len>{};
+    auto blob_len = serialize_settings_blob(settings, blob.data(), blob.size());
+    auto err = write_settings_blob(blob.data(), blob_len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error saving settings to NVS: %s", esp_err_to_name(err));
+        return false;
+    }
+    ESP_LOGI(TAG, "Saved %d bytes of settings to NVS", blob_len);
+    return true;
+}
+
+/* Read application runtime configurable settings from NVS binary blob
+ */
+esp_err_t AppState::restore_from_nvs(AppStateSnapshot &settings) {
+    auto blob = std::array<uint8_t, settings_blob_max_len>{};
+    auto blob_len = blob.size();
+    auto err = read_settings_blob(blob.data(), &blob_len);
+    if (err == ESP_OK) {
+        err = deserialize_settings_blob(blob.data(), blob_len, settings);
+    }
+    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGE(TAG, "Could not restore settings from NVS: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+/* Read application runtime configurable settings from JSON file written
+ * by earlier firmware versions
+ */
+bool AppState::restore_from_file(const char *filename, AppStateSnapshot &settings) {
     if (!SPIFFS.exists(filename)) {
         ESP_LOGI(TAG, "No stored settings found");
         return false;
@@ -156,5 +524,5 @@ bool AppState::restore_from_file(const char *filename) {
     auto json_buf = std::array<char, json_buf_len>{};
     auto json_buf_uint8 = reinterpret_cast<uint8_t*>(json_buf.data());
     auto len = FSIO::read_from_file_uint8(filename, json_buf_uint8, json_buf_len);
-    return deserialize_settings(json_buf.data(), len);
+    return deserialize_settings(json_buf.data(), len, settings);
 }
\ No newline at end of file
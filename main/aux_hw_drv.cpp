@@ -117,13 +117,19 @@ void AuxHwDrv::reset_oc_shutdown_finish() {
  * To be called periodically from fast timer event.
  */
 void AuxHwDrv::update_temperature_sensors() {
+    read_temperature_sensors(&state.temp_1, &state.temp_2);
+}
+
+/* Get temperature sensor values via ADC without updating the state structure
+ */
+void AuxHwDrv::read_temperature_sensors(float *temp_1, float *temp_2) {
     sensor_temp_1.update_filter();
     sensor_temp_2.update_filter();
-    state.temp_1 = sensor_temp_1.get_temp_pwl();
-    state.temp_2 = sensor_temp_2.get_temp_pwl();
+    *temp_1 = sensor_temp_1.get_temp_pwl();
+    *temp_2 = sensor_temp_2.get_temp_pwl();
 }
 
-/* Check if temperature exceeds threshold values, switch fan and
+/* Check if temperature exceeds threshold values and
  * set overtemperature shutdown flag accordingly
  * 
  * To be called periodically from slow timer event
@@ -133,16 +139,4 @@ void AuxHwDrv::evaluate_temperature_sensors() {
             || state.temp_2 > state.temp_2_limit) {
         state.hw_overtemp = true;
     }
-    auto fan_active = state.fan_active;
-    if (       state.temp_1 >= aux_hw_conf.temp_1_fan_threshold_hi
-            || state.temp_2 >= aux_hw_conf.temp_2_fan_threshold_hi
-            || state.fan_override) {
-        fan_active = true;
-    } else if (state.temp_1 < aux_hw_conf.temp_1_fan_threshold_lo
-               && state.temp_2 < aux_hw_conf.temp_2_fan_threshold_lo) {
-        fan_active = false;
-    }
-    if (fan_active != state.fan_active) {
-        set_fan_active(fan_active);
-    }
 }
@@ -105,11 +105,27 @@ struct APIServerConfig
     // defined in separate header http_content.hpp
     bool api_is_ajax = true;
     const char* ajax_return_text = "OK";
+    // Add a Server-Timing header to the API endpoint responses, containing
+    // the command dispatch time plus any application-provided metrics.
+    // See browser developer tools, network tab, "Timing".
+    bool server_timing_header = true;
 
     // Activate Server-Sent-Event source
     bool use_sse = true;
     // Default URL for the SSE endpoint is "/events"
     const char* sse_endpoint = "/events";
+    // Second SSE endpoint for binary state telegrams, nullptr to disable.
+    // Clients choose the format by the endpoint they connect to.
+    const char* sse_bin_endpoint = "/events_bin";
+
+    // WebSocket endpoints carrying commands and state telegrams on one
+    // persistent connection, nullptr to disable. "/ws" sends the JSON state
+    // telegrams as text frames, "/ws_bin" the binary state telegrams as
+    // binary frames. Commands are accepted on both.
+    const char* ws_endpoint = "/ws";
+    const char* ws_bin_endpoint = "/ws_bin";
+    // Oldest clients are disconnected when there are more on one endpoint
+    uint16_t ws_max_clients = 4;
 
     // When set to true, reboot the system on request or after updates
     bool reboot_enabled = false;
@@ -133,7 +149,9 @@ struct AppConstants
     constexpr AppConstants(){};
 
     ///////////////////////////// For AppController ///////////////////////////
-    // App state serialization using the ArduionJSON module takes a lot of it
+    // The state telegram buffers are AppController members, not on the stack.
+    // Largest stack users are the state snapshot copies and ESP_LOGx calls.
+    // Check uxTaskGetStackHighWaterMark() on the target before reducing this.
     uint32_t app_event_task_stack_size = 4096;
     // Arduino loop task has 1; async_tcp task has 3.
     // Assuming 2 is a good choice in-between..
@@ -142,14 +160,111 @@ struct AppConstants
     BaseType_t app_event_task_core_id = APP_CPU_NUM;
     // Fast timer for ADC conversion triggering etc. Default is 20.
     // Set to 50 when log level DEBUG is set for AppController.
+    // See the stats_endpoint histograms for the actual execution times.
+    // Must be a multiple of the FreeRTOS tick period (1 ms).
+    // This is the fixed interval when the adaptive tick rate is disabled.
     uint32_t timer_fast_interval_ms = 20;
+    // With adaptive tick rate, the fast tick runs at the active interval
+    // while a setpoint ramp or sequence is running and for the idle delay
+    // afterwards. Otherwise, it runs at the idle interval, which saves CPU
+    // time. The acquisition interval is extended to the idle interval too.
+    bool timer_fast_adaptive = true;
+    uint32_t timer_fast_interval_active_ms = 1;
+    uint32_t timer_fast_interval_idle_ms = 100;
+    uint32_t timer_fast_idle_delay_ms = 1000;
+    // When true, the application task clocks itself for the fast events
+    // (vTaskDelayUntil() semantics) instead of being woken by a timer task.
+    // This saves one context switch per tick and missed ticks are counted.
+    bool app_task_self_clocked = true;
+    // Temperature sensor ADC acquisition runs in its own task, pinned to the
+    // other core, so that slow ADC averaging does not delay the control tick.
+    uint32_t acquisition_task_stack_size = 3072;
+    UBaseType_t acquisition_task_priority = 1;
+    BaseType_t acquisition_task_core_id = PRO_CPU_NUM;
+    // Minimum interval, the fast tick interval is used when it is longer
+    uint32_t acquisition_interval_ms = 20;
+    // Heatsink fan temperature control loop, see control_loop.hpp.
+    // The higher of both sensor temperatures is controlled to the setpoint
+    // by a PI controller. Its output is converted into on/off switching
+    // of the fan by time-proportioning over fan_switching_window_ms.
+    uint32_t fan_loop_period_ms = 1000;
+    float fan_temp_setpoint = 42.5f;
+    // Proportional gain [1/K] and integral gain [1/(K*s)]
+    float fan_kp = 0.2f;
+    float fan_ki = 0.005f;
+    uint32_t fan_switching_window_ms = 20000;
+    uint32_t fan_min_switch_time_ms = 2000;
+    // Setpoint ramps for frequency and duty cycle run from their own timer
+    // using this step interval. Timer is only active while ramping.
+    uint32_t ramp_step_interval_us = 1000;
+    // Time until full rate of change is reached for S-curve ramp profile
+    uint32_t ramp_s_curve_time_ms = 40;
+    // Time constant for the exponential ramp profile
+    uint32_t ramp_exp_time_constant_ms = 100;
+    // When true, ramp steps missed because of a delayed timer are done late,
+    // up to the given number of steps at once. Otherwise, the ramps run
+    // slower than configured when the timer is delayed.
+    bool ramp_catch_up = true;
+    uint32_t ramp_catch_up_max_steps = 50;
+    // HTTP POST endpoint for uploading the setpoint sequencer step table
+    const char *sequencer_endpoint = "/sequence";
+    // HTTP GET endpoint for the event loop latency histograms.
+    // Histograms are reset by adding the "reset" parameter.
+    const char *stats_endpoint = "/stats";
+    // HTTP GET endpoints for the binary state telegram and for its schema,
+    // see AppState::serialize_snapshot_bin()
+    const char *state_bin_endpoint = "/state.bin";
+    const char *state_schema_endpoint = "/state.schema";
+    // JSON document size for the step table upload (max. 64 steps)
+    size_t sequencer_json_buf_size = 8192;
+    // HTTP POST endpoint for applying several commands in one control tick,
+    // JSON object or form body with the same names and values as for "/cmd"
+    const char *cmd_batch_endpoint = "/cmd_batch";
+    // JSON document size for the batch, enough for all commands at once
+    size_t cmd_batch_json_buf_size = 2048;
     /** @brief In addition to event-based async state update telegrams, we also
      * send cyclic updates to the HTTP client using this time interval (ms).
      */
     uint32_t timer_slow_interval_ms = 750;
-    /** @brief Filename for persistent storage of runtime settings
+    /** @brief When true, state update telegrams only contain the values
+     * which changed since they were last sent. A complete telegram (keyframe)
+     * is sent on client connect, after a client send queue was full and
+     * every sse_keyframe_interval_ms.
+     */
+    bool sse_delta_telegrams = true;
+    /** @brief Maximum rate of event-based state update telegrams (Hz).
+     * State changes occurring faster are collapsed into one telegram
+     * which is sent when the minimum interval has expired.
+     */
+    uint32_t sse_max_push_rate_hz = 10;
+    uint32_t sse_keyframe_interval_ms = 10000;
+    /** @brief Changes smaller than these are not sent in delta telegrams.
+     * All setpoints and flags are always sent when changed.
+     * Units are the same as in the telegram, i.e. °C and µs.
+     */
+    float sse_delta_epsilon_temp = 0.2f;
+    uint32_t sse_delta_epsilon_tick_exec_us = 50;
+    /** @brief NVS namespace and key for persistent storage of runtime
+     * settings as binary blob, see AppState::serialize_settings_blob()
+     */
+    const char *settings_nvs_namespace = "app_settings";
+    const char *settings_nvs_key = "settings";
+    /** @brief Settings file written by earlier firmware versions.
+     * This is migrated to NVS on boot and then removed.
+     */
+    const char *legacy_settings_filename = "/www/settings.json";
+    /** @brief Settings are written by a low-priority worker task, see
+     * SettingsStore. Saves requested in quick succession are merged into
+     * one write after settings_save_delay_ms.
+     */
+    uint32_t settings_store_task_stack_size = 3072;
+    UBaseType_t settings_store_task_priority = 1;
+    BaseType_t settings_store_task_core_id = PRO_CPU_NUM;
+    uint32_t settings_save_delay_ms = 500;
+    /** @brief When not zero, settings changed via the API are saved
+     * automatically this long after the last change
      */
-    const char *settings_filename = "/www/settings.json";
+    uint32_t settings_autosave_delay_ms = 0;
 
     ///////////////////////////// For ps_pwm C module: ////////////////////////
     // MCPWM unit can be [0,1]
@@ -161,6 +276,9 @@ struct AppConstants
     gpio_num_t gpio_pwm1b_out = GPIO_NUM_33; // PWM1B := LAG leg, High Side
     // Shutdown/fault input for PWM outputs
     gpio_num_t gpio_fault_shutdown = GPIO_NUM_4;
+    // Additional GPIO interrupt on the fault input, notifies the application
+    // task immediately when a hardware fault shutdown occurs
+    bool fault_interrupt_enabled = true;
     // Active low / active high selection for fault input pin
     mcpwm_fault_input_level_t fault_pin_active_level = MCPWM_LOW_LEVEL_TGR;
     // Define here if the output pins shall be forced low or high
@@ -193,11 +311,6 @@ struct AuxHwDrvConfig
     // Objects are constexpr, so members can be used as template parameters etc.
     constexpr AuxHwDrvConfig(){};
 
-    // Threshold values for activating/deactivating the fan in automatic mode
-    float temp_1_fan_threshold_hi = 45.0f;
-    float temp_1_fan_threshold_lo = 40.0f;
-    float temp_2_fan_threshold_hi = 45.0f;
-    float temp_2_fan_threshold_lo = 40.0f;
     // Analog inputs config //
     /** @brief ADC channel for first temperature sensor */
     adc1_channel_t temp_ch_1 = ADC1_CHANNEL_0; // Sensor VP
@@ -267,9 +380,11 @@ struct AuxHwDrvConfig
         .duty = 0,
         .hpoint = 0
     };
-    // Overcurrent reset output pulse length. Must be at least equal to
-    // FreeRTOS scheduler tick period.
-    uint32_t oc_reset_pulse_length_ms = 20;
+    // Overcurrent reset output pulse length in microseconds.
+    // The pulse edges are written by the application task when woken by the
+    // SequenceRunner, so they are delayed by up to the run time of a higher
+    // priority task, e.g. async_tcp. Keep this in the millisecond range.
+    uint32_t oc_reset_pulse_length_us = 20000;
     // Calibration values for current limit PWM
     float curr_limit_pwm_scale = 1.0f/100.0f * (float)(
         1 << pwm_timer_config.duty_resolution);
@@ -0,0 +1,177 @@
+/* Fixed-rate closed-loop control engine with anti-windup PID blocks
+ *
+ * License: GPL v.3
+ */
+#include <algorithm>
+#include <cstring>
+
+#include "esp_timer.h"
+
+#include "control_loop.hpp"
+
+#undef LOG_LOCAL_LEVEL
+#define LOG_LOCAL_LEVEL ESP_LOG_INFO
+#include "esp_log.h"
+static auto TAG = "ControlLoop";
+
+
+//////////// PIDController ///////////
+
+void PIDController::reset(float output) {
+    _integral = std::max(_params.out_min, std::min(output, _params.out_max));
+    _output = _integral;
+    _has_last_measurement = false;
+}
+
+float PIDController::update(float setpoint, float measurement, float dt_s) {
+    auto error = setpoint - measurement;
+    auto d_measurement = _has_last_measurement ? (measurement - _last_measurement) / dt_s
+                                               : 0.0f;
+    if (_params.reverse_acting) {
+        error = -error;
+        d_measurement = -d_measurement;
+    }
+    _last_measurement = measurement;
+    _has_last_measurement = true;
+    const auto p_term = _params.kp * error;
+    const auto d_term = -_params.kd * d_measurement;
+    const auto integral = _integral + _params.ki * error * dt_s;
+    auto output = p_term + integral + d_term;
+    if (output > _params.out_max) {
+        output = _params.out_max;
+        // Conditional integration: Only wind down when saturated high
+        if (error < 0.0f) {
+            _integral = integral;
+        }
+    } else if (output < _params.out_min) {
+        output = _params.out_min;
+        if (error > 0.0f) {
+            _integral = integral;
+        }
+    } else {
+        _integral = integral;
+    }
+    _integral = std::max(_params.out_min, std::min(_integral, _params.out_max));
+    _output = output;
+    return output;
+}
+
+
+//////////// TimeProportioningOutput ///////////
+
+bool TimeProportioningOutput::update(float duty, int64_t now_us) {
+    if (now_us - _window_start_us >= _window_us) {
+        // Keep window phase, also when updates were missed
+        _window_start_us = now_us - (now_us - _window_start_us) % _window_us;
+    }
+    auto on_time_us = static_cast<int64_t>(std::max(0.0f, std::min(duty, 1.0f))
+                                           * _window_us);
+    if (on_time_us < _min_switch_us) {
+        on_time_us = 0;
+    } else if (_window_us - on_time_us < _min_switch_us) {
+        on_time_us = _window_us;
+    }
+    return now_us - _window_start_us < on_time_us;
+}
+
+
+//////////// ControlLoop ///////////
+
+void ControlLoop::set_param(Param param, float value) {
+    portENTER_CRITICAL(&_lock);
+    switch (param) {
+    case Param::setpoint: _setpoint = value; break;
+    case Param::kp: _params.kp = value; break;
+    case Param::ki: _params.ki = value; break;
+    case Param::kd: _params.kd = value; break;
+    case Param::_count: break;
+    }
+    portEXIT_CRITICAL(&_lock);
+}
+
+float ControlLoop::get_param(Param param) const {
+    auto value = 0.0f;
+    portENTER_CRITICAL(&_lock);
+    switch (param) {
+    case Param::setpoint: value = _setpoint; break;
+    case Param::kp: value = _params.kp; break;
+    case Param::ki: value = _params.ki; break;
+    case Param::kd: value = _params.kd; break;
+    case Param::_count: break;
+    }
+    portEXIT_CRITICAL(&_lock);
+    return value;
+}
+
+bool ControlLoop::run_if_due(int64_t now_us) {
+    if (now_us < _next_due_us) {
+        return false;
+    }
+    if (_next_due_us != 0) {
+        // Any full period elapsed in addition is a missed execution
+        auto missed = static_cast<uint32_t>((now_us - _next_due_us) / _period_us);
+        _overruns += missed;
+        _next_due_us += (missed + 1) * _period_us;
+    } else {
+        _next_due_us = now_us + _period_us;
+    }
+    if (!_enabled) {
+        _was_enabled = false;
+        return false;
+    }
+    portENTER_CRITICAL(&_lock);
+    const auto setpoint = _setpoint;
+    _pid.set_params(_params);
+    portEXIT_CRITICAL(&_lock);
+    const auto measurement = _input_fn(_arg);
+    if (!_was_enabled) {
+        _pid.reset(_pid.get_output());
+        _was_enabled = true;
+    }
+    _output_fn(_pid.update(setpoint, measurement, _period_us * 1e-6f), _arg);
+    _exec_time_us = static_cast<uint32_t>(esp_timer_get_time() - now_us);
+    if (_exec_time_us > _period_us) {
+        ++_overruns;
+    }
+    return true;
+}
+
+
+//////////// ControlLoopEngine ///////////
+
+esp_err_t ControlLoopEngine::add_loop(ControlLoop &loop) {
+    auto slot = std::find(_loops.begin(), _loops.end(), nullptr);
+    if (slot == _loops.end()) {
+        ESP_LOGE(TAG, "Maximum number of control loops reached!");
+        return ESP_ERR_NO_MEM;
+    }
+    *slot = &loop;
+    return ESP_OK;
+}
+
+void ControlLoopEngine::run_due(int64_t now_us) {
+    for (auto loop : _loops) {
+        if (loop) {
+            loop->run_if_due(now_us);
+        }
+    }
+}
+
+uint32_t ControlLoopEngine::get_overruns() const {
+    auto overruns = uint32_t{0};
+    for (auto loop : _loops) {
+        if (loop) {
+            overruns += loop->get_overruns();
+        }
+    }
+    return overruns;
+}
+
+ControlLoop *ControlLoopEngine::find(const char *name) const {
+    for (auto loop : _loops) {
+        if (loop && std::strcmp(loop->name, name) == 0) {
+            return loop;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,76 @@
+/* Interrupt-driven notification of hardware fault events
+ *
+ * License: GPL v.3
+ */
+#include "esp_timer.h"
+#include "esp_attr.h"
+
+#include "fault_notifier.hpp"
+
+#undef LOG_LOCAL_LEVEL
+#define LOG_LOCAL_LEVEL ESP_LOG_INFO
+#include "esp_log.h"
+static auto TAG = "FaultNotifier";
+
+
+FaultNotifier::~FaultNotifier() {
+    if (_gpio_num != GPIO_NUM_NC) {
+        gpio_isr_handler_remove(_gpio_num);
+    }
+}
+
+esp_err_t FaultNotifier::begin(gpio_num_t gpio_num, bool active_low,
+                               TaskHandle_t task, uint32_t notify_bits) {
+    _task = task;
+    _notify_bits = notify_bits;
+    // Service might already be installed by other modules
+    auto errors = gpio_install_isr_service(0);
+    if (errors != ESP_OK && errors != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Could not install GPIO ISR service");
+        return errors;
+    }
+    errors = gpio_set_intr_type(gpio_num, active_low ? GPIO_INTR_NEGEDGE
+                                                     : GPIO_INTR_POSEDGE);
+    errors |= gpio_isr_handler_add(gpio_num, _isr_handler, this);
+    errors |= gpio_intr_enable(gpio_num);
+    if (errors == ESP_OK) {
+        _gpio_num = gpio_num;
+    }
+    return errors;
+}
+
+bool IRAM_ATTR FaultNotifier::on_fault_edge(int64_t now_us) {
+    portENTER_CRITICAL_SAFE(&_lock);
+    auto is_new_event = !_pending;
+    if (is_new_event) {
+        _fault_time_us = now_us;
+        _pending = true;
+    }
+    ++_count;
+    portEXIT_CRITICAL_SAFE(&_lock);
+    return is_new_event;
+}
+
+bool FaultNotifier::take_event(int64_t now_us, FaultEvent *event) {
+    portENTER_CRITICAL(&_lock);
+    auto was_pending = _pending;
+    event->fault_time_us = _fault_time_us;
+    event->count = _count;
+    _pending = false;
+    portEXIT_CRITICAL(&_lock);
+    event->latency_us = was_pending ? static_cast<uint32_t>(now_us - event->fault_time_us)
+                                    : 0;
+    return was_pending;
+}
+
+void IRAM_ATTR FaultNotifier::_isr_handler(void *arg) {
+    auto self = static_cast<FaultNotifier*>(arg);
+    if (self->on_fault_edge(esp_timer_get_time())) {
+        auto higher_priority_task_woken = BaseType_t{pdFALSE};
+        xTaskNotifyFromISR(self->_task, self->_notify_bits, eSetBits,
+                           &higher_priority_task_woken);
+        if (higher_priority_task_woken) {
+            portYIELD_FROM_ISR();
+        }
+    }
+}
@@ -64,4 +64,18 @@ size_t FSIO::read_from_file_uint8(const char *filename, uint8_t *buf, size_t max
                     filename, file_size, read);
         return read;
     }
-}
\ No newline at end of file
+}
+
+
+bool FSIO::remove_file(const char *filename) {
+    if (!esp_spiffs_mounted(NULL) && !SPIFFS.begin(false)) {
+        ESP_LOGE(TAG, "Could not open SPIFFS!");
+        return false;
+    }
+    if (!SPIFFS.remove(filename)) {
+        ESP_LOGE(TAG, "Could not remove file: %s", filename);
+        return false;
+    }
+    ESP_LOGI(TAG, "Removed file: %s", filename);
+    return true;
+}
@@ -0,0 +1,37 @@
+/** @file alloc_counter.hpp
+ * @brief Debug build option counting the heap allocations of a task
+ *
+ * License: GPL v.3
+ */
+#ifndef ALLOC_COUNTER_HPP__
+#define ALLOC_COUNTER_HPP__
+
+#include <cstdint>
+
+
+/** @brief Counts the heap allocations done by the calling task between
+ * start() and stop(), e.g. for proving a request path does not allocate.
+ *
+ * This is only active when building with -DCOUNT_HEAP_ALLOCATIONS=ON,
+ * see main/CMakeLists.txt. Then, malloc(), calloc() and realloc() are
+ * wrapped by the linker, which also covers operator new and Arduino String.
+ * Otherwise, the functions do nothing and always return zero.
+ *
+ * Only one task can be counted at a time.
+ */
+namespace AllocCounter {
+#ifdef COUNT_HEAP_ALLOCATIONS
+    static constexpr bool enabled = true;
+    void start();
+    // Allocations since start()
+    uint32_t get_count();
+    uint32_t stop();
+#else
+    static constexpr bool enabled = false;
+    inline void start() {}
+    inline uint32_t get_count() {return 0;}
+    inline uint32_t stop() {return 0;}
+#endif
+}
+
+#endif
@@ -0,0 +1,98 @@
+/** @file api_cmd_table.hpp
+ * @brief Compile-time dispatch table for the "/cmd" HTTP API endpoint
+ *
+ * License: GPL v.3
+ */
+#ifndef API_CMD_TABLE_HPP__
+#define API_CMD_TABLE_HPP__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+#include "app_cmd.hpp"
+#include "app_state_model.hpp"
+#include "perfect_hash_table.hpp"
+
+
+/** @brief How the value of a "/cmd" request parameter is converted
+ * into the command argument
+ */
+enum class CmdArgType : uint8_t {
+    // Value is ignored, e.g. "/cmd?save_settings" or "save_settings=true"
+    none,
+    // True if the value is "true"
+    boolean,
+    integer,
+    real,
+};
+
+/** @brief Entry of the "/cmd" dispatch table
+ */
+struct ApiCmd {
+    // Request parameter name
+    const char *name;
+    AppCmd cmd;
+    CmdArgType arg_type;
+};
+
+/** @brief Commands without argument, the state value setters are taken
+ * from state_schema
+ */
+inline constexpr ApiCmd api_action_cmds[] = {
+    // Trigger a one-shot output power pulse of configurable length
+    {"trigger_oneshot", AppCmd::trigger_oneshot, CmdArgType::none},
+    // Clear the hardware error shutdown latch
+    {"clear_shutdown", AppCmd::clear_shutdown, CmdArgType::none},
+    // Save all runtime settings to SPI flash for persistence accross hardware restarts
+    {"save_settings", AppCmd::save_settings, CmdArgType::none},
+    // Setpoint sequencer controls
+    {"sequencer_start", AppCmd::sequencer_start, CmdArgType::none},
+    {"sequencer_stop", AppCmd::sequencer_stop, CmdArgType::none},
+};
+
+/** @brief Number of settable state values plus action commands
+ */
+constexpr size_t api_cmds_count() {
+    auto n = std::size(api_action_cmds);
+    for (const auto &field : state_schema) {
+        if (field.is_settable()) {
+            ++n;
+        }
+    }
+    return n;
+}
+
+/** @brief All "/cmd" commands: Setters of the settable state values,
+ * command names are the AppCmd names, units are as in the telegram.
+ * Followed by the action commands.
+ */
+constexpr std::array<ApiCmd, api_cmds_count()> make_api_cmds() {
+    auto cmds = std::array<ApiCmd, api_cmds_count()>{};
+    auto n = size_t{0};
+    for (const auto &field : state_schema) {
+        if (!field.is_settable()) {
+            continue;
+        }
+        auto arg_type = CmdArgType::integer;
+        if (field.type == FieldType::boolean) {
+            arg_type = CmdArgType::boolean;
+        } else if (field.type == FieldType::float32 || field.scale != 1.0f) {
+            arg_type = CmdArgType::real;
+        }
+        cmds[n++] = ApiCmd{field.command, field.setter, arg_type};
+    }
+    for (const auto &cmd : api_action_cmds) {
+        cmds[n++] = cmd;
+    }
+    return cmds;
+}
+
+/** @brief Lookup table for the "/cmd" request parameter names
+ */
+inline constexpr auto api_cmd_table = PerfectHashTable<ApiCmd, api_cmds_count()>{
+    make_api_cmds()};
+static_assert(api_cmd_table.is_valid(), "Duplicate command names in api_cmd_table");
+
+#endif
@@ -8,12 +8,15 @@
 
 #include <map>
 #include <functional>
+#include <string_view>
 
 //#include <Arduino.h>
 #include <Ticker.h>
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
 
+#include "esp_err.h"
+
 #include "app_config.hpp"
 
 // Callback function with string argument
@@ -24,6 +27,15 @@ using CbFloatT = std::function<void(const float)>;
 using CbIntT = std::function<void(const int)>;
 // Callback function without arguments
 using CbVoidT = std::function<void(void)>;
+// Callback writing additional Server-Timing header metrics into buf
+// as null-terminated string
+using CbTimingT = std::function<void(char *buf, size_t buf_len)>;
+// Callback for a complete WebSocket text message, see on_ws_message()
+using CbWsMessageT = std::function<void(AsyncWebSocketClient *client,
+                                        std::string_view message)>;
+// Dispatch function for "/cmd" request parameters, see set_cmd_dispatcher()
+using CmdDispatchFnT = esp_err_t (*)(void *context, std::string_view name,
+                                     std::string_view value, bool apply);
 
 // Mapping used for resolving command strings received via HTTP request
 // on the "/cmd" endpoint to specialised request handlers
@@ -50,6 +62,11 @@ class APIServer
     AsyncWebServer* backend;
     // Server-Sent Events (SSE) for "PUSH" updates of application data
     AsyncEventSource* event_source;
+    // Optional second SSE source for binary (base64) state telegrams
+    AsyncEventSource* event_source_bin;
+    // Optional WebSockets for commands plus JSON or binary state telegrams
+    AsyncWebSocket* web_socket;
+    AsyncWebSocket* web_socket_bin;
     // Callback registry, see above
     CmdMapT cmd_map;
     // String replacement mapping for template processor
@@ -90,6 +107,55 @@ class APIServer
      */
     void register_api_cb(const char* cmd_name, CbVoidT cmd_callback);
 
+    /** Set a function which handles "/cmd" request parameters before the
+     * callbacks registered by register_api_cb() are looked up.
+     *
+     * This is a plain function pointer for use with a compile-time
+     * command table, see api_cmd_table.hpp. All parameters of a request are
+     * first checked with apply set to false, and are only applied when
+     * all values are valid. Must return:
+     *   ESP_OK: Valid command and value. When apply is true, it is applied.
+     *   ESP_ERR_NOT_FOUND: Unknown parameter name
+     *   ESP_ERR_INVALID_ARG: Invalid value. The request is answered with
+     *                        status 400 and no command is applied.
+     *
+     * This is called from the AsyncTCP task.
+     */
+    void set_cmd_dispatcher(CmdDispatchFnT dispatch, void *context);
+
+    /** Set a callback which is called when a client connects to the
+     * Server-Sent Event source or to a WebSocket, e.g. for sending a
+     * complete state update.
+     *
+     * This is called from the AsyncTCP task.
+     */
+    void on_sse_client_connect(CbVoidT callback);
+
+    /** Set a callback for messages received on the WebSockets.
+     *
+     * Only complete, unfragmented text messages are passed on. The message
+     * is only valid during the call, replies are sent via client->text().
+     *
+     * This is called from the AsyncTCP task.
+     */
+    void on_ws_message(CbWsMessageT callback);
+
+    /** Set a callback writing additional metrics for the Server-Timing
+     * header of API endpoint responses, e.g. "tick;dur=0.12".
+     *
+     * This is called from the AsyncTCP task.
+     */
+    void on_server_timing(CbTimingT callback);
+
+    /** Returns true when the send queue of any client of the JSON state
+     * telegram channels, i.e. event_source and web_socket, may be full.
+     *
+     * Messages sent to a client with a full queue are dropped by the
+     * backend. For SSE, only the average queue length of all clients
+     * is available, so this errs on the side of reporting a full queue.
+     */
+    bool have_full_client_queue();
+
     /** Start execution, includes starting the ESPAsyncWebServer backend.
      * Do not call this when using WifiManger or when backend has been
      * activated before by other means
@@ -108,7 +174,20 @@ class APIServer
     // Activate the SSE envent source if conf_use_sse == true
     void _add_event_source();
     // Helper function for _add_event_source, only sends "Hello" message and info print
-    void _register_sse_on_connect_callback();
+    void _register_sse_on_connect_callback(AsyncEventSource *source);
+    // Activate the WebSockets if srv_conf.ws_endpoint is set
+    void _add_web_sockets();
+    // Helper function for _add_web_sockets
+    void _register_ws_event_callback(AsyncWebSocket *socket);
+    // Set by on_sse_client_connect()
+    CbVoidT _sse_on_connect_cb;
+    // Set by on_ws_message()
+    CbWsMessageT _ws_message_cb;
+    // Set by on_server_timing()
+    CbTimingT _server_timing_cb;
+    // Set by set_cmd_dispatcher()
+    CmdDispatchFnT _cmd_dispatch = nullptr;
+    void *_cmd_dispatch_context = nullptr;
 
     /////// Backend callback implementation
 
@@ -116,6 +195,8 @@ class APIServer
     void _on_root_request(AsyncWebServerRequest *request);
     // on("/cmd")
     void _on_cmd_request(AsyncWebServerRequest *request);
+    // Check or apply one "/cmd" request parameter
+    esp_err_t _dispatch_cmd(const AsyncWebParameter *param, bool apply);
     // on("/update")
     // When update is initiated via GET
     void _on_update_request(AsyncWebServerRequest *request);
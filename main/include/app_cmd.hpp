@@ -0,0 +1,64 @@
+/** @file app_cmd.hpp
+ * @brief Commands and command arguments for the AppController API setters
+ *
+ * These are in their own header as they are also referenced by the
+ * application state schema, see app_state_model.hpp.
+ *
+ * License: GPL v.3
+ */
+#ifndef APP_CMD_HPP__
+#define APP_CMD_HPP__
+
+#include <cstdint>
+
+
+/** @brief Commands for AppController::submit()
+ *
+ * Each command corresponds to one of the AppController API setters.
+ */
+enum class AppCmd : uint8_t {
+    set_setpoint_throttling_enabled,
+    set_frequency_min,
+    set_frequency_max,
+    set_frequency,
+    set_frequency_changerate,
+    set_duty_min,
+    set_duty_max,
+    set_duty,
+    set_duty_changerate,
+    set_ramp_profile,
+    set_lag_dt,
+    set_lead_dt,
+    set_power_pwm_active,
+    set_oneshot_len,
+    trigger_oneshot,
+    clear_shutdown,
+    set_current_limit,
+    set_temp_1_limit,
+    set_temp_2_limit,
+    set_relay_ref_active,
+    set_relay_dut_active,
+    set_fan_override,
+    set_fan_setpoint,
+    set_fan_kp,
+    set_fan_ki,
+    save_settings,
+    sequencer_start,
+    sequencer_stop,
+    set_sequencer_loop,
+    _count
+};
+
+/** @brief Argument for AppController::submit()
+ */
+union CmdArg {
+    float f;
+    bool b;
+    int i;
+    CmdArg() : f{0.0f} {}
+    CmdArg(float f) : f{f} {}
+    CmdArg(bool b) : b{b} {}
+    CmdArg(int i) : i{i} {}
+};
+
+#endif
@@ -3,8 +3,9 @@
  *
  * This features the main control functions for PWM frequency, duty cycle etc.
  * 
- * Also, periodic state feedback for all hardware functions is sent to the
- * HTTP remote application using Server-Sent Events from a FreeRTOS timer task.
+ * Also, periodic and event-based state feedback for all hardware functions
+ * is sent to the HTTP remote application using Server-Sent Events and
+ * WebSockets from the application event task, which clocks itself.
  * 
  * Some auxiliary functions like GPIO and temperature readouts is outsourced
  * to the AuxHwDrv class, see aux_hw_drv.cpp.
@@ -15,23 +16,64 @@
 #ifndef APP_CONTROLLER_HPP__
 #define APP_CONTROLLER_HPP__
 
+#include <algorithm>
+#include <string_view>
+
 #include <Ticker.h>
 //#include "freertos/FreeRTOS.h"
 //#include "freertos/timers.h"
 
 #include "aux_hw_drv.hpp"
 #include "api_server.hpp"
-#include "multi_timer.hpp"
+#include "timed_sequence.hpp"
+#include "command_queue.hpp"
+#include "push_scheduler.hpp"
+#include "ramp_generator.hpp"
+#include "setpoint_sequencer.hpp"
+#include "seqlock.hpp"
+#include "fault_notifier.hpp"
+#include "settings_store.hpp"
+#include "control_loop.hpp"
+#include "latency_histogram.hpp"
+#include "app_cmd.hpp"
 
 #include "app_state_model.hpp"
 
 
+/** @brief Application task stages instrumented with latency histograms
+ *
+ * tick_lateness is the delay from the scheduled fast tick time until the
+ * application task is running.
+ */
+enum class LatencyStage : uint8_t {
+    fast_tick,
+    tick_lateness,
+    temp_eval,
+    push_update,
+    _count
+};
+
+
+/** @brief Results of the acquisition task, see AppController
+ */
+struct AcquisitionResult {
+    float temp_1;
+    float temp_2;
+    // Incremented for each acquisition
+    uint32_t count;
+    // Time needed for the acquisition
+    uint32_t exec_time_us;
+};
+
+
 /** @brief Application main controller for PS-PWM generator hardware
  *
  * This features the main control functions for PWM frequency, duty cycle etc.
  * 
- * Also, periodic state feedback for all hardware functions is sent to the
- * HTTP remote interface using Server-Sent Events from a FreeRTOS timer task.
+ * Also, periodic and event-based state feedback for all hardware functions
+ * is sent to the HTTP remote interface using Server-Sent Events and
+ * WebSockets. This is done from the application event task, which clocks
+ * itself for the fast events, see AppConstants::app_task_self_clocked.
  * 
  * Some auxiliary functions like GPIO and temperature readouts is outsourced
  * to the AuxHwDrv class, see aux_hw_drv.hpp.
@@ -40,6 +82,9 @@
  * This configures all parameters of a four-channel Phase-Shift PWM waveform
  * plus auxiliary hardware setpoints, relay outputs etc.
  * 
+ * Hardware access is done from the application event task only:
+ * Other tasks, e.g. the HTTP server, submit() commands into a queue which
+ * is drained and applied as a batch by the application task.
  */
 
 class AppController
@@ -67,8 +112,28 @@ class AppController
      */
     void begin();
 
+    /** @brief Queue a command for the application task. Thread-safe.
+     *
+     * Repeated commands of same type which were not applied yet are merged,
+     * i.e. only the newest argument value is applied.
+     */
+    void submit(AppCmd cmd, CmdArg arg = CmdArg{});
+
+    using CmdQueue = CommandQueue<AppCmd, CmdArg, static_cast<size_t>(AppCmd::_count)>;
+
+    /** @brief Queue several commands which are applied together in one
+     * control tick. Thread-safe.
+     *
+     * @return Sequence number which state.cmd_seq reaches when the
+     *         commands have been applied
+     */
+    uint32_t submit_batch(const CmdQueue::Entry *entries, size_t n_entries);
+
     ////////////////// Application API ///////////////////////
     // (except for network configuration which is separate) //
+    //
+    // These setters access the hardware and must only be called from the
+    // application task. Use submit() from any other task.
     void set_setpoint_throttling_enabled(bool new_val);
 
     void set_frequency_min_khz(float n);
@@ -77,7 +142,6 @@ class AppController
     /** @brief Set rate of change of frequency in kHz per second
      */
     void set_frequency_changerate_khz_sec(float n);
-    void _set_frequency_raw(float n);
 
     void set_duty_min_percent(float n);
     void set_duty_max_percent(float n);
@@ -85,7 +149,11 @@ class AppController
     /** @brief Set rate of change of duty cycle in percent per second
      */
     void set_duty_changerate_percent_sec(float n);
-    void _set_duty_raw(float n);
+
+    /** @brief Set profile of the setpoint throttling ramps,
+     * see enum RampProfile
+     */
+    void set_ramp_profile(int n);
 
     void set_lag_dt_ns(float n);
     void set_lead_dt_ns(float n);
@@ -119,14 +187,33 @@ class AppController
      */
     void set_fan_override(bool new_val);
 
+    /** @brief Set heatsink temperature setpoint of the fan control loop (°C)
+     */
+    void set_fan_setpoint(float n);
+    /** @brief Set fan control loop proportional gain (1/K) and
+     * integral gain (1/(K*s))
+     */
+    void set_fan_kp(float n);
+    void set_fan_ki(float n);
+
     /** @brief Save all runtime configurable settings to SPI flash.
      * The settings are a subset of all values in struct AppState.
      * 
+     * The settings are written in the background, see SettingsStore.
      * The stored settings are restored on reboot.
      */
     void save_settings();
 
-    /** @brief Read state back from SPI flash file and initialize the hardware
+    /** @brief Start or stop the setpoint sequencer.
+     * The step table is uploaded via HTTP POST, see setpoint_sequencer.hpp
+     */
+    void sequencer_start();
+    void sequencer_stop();
+    /** @brief When set to true, the sequence is repeated until stopped
+     */
+    void set_sequencer_loop(bool new_val);
+
+    /** @brief Read state back from SPI flash and initialize the hardware
      * with these settings.
      * 
      * This is called on boot.
@@ -135,45 +222,281 @@ class AppController
 
 
 private:
-    // FreeRTOS task handle for application event task
+    // FreeRTOS task handle for application event task.
+    // Event flags are sent to the task using task notification bits.
     static TaskHandle_t _app_event_task_handle;
-    // FreeRTOS event group handle for triggering event task actions
-    static EventGroupHandle_t _app_event_group;
-    // Timer for periodic events
+    // Fast tick sequence number and time (lower 32 bits of µs timestamp),
+    // written by the fast timer when the application task is not self-clocked
+    static volatile uint32_t _fast_timer_seq;
+    static volatile uint32_t _fast_timer_time_us;
+    // For conversion of µs into the CPU cycles of the latency histograms
+    uint32_t _cpu_mhz = 240;
+    // Last time a ramp or sequence was active, for the adaptive tick rate
+    int64_t _last_active_time_us = 0;
+    // Temperature sensor acquisition task and its results mailbox.
+    // Written by the acquisition task, read by the application task.
+    TaskHandle_t _acquisition_task_handle = nullptr;
+    SeqLock<AcquisitionResult> _acquisition_mailbox;
+    // Writes the settings to NVS without blocking the application task
+    SettingsStore _settings_store;
+    // Notifies the application task on hardware overcurrent fault
+    FaultNotifier fault_notifier;
+    // Timer for periodic events.
+    // Fast timer is only used when the application task is not self-clocked.
     Ticker event_timer_fast;
     Ticker event_timer_slow;
-    // Timer for generating overcurrent reset pulse
-    MultiTimer oc_reset_timer;
-    // Timer for power output timing
-    MultiTimer power_output_timer;
+    // Commands submitted by other tasks, applied by application task
+    CmdQueue _cmd_queue;
+    // Setpoint throttling for frequency and duty cycle. The ramp axes
+    // output functions are run from the application task.
+    RampGenerator ramp_generator;
+    RampAxis frequency_ramp{
+        [](float n, void*) {pspwm_set_frequency(constants.mcpwm_num, n);},
+        nullptr};
+    RampAxis duty_ramp{
+        [](float n, void*) {pspwm_set_ps_duty(constants.mcpwm_num, n);},
+        nullptr};
+    // Common timer for all multi-step hardware sequences below.
+    // The steps are run from the application task.
+    SequenceRunner sequence_runner;
+    // Sequence generating the overcurrent reset pulse
+    TimedSequence oc_reset_sequence{
+        [](TimedSequence &seq, void *self) {
+            return static_cast<AppController*>(self)->_oc_reset_sequence(seq);},
+        this};
+    // Sequence generating the power output one-shot pulse
+    TimedSequence power_pulse_sequence{
+        [](TimedSequence &seq, void *self) {
+            return static_cast<AppController*>(self)->_power_pulse_sequence(seq);},
+        this};
+    // Runs uploaded setpoint step tables, also on the sequence_runner
+    SetpointSequencer sequencer{
+        sequence_runner,
+        [](const SequencerStep &step, void *self) {
+            static_cast<AppController*>(self)->_apply_sequencer_step(step);},
+        this};
+    // Closed-loop control functions, run from the application task fast tick
+    ControlLoopEngine control_loops;
+    // Heatsink fan temperature control. Controls the higher of both sensor
+    // temperatures, output is the fan duty cycle stored in state.fan_duty.
+    ControlLoop fan_loop{
+        "fan",
+        constants.fan_loop_period_ms,
+        constants.fan_temp_setpoint,
+        PIDParams{constants.fan_kp, constants.fan_ki, 0.0f, 0.0f, 1.0f, true},
+        [](void *self) {
+            auto &aux = static_cast<AppController*>(self)->aux_hw_drv.state;
+            return std::max(aux.temp_1, aux.temp_2);},
+        [](float duty, void *self) {
+            static_cast<AppController*>(self)->state.fan_duty = duty;},
+        this};
+    // Converts the fan duty cycle into on/off switching of the fan
+    TimeProportioningOutput fan_switching{constants.fan_switching_window_ms,
+                                          constants.fan_min_switch_time_ms};
+    // Rate limiter for the state update telegrams
+    PushScheduler _push_scheduler{1000000ll / constants.sse_max_push_rate_hz};
+    // Values as last sent to the clients, for delta state update telegrams
+    AppStateSnapshot _last_sent_state{};
+    int64_t _last_keyframe_time_us = 0;
+    // Set when a telegram may have been dropped for a client
+    bool _resync_pending = false;
+    // State telegram buffers, only used by the application task.
+    // These are too large for its stack.
+    std::array<char, AppState::json_buf_len> _json_buf{};
+    std::array<uint8_t, AppState::bin_buf_len> _bin_buf{};
+    // Base64 has four characters for every three bytes, plus null
+    std::array<char, (AppState::bin_buf_len + 2) / 3 * 4 + 1> _b64_buf{};
+    // Last hardware fault event, for the alert message
+    FaultEvent _last_fault_event{};
+    // Execution time and latency histograms, recorded by application task
+    std::array<LatencyHistogram, static_cast<size_t>(LatencyStage::_count)> _latency_stats;
 
     /////////// Setup functions called from this constructor //////
     
     void _initialize_ps_pwm_drv();
+
+    /** @brief Setup the frequency and duty cycle ramp generator
+     */
+    void _initialize_ramp_generator();
+
+    /** @brief Add all closed-loop control functions to the engine
+     */
+    void _initialize_control_loops();
     /** @brief Creates main application event task.
-     * This has 4096k stack size for String processing requirements etc.
+     * Stack size is AppConstants::app_event_task_stack_size, in bytes.
      */
     void _create_app_event_task();
 
+    /** @brief Current values of the runtime configurable settings.
+     * For frequency and duty, these are the ramp targets.
+     */
+    AppStateSnapshot _get_settings() const;
+
+    /** @brief Creates the acquisition task, pinned to the other core.
+     * Called from begin() when settings have been restored.
+     */
+    void _create_acquisition_task();
+
+    /** @brief Look up a command in api_cmd_table and convert its value
+     *
+     * @return ESP_ERR_NOT_FOUND for unknown commands,
+     *         ESP_ERR_INVALID_ARG for invalid values
+     */
+    static esp_err_t _parse_api_cmd(std::string_view name, std::string_view value,
+                                    CmdQueue::Entry *entry);
+
+    /** @brief Dispatch function for the "/cmd" endpoint, see api_cmd_table.hpp
+     */
+    static esp_err_t _dispatch_api_cmd(void *context, std::string_view name,
+                                       std::string_view value, bool apply);
+
+    /** @brief Parse one command into the batch.
+     * A repeated command replaces the earlier entry.
+     *
+     * @return ESP_ERR_NOT_FOUND for unknown commands,
+     *         ESP_ERR_INVALID_ARG for invalid values
+     */
+    static esp_err_t _parse_batch_entry(std::string_view name, std::string_view value,
+                                        CmdQueue::Batch &batch, size_t *n_entries);
+
+    /** @brief Error text for a rejected batch, e.g. "Invalid value for: set_duty"
+     */
+    static void _format_batch_error(esp_err_t err, std::string_view name,
+                                    char *buf, size_t buf_len);
+
+    /** @brief Parse one command of a "/cmd_batch" request into the batch.
+     *
+     * Sends the 400 response and returns false if the command is unknown
+     * or the value is invalid.
+     */
+    static bool _add_batch_entry(AsyncWebServerRequest *request,
+                                 std::string_view name, std::string_view value,
+                                 CmdQueue::Batch &batch, size_t *n_entries);
+
+    /** @brief Submit a parsed "/cmd_batch" request and send the response
+     */
+    void _submit_batch_request(AsyncWebServerRequest *request,
+                               const CmdQueue::Batch &batch, size_t n_entries);
+
     /** @brief Register all application HTTP GET API callbacks into the HTPP server
      */
     void _register_http_api(APIServer* api_server);
 
+    /** @brief Handle a command message received on a WebSocket and send
+     * the acknowledgement, called from AsyncTCP task
+     */
+    void _on_ws_message(AsyncWebSocketClient *client, std::string_view message);
+
+    /** @brief Send the latency histograms as JSON, called from AsyncTCP task
+     */
+    void _on_stats_request(AsyncWebServerRequest *request);
+
+    /** @brief Send the binary state telegram, called from AsyncTCP task
+     */
+    void _on_state_bin_request(AsyncWebServerRequest *request);
+
+    /** @brief Send the binary state telegram schema as JSON,
+     * called from AsyncTCP task
+     */
+    void _on_state_schema_request(AsyncWebServerRequest *request);
+
+    /** @brief Metrics for the Server-Timing header of API responses
+     */
+    void _get_server_timing(char *buf, size_t buf_len) const;
+
     /** @brief Connect timer callbacks
      */
     void _connect_timer_callbacks();
 
+    /** @brief (Re-)start the fast timer with the current tick interval.
+     * Only used when the application task is not self-clocked.
+     */
+    void _attach_fast_timer();
+
+    /** @brief Setup the GPIO interrupt on the hardware fault input
+     */
+    void _connect_fault_interrupt();
+
+    /** @brief Wake function for timers dispatched from the esp_timer ISR.
+     * Sets the EventFlags passed as arg for the application task.
+     */
+    static void _notify_from_timer_isr(void *event_flags);
+
+    //////////// Timed hardware sequences, see timed_sequence.hpp ///////////
+
+    /** @brief Three-step overcurrent reset pulse sequence
+     */
+    int64_t _oc_reset_sequence(TimedSequence &seq);
+
+    /** @brief Power output one-shot pulse sequence
+     */
+    int64_t _power_pulse_sequence(TimedSequence &seq);
+
+    /** @brief Submit one setpoint sequencer step as a command batch.
+     * Called from the application task via sequence_runner.run_due().
+     */
+    void _apply_sequencer_step(const SequencerStep &step);
+
     //////////// Application task related functions ///////////
     
     /** @brief Application event loop task.
+     * This waits for the app_started notification sent by begin().
      */
     static void _app_event_task(void *pVParameters);
 
+    /** @brief Temperature sensor acquisition task
+     */
+    static void _acquisition_task(void *pVParameters);
+
+    /** @brief Apply all commands submitted since the last call
+     */
+    void _apply_queued_commands();
+
+    /** @brief Call the API setter corresponding to cmd
+     */
+    void _apply_command(AppCmd cmd, CmdArg arg);
+
+    /** @brief Write both dead-time setpoints to the PWM hardware
+     */
+    void _write_deadtimes();
+
     /** @brief Update all application state settings which need fast polling.
      * This is e.g. ADC conversion and HW overcurrent detection handling
      */
     void _on_fast_timer_event_update_state();
 
+    /** @brief Switch the fan according to fan control loop output
+     * or manual override
+     */
+    void _update_fan_output(int64_t now_us);
+
+    LatencyHistogram &_latency(LatencyStage stage) {
+        return _latency_stats[static_cast<size_t>(stage)];
+    }
+
+    /** @brief Select the fast tick interval depending on activity.
+     * @return true if the interval was changed
+     */
+    bool _update_tick_interval();
+
+    /** @brief Update tick sequence number, missed tick and lateness
+     * statistics when a fast tick is due
+     */
+    void _update_tick_sequence(uint32_t missed_ticks, uint32_t lateness_us);
+
+    /** @brief Update fast tick execution time and overrun statistics
+     */
+    void _update_tick_statistics(int64_t exec_time_us);
+
+    /** @brief Handle hardware fault event from the fault interrupt
+     */
+    void _on_hw_fault_event();
+
+    /** @brief Send an SSE and WebSocket alert message for the last
+     * hardware fault event
+     */
+    void _push_fault_alert();
+
     /** @brief Perform overtemperature shutdown if temperature limit exceeded
      */
     void _evaluate_temperature_sensors();
@@ -185,8 +508,26 @@ class AppController
 
     /** @brief Application state is sent as a push update via the SSE event source.
      *  See file: app_hw_control.cpp
+     *
+     * When delta telegrams are activated, this sends only the changed values
+     * unless keyframe is true or the keyframe interval has expired.
+     *
+     * The same telegrams are sent to the clients of the JSON WebSocket.
+     * When clients are connected to the binary event source or binary
+     * WebSocket, these get the complete binary telegram,
+     * see _push_state_update_bin().
+     */
+    void _push_state_update(bool keyframe = false);
+
+    /** @brief Send the binary telegram of snap base64-encoded via the
+     * binary SSE event source and as is via the binary WebSocket
+     */
+    void _push_state_update_bin(const AppStateSnapshot &snap);
+
+    /** @brief Number of FreeRTOS ticks until the next rate-limited state
+     * update is due, or portMAX_DELAY if none is pending.
      */
-    void _push_state_update();
+    TickType_t _ticks_until_push_due() const;
 };
 
 #endif
\ No newline at end of file
@@ -6,10 +6,21 @@
 #ifndef APP_STATE_MODEL__
 #define APP_STATE_MODEL__
 
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <string>
+
 #include <ArduinoJson.h>
 
+#include "esp_err.h"
 #include "ps_pwm.h"
 
+#include "seqlock.hpp"
+#include "ramp_generator.hpp"
+#include "json_stream_writer.hpp"
+#include "app_cmd.hpp"
+
 /** Most default values are defined in app_config.hpp!
  */
 #include "app_config.hpp"
@@ -38,60 +49,407 @@ struct AuxHwDrvState
 };
 
 
+/** @brief Plain copy of all application state values which are sent to the
+ * remote clients.
+ *
+ * Values are in SI base units as in the original locations. The snapshot is
+ * published consistently by the application task each loop pass, see
+ * AppState::publish_snapshot(), so that it can be serialized without
+ * mixing old and new values.
+ */
+struct AppStateSnapshot
+{
+    bool setpoint_throttling_enabled;
+    // Clock divider settings
+    uint8_t base_clk_prescale;
+    uint8_t timer_clk_prescale;
+    // Hardware and runtime user setpoint limits, setpoints and increments
+    float frequency_min_hw;
+    float frequency_max_hw;
+    float frequency_min;
+    float frequency_max;
+    float frequency;
+    float frequency_changerate;
+    float duty_min;
+    float duty_max;
+    float duty;
+    float duty_changerate;
+    RampProfile ramp_profile;
+    float dt_sum_max_hw;
+    float lead_dt;
+    float lag_dt;
+    bool power_pwm_active;
+    bool hw_oc_fault_occurred;
+    uint32_t oneshot_power_pulse_length_us;
+    bool sequencer_active;
+    bool sequencer_loop;
+    uint32_t sequencer_step;
+    uint32_t sequencer_n_steps;
+    uint32_t sequencer_pass;
+    uint32_t stage_time_fault_us;
+    uint32_t stage_time_acq_us;
+    uint32_t stage_time_ctrl_us;
+    uint32_t acq_exec_time_us;
+    uint32_t oc_fault_count;
+    uint32_t oc_fault_latency_us;
+    uint32_t oc_fault_latency_max_us;
+    float fan_setpoint;
+    float fan_kp;
+    float fan_ki;
+    float fan_duty;
+    uint32_t loop_overruns;
+    uint32_t tick_interval_ms;
+    uint32_t tick_seq;
+    uint32_t tick_missed;
+    uint32_t tick_lateness_us;
+    uint32_t tick_lateness_max_us;
+    uint32_t ramp_steps_missed;
+    uint32_t ramp_steps_caught_up;
+    uint32_t tick_overruns;
+    uint32_t tick_exec_time_us;
+    uint32_t tick_exec_time_max_us;
+    uint32_t pushes_suppressed;
+    uint32_t cmd_seq;
+    // Copy of state from AuxHwDrv module
+    AuxHwDrvState aux;
+};
+
+
+/** @brief Value types of the state schema fields, see StateField
+ */
+enum class FieldType : uint8_t {boolean, uint8, uint32, float32};
+
+/** @brief Descriptor of one application state value
+ *
+ * Values are stored in AppStateSnapshot at the given offset. The snapshot
+ * is the only place holding all values in one flat structure, the live
+ * values are spread over AppState, AuxHwDrvState and the PSPWM module.
+ *
+ * Scale converts from the snapshot value (SI base units) into the unit of
+ * the JSON telegram and of the API setter. Floats and scaled integers are
+ * written with the given number of decimal places. Changes smaller than
+ * epsilon (in telegram units) are not sent in delta telegrams. With
+ * epsilon = 0, every change is sent.
+ *
+ * Values with a setter are settable by the HTTP API command of that name.
+ * Persisted values are saved as settings and are restored using the setter.
+ */
+struct StateField {
+    const char *key;
+    FieldType type;
+    uint16_t offset;
+    float scale;
+    uint8_t decimal_places;
+    float epsilon;
+    bool persisted;
+    AppCmd setter;
+    const char *command;
+
+    constexpr bool is_settable() const {return command != nullptr;}
+};
+
+#define SNAP_OFFSET(member) static_cast<uint16_t>(offsetof(AppStateSnapshot, member))
+#define READ_ONLY false, AppCmd::_count, nullptr
+#define SETTABLE(cmd) false, AppCmd::cmd, #cmd
+#define PERSISTED(cmd) true, AppCmd::cmd, #cmd
+#define FIELD_BOOL(key, member, access) \
+    {key, FieldType::boolean, SNAP_OFFSET(member), 1.0f, 0, 0.0f, access}
+#define FIELD_UINT8(key, member, access) \
+    {key, FieldType::uint8, SNAP_OFFSET(member), 1.0f, 0, 0.0f, access}
+#define FIELD_UINT32(key, member, eps, access) \
+    {key, FieldType::uint32, SNAP_OFFSET(member), 1.0f, 0, eps, access}
+#define FIELD_FLOAT(key, member, scale, places, eps, access) \
+    {key, FieldType::float32, SNAP_OFFSET(member), scale, places, eps, access}
+
+/** @brief All application state values, in telegram order.
+ *
+ * This is the single source for the JSON telegram, the settings file and
+ * the setter commands of the HTTP API. Settings are restored in this order,
+ * so ramp settings and setpoint limits must precede the setpoints.
+ */
+inline constexpr StateField state_schema[] = {
+    // Setpoint throttling / soft-start feature activated/deactivated
+    FIELD_BOOL("setpoint_throttling_enabled", setpoint_throttling_enabled,
+               PERSISTED(set_setpoint_throttling_enabled)),
+    // Clock divider settings (read-only) [number factor]
+    FIELD_UINT8("base_div", base_clk_prescale, READ_ONLY),
+    FIELD_UINT8("timer_div", timer_clk_prescale, READ_ONLY),
+    // Hardware setpoint limits (maximum adjustment range) for output frequency [kHz]
+    FIELD_FLOAT("frequency_min_hw", frequency_min_hw, 1e-3f, 3, 0.0f, READ_ONLY),
+    FIELD_FLOAT("frequency_max_hw", frequency_max_hw, 1e-3f, 3, 0.0f, READ_ONLY),
+    // User setpoint limits (custom adjustment range) for output frequency [kHz]
+    FIELD_FLOAT("frequency_min", frequency_min, 1e-3f, 3, 0.0f, PERSISTED(set_frequency_min)),
+    FIELD_FLOAT("frequency_max", frequency_max, 1e-3f, 3, 0.0f, PERSISTED(set_frequency_max)),
+    // Setpoint throttling / soft-start speed for output frequency [kHz/sec]
+    FIELD_FLOAT("frequency_changerate", frequency_changerate, 1e-3f, 3, 0.0f,
+                PERSISTED(set_frequency_changerate)),
+    // User setpoint limits (custom adjustment range) for PWM result duty cycle [%]
+    FIELD_FLOAT("duty_min", duty_min, 100.0f, 2, 0.0f, PERSISTED(set_duty_min)),
+    FIELD_FLOAT("duty_max", duty_max, 100.0f, 2, 0.0f, PERSISTED(set_duty_max)),
+    // Setpoint throttling / soft-start speed for PWM result duty cycle [%/sec]
+    FIELD_FLOAT("duty_changerate", duty_changerate, 100.0f, 2, 0.0f,
+                PERSISTED(set_duty_changerate)),
+    // Setpoint throttling ramp profile, see enum RampProfile [number]
+    FIELD_UINT8("ramp_profile", ramp_profile, PERSISTED(set_ramp_profile)),
+    // PWM output frequency setpoint [kHz]
+    FIELD_FLOAT("frequency", frequency, 1e-3f, 3, 0.0f, PERSISTED(set_frequency)),
+    // PWM result duty cycle setpoint [%]
+    FIELD_FLOAT("duty", duty, 100.0f, 2, 0.0f, PERSISTED(set_duty)),
+    // Hardware limits for dead-time adjustment [ns]. Sum of dead-times must be smaller.
+    FIELD_FLOAT("dt_sum_max_hw", dt_sum_max_hw, 1e9f, 0, 0.0f, READ_ONLY),
+    // Dead-time setpoint for leading and lagging half-bridge leg [ns]
+    FIELD_FLOAT("lead_dt", lead_dt, 1e9f, 0, 0.0f, PERSISTED(set_lead_dt)),
+    FIELD_FLOAT("lag_dt", lag_dt, 1e9f, 0, 0.0f, PERSISTED(set_lag_dt)),
+    // Power stage overcurrent limit (depends on measurement shunt value) [A]
+    FIELD_FLOAT("current_limit", aux.current_limit, 1.0f, 2, 0.0f, PERSISTED(set_current_limit)),
+    // Overtemperature protection limits for sensor channels 1 and 2 [°C]
+    FIELD_FLOAT("temp_1_limit", aux.temp_1_limit, 1.0f, 1, 0.0f, PERSISTED(set_temp_1_limit)),
+    FIELD_FLOAT("temp_2_limit", aux.temp_2_limit, 1.0f, 1, 0.0f, PERSISTED(set_temp_2_limit)),
+    // Temperature sensor readout for channels 1 and 2 [°C]
+    FIELD_FLOAT("temp_1", aux.temp_1, 1.0f, 1, AppConstants{}.sse_delta_epsilon_temp, READ_ONLY),
+    FIELD_FLOAT("temp_2", aux.temp_2, 1.0f, 1, AppConstants{}.sse_delta_epsilon_temp, READ_ONLY),
+    // Heatsink fan activated/deactivated
+    FIELD_BOOL("fan_active", aux.fan_active, READ_ONLY),
+    // Fan override activated/deactivated:
+    // When set to "true", fan is always ON. Otherwise, fan is temperature-controlled
+    FIELD_BOOL("fan_override", aux.fan_override, PERSISTED(set_fan_override)),
+    // Power output relays on/off
+    FIELD_BOOL("relay_ref_active", aux.relay_ref_active, PERSISTED(set_relay_ref_active)),
+    FIELD_BOOL("relay_dut_active", aux.relay_dut_active, PERSISTED(set_relay_dut_active)),
+    // Gate driver supply and disable signal status (reat-only)
+    FIELD_BOOL("drv_supply_active", aux.drv_supply_active, READ_ONLY),
+    FIELD_BOOL("drv_disabled", aux.drv_disabled, READ_ONLY),
+    // PWM output signal activated/deactivated
+    FIELD_BOOL("power_pwm_active", power_pwm_active, SETTABLE(set_power_pwm_active)),
+    // Hardware Fault Shutdown Status is latched using this flag (read-only)
+    FIELD_BOOL("hw_oc_fault", hw_oc_fault_occurred, READ_ONLY),
+    // Overtemperature shutdown active flag (read-only)
+    FIELD_BOOL("hw_overtemp", aux.hw_overtemp, READ_ONLY),
+    // Length of the power output one-shot timer pulse [seconds]
+    // (Unsigned integer compared, scaled to float for the telegram)
+    {"oneshot_len", FieldType::uint32, SNAP_OFFSET(oneshot_power_pulse_length_us),
+     1e-6f, 6, 0.0f, PERSISTED(set_oneshot_len)},
+    // Setpoint sequencer running, loop mode, current step index,
+    // number of steps and completed passes (read-only except loop mode)
+    FIELD_BOOL("seq_active", sequencer_active, READ_ONLY),
+    FIELD_BOOL("seq_loop", sequencer_loop, SETTABLE(set_sequencer_loop)),
+    FIELD_UINT32("seq_step", sequencer_step, 0.0f, READ_ONLY),
+    FIELD_UINT32("seq_n_steps", sequencer_n_steps, 0.0f, READ_ONLY),
+    FIELD_UINT32("seq_pass", sequencer_pass, 0.0f, READ_ONLY),
+    // Fast tick execution time per stage and of acquisition task [µs] (read-only)
+    FIELD_UINT32("stage_fault_us", stage_time_fault_us,
+                 AppConstants{}.sse_delta_epsilon_tick_exec_us, READ_ONLY),
+    FIELD_UINT32("stage_acq_us", stage_time_acq_us,
+                 AppConstants{}.sse_delta_epsilon_tick_exec_us, READ_ONLY),
+    FIELD_UINT32("stage_ctrl_us", stage_time_ctrl_us,
+                 AppConstants{}.sse_delta_epsilon_tick_exec_us, READ_ONLY),
+    FIELD_UINT32("acq_exec_us", acq_exec_time_us,
+                 AppConstants{}.sse_delta_epsilon_tick_exec_us, READ_ONLY),
+    // Hardware fault interrupt events and notification latency [µs] (read-only)
+    FIELD_UINT32("oc_fault_count", oc_fault_count, 0.0f, READ_ONLY),
+    FIELD_UINT32("oc_fault_latency_us", oc_fault_latency_us, 0.0f, READ_ONLY),
+    FIELD_UINT32("oc_fault_latency_max_us", oc_fault_latency_max_us, 0.0f, READ_ONLY),
+    // Heatsink fan temperature control loop setpoint [°C], PI gains [1/K]
+    // and [1/(K*s)] and fan duty [%] (read-only). Overruns of all loops.
+    FIELD_FLOAT("fan_setpoint", fan_setpoint, 1.0f, 1, 0.0f, PERSISTED(set_fan_setpoint)),
+    FIELD_FLOAT("fan_kp", fan_kp, 1.0f, 4, 0.0f, PERSISTED(set_fan_kp)),
+    FIELD_FLOAT("fan_ki", fan_ki, 1.0f, 5, 0.0f, PERSISTED(set_fan_ki)),
+    FIELD_FLOAT("fan_duty", fan_duty, 100.0f, 1, 1.0f, READ_ONLY),
+    FIELD_UINT32("loop_overruns", loop_overruns, 0.0f, READ_ONLY),
+    // Current fast tick interval [ms] (read-only)
+    FIELD_UINT32("tick_interval_ms", tick_interval_ms, 0.0f, READ_ONLY),
+    // Application task fast tick sequence number, missed ticks and
+    // lateness [µs], setpoint ramp steps missed or caught up (read-only)
+    FIELD_UINT32("tick_seq", tick_seq, 0.0f, READ_ONLY),
+    FIELD_UINT32("tick_missed", tick_missed, 0.0f, READ_ONLY),
+    FIELD_UINT32("tick_late_us", tick_lateness_us,
+                 AppConstants{}.sse_delta_epsilon_tick_exec_us, READ_ONLY),
+    FIELD_UINT32("tick_late_max_us", tick_lateness_max_us, 0.0f, READ_ONLY),
+    FIELD_UINT32("ramp_missed", ramp_steps_missed, 0.0f, READ_ONLY),
+    FIELD_UINT32("ramp_caught_up", ramp_steps_caught_up, 0.0f, READ_ONLY),
+    // Application task fast tick overruns and execution time [µs] (read-only)
+    FIELD_UINT32("tick_overruns", tick_overruns, 0.0f, READ_ONLY),
+    FIELD_UINT32("tick_exec_us", tick_exec_time_us,
+                 AppConstants{}.sse_delta_epsilon_tick_exec_us, READ_ONLY),
+    FIELD_UINT32("tick_exec_max_us", tick_exec_time_max_us, 0.0f, READ_ONLY),
+    // State update pushes merged by the rate limiter (read-only)
+    FIELD_UINT32("push_suppressed", pushes_suppressed, 0.0f, READ_ONLY),
+    // Sequence number of the last applied command push, i.e. the state
+    // version returned by the batch command endpoint (read-only)
+    FIELD_UINT32("cmd_seq", cmd_seq, 0.0f, READ_ONLY),
+};
+
+#undef FIELD_FLOAT
+#undef FIELD_UINT32
+#undef FIELD_UINT8
+#undef FIELD_BOOL
+#undef PERSISTED
+#undef SETTABLE
+#undef READ_ONLY
+#undef SNAP_OFFSET
+
+/** @brief Maximum length of the JSON representation of a field value
+ */
+constexpr size_t state_field_max_len(const StateField &field) {
+    switch (field.type) {
+    case FieldType::boolean: return sizeof("false") - 1;
+    case FieldType::uint8: return sizeof("255") - 1;
+    case FieldType::uint32:
+        if (field.scale == 1.0f) {
+            return sizeof("4294967295") - 1;
+        }
+        return JsonStreamWriter::float_max_len(field.decimal_places);
+    case FieldType::float32: return JsonStreamWriter::float_max_len(field.decimal_places);
+    }
+    return 0;
+}
+
+/** @brief Number of fields, or of persisted fields only
+ */
+constexpr size_t state_schema_n_fields(bool persisted_only = false) {
+    auto n = size_t{0};
+    for (const auto &field : state_schema) {
+        if (field.persisted || !persisted_only) {
+            ++n;
+        }
+    }
+    return n;
+}
+
+/** @brief Sum of the lengths of all keys, each with a terminating null
+ */
+constexpr size_t state_schema_keys_size(bool persisted_only = false) {
+    auto size = size_t{0};
+    for (const auto &field : state_schema) {
+        if (field.persisted || !persisted_only) {
+            size += std::char_traits<char>::length(field.key) + 1;
+        }
+    }
+    return size;
+}
+
+/** @brief Maximum length of the JSON telegram, without terminating null
+ */
+constexpr size_t state_schema_telegram_max_len() {
+    // Braces
+    auto len = size_t{2};
+    for (const auto &field : state_schema) {
+        // Quotes, colon and separating comma
+        len += std::char_traits<char>::length(field.key) + 4
+               + state_field_max_len(field);
+    }
+    // No comma after the last value
+    return len - 1;
+}
+
+/** @brief Size of a field value in the binary telegram
+ */
+constexpr size_t state_field_bin_size(FieldType type) {
+    switch (type) {
+    case FieldType::boolean: return 1;
+    case FieldType::uint8: return 1;
+    case FieldType::uint32: return 4;
+    case FieldType::float32: return 4;
+    }
+    return 0;
+}
+
+/** @brief Size of all values of the binary telegram, without header,
+ * or of the persisted values only
+ */
+constexpr size_t state_schema_bin_size(bool persisted_only = false) {
+    auto size = size_t{0};
+    for (const auto &field : state_schema) {
+        if (field.persisted || !persisted_only) {
+            size += state_field_bin_size(field.type);
+        }
+    }
+    return size;
+}
+
+/** @brief 32-bit FNV-1a hash of all keys and types, in schema order.
+ *
+ * Binary telegram clients can detect a schema change with this.
+ * With persisted_only set, this identifies the settings blob layout.
+ */
+constexpr uint32_t state_schema_hash(bool persisted_only = false) {
+    auto hash = uint32_t{2166136261u};
+    auto add_byte = [&hash](uint8_t byte) {
+        hash = (hash ^ byte) * 16777619u;
+    };
+    for (const auto &field : state_schema) {
+        if (!field.persisted && persisted_only) {
+            continue;
+        }
+        for (auto c = field.key; *c; ++c) {
+            add_byte(static_cast<uint8_t>(*c));
+        }
+        add_byte(0);
+        add_byte(static_cast<uint8_t>(field.type));
+    }
+    return hash;
+}
+
+
+/** @brief True if cmd is the setter of a persisted value
+ */
+constexpr bool is_persisted_setter(AppCmd cmd) {
+    for (const auto &field : state_schema) {
+        if (field.persisted && field.setter == cmd) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/** @brief Callback applying a restored setting, see StateField
+ */
+using SettingSetterT = std::function<void(AppCmd cmd, CmdArg arg)>;
+
+
 /** @brief Application state containing data and settings model
  * 
  * Live data is kept here and and can be serialised to be sent to the
  * connected remote clients.
  * 
- * Runtime user configurable settings can be serialised and stored to file
- * or read back from file and restored into this instance.
+ * Runtime user configurable settings can be serialised and stored to NVS
+ * or read back from NVS and restored using the AppController setters.
  */
 struct AppState
 {
     ////////////// For application state JSON serialisation ////////////////
     //
-    // ATTENTION!
-    // Following constants need to be adapted if JSON object size is changed!
-    static constexpr size_t _key_strings_size = sizeof(
-        "setpoint_throttling_enabled"
-        "base_div"
-        "timer_div"
-        "frequency_min_hw"
-        "frequency_max_hw"
-        "frequency_min"
-        "frequency_max"
-        "frequency"
-        "frequency_changerate"
-        "duty_min"
-        "duty_max"
-        "duty"
-        "duty_changerate"
-        "dt_sum_max_hw"
-        "lead_dt"
-        "lag_dt"
-        "current_limit"
-        "temp_1_limit"
-        "temp_2_limit"
-        "temp_1"
-        "temp_2"
-        "fan_active"
-        "fan_override"
-        "relay_ref_active"
-        "relay_dut_active"
-        "drv_supply_active"
-        "drv_disabled"
-        "power_pwm_active"
-        "hw_oc_fault"
-        "hw_overtemp"
-        "oneshot_len"
-        );
-    // JSON_OBJECT_SIZE is provided with the number of properties as from above
-    static constexpr size_t _json_objects_size = JSON_OBJECT_SIZE(31);
-    // Prevent buffer overflow even if above calculations are wrong...
-    static constexpr size_t I_AM_SCARED_MARGIN = 50;
-    static constexpr size_t json_buf_len = _json_objects_size
-                                            + _key_strings_size
-                                            + I_AM_SCARED_MARGIN;
+    // Sizes are derived from state_schema at compile time.
+    static constexpr size_t n_state_fields = std::size(state_schema);
+    // Telegram including the terminating null
+    static constexpr size_t json_buf_len = state_schema_telegram_max_len() + 1;
+    // ArduinoJson document for reading back settings. Keys are copied.
+    // Settings files written by earlier versions contain all fields.
+    static constexpr size_t json_doc_size = JSON_OBJECT_SIZE(n_state_fields)
+                                            + state_schema_keys_size();
+
+    ////////////// For the binary state telegram, see serialize_snapshot_bin()
+    static constexpr uint8_t bin_format_version = 1;
+    static constexpr size_t bin_header_len = 8;
+    static constexpr size_t bin_buf_len = bin_header_len + state_schema_bin_size();
+    static constexpr uint32_t bin_schema_hash = state_schema_hash();
+
+    ////////////// For the settings blob in NVS, see serialize_settings_blob()
+    static constexpr uint32_t settings_blob_magic = 0x53504145; // "EAPS"
+    static constexpr uint16_t settings_blob_version = 1;
+    static constexpr size_t settings_header_len = 20;
+    static constexpr size_t n_persisted_fields = state_schema_n_fields(true);
+    // Keys with terminating null, plus one type byte per field
+    static constexpr size_t settings_keys_len = state_schema_keys_size(true)
+                                                + n_persisted_fields;
+    static constexpr size_t settings_values_len = state_schema_bin_size(true);
+    static constexpr size_t settings_blob_len = settings_header_len
+                                                + settings_keys_len
+                                                + settings_values_len;
+    // Blobs written by other firmware versions can have more fields
+    static constexpr size_t settings_blob_max_len = 2 * settings_blob_len;
+    static constexpr uint32_t settings_schema_hash = state_schema_hash(true);
 
     // Initial values for AppController()
     static constexpr AppConstants constants{};
@@ -113,40 +471,189 @@ struct AppState
     // Runtime user setpoint limits
     float frequency_min = constants.frequency_min;
     float frequency_max = constants.frequency_max;
-    // Runtime setpoints and throttling increment per fast event timer interval
+    // Runtime setpoints and throttling rate of change per second
     float frequency_target = 100.0e3f;
-    float frequency_increment = 500.0f;
+    float frequency_changerate = 25.0e3f;
     float duty_min = 0.0f;
     float duty_max = 0.8f;
     float duty_target = 0.0f;
-    float duty_increment = 0.05f;
+    float duty_changerate = 2.5f;
+    // Profile of the setpoint ramps when throttling is enabled
+    RampProfile ramp_profile = RampProfile::linear;
     // True when hardware OC shutdown condition is currently present
     bool hw_oc_fault_present = true;
     // Hardware Overcurrent Fault Shutdown Status is latched using this flag
     bool hw_oc_fault_occurred = true;
-    // Pulse length for one-shot mode power output pulse
-    uint32_t oneshot_power_pulse_length_ms = 1;
+    // Pulse length for one-shot mode power output pulse in microseconds
+    uint32_t oneshot_power_pulse_length_us = 1000;
+    // Setpoint sequencer progress
+    bool sequencer_active = false;
+    bool sequencer_loop = false;
+    uint32_t sequencer_step = 0;
+    uint32_t sequencer_n_steps = 0;
+    uint32_t sequencer_pass = 0;
+    // Fast tick execution time per stage: Fault polling, readout of the
+    // acquisition results, control functions. Plus execution time of the
+    // acquisition task itself.
+    uint32_t stage_time_fault_us = 0;
+    uint32_t stage_time_acq_us = 0;
+    uint32_t stage_time_ctrl_us = 0;
+    uint32_t acq_exec_time_us = 0;
+    // Hardware fault interrupt events and latency from the fault edge
+    // until the application task was notified (last and maximum value)
+    uint32_t oc_fault_count = 0;
+    uint32_t oc_fault_latency_us = 0;
+    uint32_t oc_fault_latency_max_us = 0;
+    // Heatsink fan temperature control loop, see control_loop.hpp.
+    // Setpoint [°C], PI gains [1/K], [1/(K*s)] and resulting fan duty [0...1]
+    float fan_setpoint = constants.fan_temp_setpoint;
+    float fan_kp = constants.fan_kp;
+    float fan_ki = constants.fan_ki;
+    float fan_duty = 0.0f;
+    // Sum of overruns of all control loops
+    uint32_t loop_overruns = 0;
+    // Application task fast tick statistics.
+    // Current fast tick interval, see AppConstants::timer_fast_adaptive
+    uint32_t tick_interval_ms = constants.timer_fast_interval_ms;
+    // Sequence number of the last fast tick, incremented for missed ticks too
+    uint32_t tick_seq = 0;
+    // Number of fast ticks missed, i.e. merged with a later one
+    uint32_t tick_missed = 0;
+    // Delay from the scheduled tick time until the tick is processed,
+    // last and maximum value
+    uint32_t tick_lateness_us = 0;
+    uint32_t tick_lateness_max_us = 0;
+    // Setpoint ramp steps not done in time. When the ramp catch-up is
+    // enabled, these are done late and counted as caught up instead.
+    uint32_t ramp_steps_missed = 0;
+    uint32_t ramp_steps_caught_up = 0;
+    // Number of fast ticks taking longer than one tick period
+    uint32_t tick_overruns = 0;
+    // Execution time of the last fast tick and maximum execution time
+    uint32_t tick_exec_time_us = 0;
+    uint32_t tick_exec_time_max_us = 0;
+    // State update pushes merged by the rate limiter
+    uint32_t pushes_suppressed = 0;
+    // Sequence number of the last command push applied, see CommandQueue
+    uint32_t cmd_seq = 0;
+
+    // Consistent copy of the above, published by the application task
+    SeqLock<AppStateSnapshot> snapshot;
+
+    /** @brief Copy all live values into a new AppStateSnapshot
+     */
+    AppStateSnapshot take_snapshot() const;
 
+    /** @brief Take a snapshot and publish it for the readers of "snapshot".
+     * Must only be called from the application task.
+     */
+    void publish_snapshot();
+
+    /** @brief Serialize an application state snapshot into buffer as a
+     * JSON string.
+     *
+     * If last_sent is given, only the values which differ from it by more
+     * than the configured epsilons are serialized (delta telegram), and
+     * these values are then copied into last_sent. Values changing by less
+     * than epsilon in each step are thus still sent once their sum is large.
+     */
+    static size_t serialize_snapshot(const AppStateSnapshot &snap,
+                                     char *buf, size_t buf_len,
+                                     AppStateSnapshot *last_sent = nullptr);
+
+
+    /** @brief Serialize an application state snapshot into buffer as a
+     * compact binary telegram.
+     *
+     * Little-endian header:
+     *   uint8 format version, uint8 reserved (0), uint16 number of fields,
+     *   uint32 schema hash, see state_schema_hash()
+     * followed by the values of all fields in state_schema order:
+     *   boolean and uint8: 1 byte, uint32: 4 bytes, float32: 4 bytes IEEE 754
+     *
+     * Values are not scaled, i.e. in SI base units as in the snapshot.
+     * Clients get keys, types and scales from the schema endpoint.
+     *
+     * @return Telegram length, 0 if buf_len is too small
+     */
+    static size_t serialize_snapshot_bin(const AppStateSnapshot &snap,
+                                         uint8_t *buf, size_t buf_len);
+
+    /** @brief Read application runtime configurable settings from json
+     * string in buffer into the persisted values of settings.
+     *
+     * Values missing in the JSON string are left unchanged.
+     */
+    static bool deserialize_settings(const char *buf, size_t buf_len,
+                                     AppStateSnapshot &settings);
+
+    /** @brief Restore settings by calling apply_setting with the setter
+     * command and argument of each persisted value, in state_schema order.
+     */
+    static void apply_settings(const AppStateSnapshot &settings,
+                               const SettingSetterT &apply_setting);
+
+    /** @brief Serialize the persisted values of a snapshot into buffer as
+     * a binary settings blob.
+     *
+     * Little-endian header:
+     *   uint32 magic, uint16 blob format version, uint16 number of fields,
+     *   uint32 schema hash, see state_schema_hash(true),
+     *   uint16 length of the key directory, uint16 length of the values,
+     *   uint32 CRC32 of all bytes following the header
+     * followed by the key directory, i.e. for each persisted field the key
+     * with terminating null and one FieldType byte, and then by the values
+     * in the same order and format as in the binary state telegram.
+     *
+     * The key directory makes it possible to restore the settings after
+     * fields were added, removed or reordered by a firmware update.
+     *
+     * @return Blob length, 0 if buf_len is too small
+     */
+    static size_t serialize_settings_blob(const AppStateSnapshot &snap,
+                                          uint8_t *buf, size_t buf_len);
+
+    /** @brief Read a settings blob into the persisted values of settings.
+     *
+     * When the blob was written with the current schema, the values are
+     * copied directly. Otherwise, they are matched by key and type, and
+     * values missing in the blob are left unchanged.
+     *
+     * @return ESP_OK, ESP_ERR_INVALID_SIZE, ESP_ERR_INVALID_VERSION
+     *         or ESP_ERR_INVALID_CRC. On error, settings are unchanged.
+     */
+    static esp_err_t deserialize_settings_blob(const uint8_t *buf, size_t buf_len,
+                                               AppStateSnapshot &settings);
+
+    /** @brief Write a settings blob to NVS, replacing the stored one.
+     *
+     * The previous blob is kept if the write is interrupted.
+     */
+    static esp_err_t write_settings_blob(const uint8_t *buf, size_t len);
 
-    /** @brief Serialize application runtime state and configurable settings
-     * into buffer as a JSON string.
+    /** @brief Read the stored settings blob from NVS.
+     *
+     * @param len: Buffer size on input, blob length on output
+     * @return ESP_ERR_NVS_NOT_FOUND if no settings were saved before
      */
-     size_t serialize_full_state(char *buf, size_t buf_len);
+    static esp_err_t read_settings_blob(uint8_t *buf, size_t *len);
 
-    /** @brief Restore application runtime configurable settings
-     * from json string in buffer back into this instance.
+    /** @brief Write the persisted values of settings to NVS,
+     * see serialize_settings_blob()
      */
-    bool deserialize_settings(const char *buf, size_t buf_len);
+    static bool save_to_nvs(const AppStateSnapshot &settings);
 
-    /** @brief Write application runtime configurable settings
-     * to SPIFFs file as a JSON string.
+    /** @brief Read the persisted values from NVS into settings,
+     * see deserialize_settings_blob()
+     *
+     * @return ESP_ERR_NVS_NOT_FOUND if no settings were saved before
      */
-    bool save_to_file(const char *filename);
+    static esp_err_t restore_from_nvs(AppStateSnapshot &settings);
 
-    /** @brief Restore application runtime configurable settings
-     * from SPIFFs file back into this instance.
+    /** @brief Read application runtime configurable settings from a JSON
+     * file written by earlier firmware versions, see deserialize_settings()
      */
-    bool restore_from_file(const char *filename);
+    static bool restore_from_file(const char *filename, AppStateSnapshot &settings);
 };
 
 #endif
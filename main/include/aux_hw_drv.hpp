@@ -22,8 +22,8 @@
  * PWM generation used as a reference signal for hardware overcurrent limiter.
  * 
  * Further, temperature sensor readout is triggered here by calling
- * update_temperature_sensors() member peroiodically from timer task in
- * PsPWMAppHwControl::on_periodic_update_timer().
+ * read_temperature_sensors() periodically from the acquisition task in
+ * AppController::_acquisition_task().
  * 
  * This class is also used as a container for its public attribute members
  * which represent the hardware state and are read-accessed externally.
@@ -54,8 +54,14 @@ class AuxHwDrv
      */
     void update_temperature_sensors();
 
+    /** @brief Acquire temperature sensor values via ADC without updating
+     * the state structure. For use from a separate acquisition task.
+     */
+    void read_temperature_sensors(float *temp_1, float *temp_2);
+
     /** @brief Check if temperature exceeds threshold value and
-     * switch fan accordingly
+     * set the overtemperature flag. The fan is switched by the fan
+     * temperature control loop in AppController.
      * 
      * To be called periodically from slow timer event
      */
@@ -0,0 +1,134 @@
+/** @file command_queue.hpp
+ * @brief Bounded, allocation-free and coalescing queue for typed commands
+ *
+ * License: GPL v.3
+ */
+#ifndef COMMAND_QUEUE_HPP__
+#define COMMAND_QUEUE_HPP__
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <array>
+
+#include "freertos/FreeRTOS.h"
+
+
+/** @brief Bounded, allocation-free and coalescing queue for typed commands
+ *
+ * Commands are pushed from any task and are drained as a batch by the task
+ * owning the hardware, e.g. at the start of each control tick.
+ *
+ * Each command type is queued at most once: When a command is pushed which
+ * is already pending, the pending entry is removed and the command is
+ * appended again with the newest argument. This way, a flood of setpoint
+ * changes results in only one hardware write per control tick, the queue
+ * can never overflow, and the commands are applied in the order of their
+ * last push, e.g. set_duty, set_output, set_duty applies set_output first.
+ *
+ * Commands pushed as one batch are always drained together, i.e. they are
+ * applied in the same control tick. Every push increments a sequence number
+ * which is reported by drain(), so the draining task can publish which
+ * pushes have taken effect.
+ *
+ * @param TCmd: Enum type of the commands. Values must be 0..n_cmds-1
+ * @param TArg: Argument type, must be trivially copyable
+ * @param n_cmds: Number of different commands
+ */
+template<typename TCmd, typename TArg, size_t n_cmds>
+class CommandQueue
+{
+public:
+    struct Entry {
+        TCmd cmd;
+        TArg arg;
+    };
+    using Batch = std::array<Entry, n_cmds>;
+
+    /** @brief Queue a command or replace argument if already pending
+     *
+     * @return Sequence number of this push
+     */
+    uint32_t push(TCmd cmd, TArg arg) {
+        portENTER_CRITICAL(&_lock);
+        _push_locked(cmd, arg);
+        auto seq = ++_push_seq;
+        portEXIT_CRITICAL(&_lock);
+        return seq;
+    }
+
+    /** @brief Queue several commands at once, so that they are drained
+     * together. Later entries for the same command replace earlier ones.
+     *
+     * @return Sequence number of this push
+     */
+    uint32_t push_batch(const Entry *entries, size_t n_entries) {
+        portENTER_CRITICAL(&_lock);
+        for (size_t i = 0; i < n_entries; ++i) {
+            _push_locked(entries[i].cmd, entries[i].arg);
+        }
+        auto seq = ++_push_seq;
+        portEXIT_CRITICAL(&_lock);
+        return seq;
+    }
+
+    /** @brief Remove all pending commands from the queue in one go.
+     *
+     * @param seq: Optional output, sequence number of the last push
+     *             included in the batch
+     * @return Number of entries written to "batch"
+     */
+    size_t drain(Batch &batch, uint32_t *seq = nullptr) {
+        portENTER_CRITICAL(&_lock);
+        if (seq) {
+            *seq = _push_seq;
+        }
+        auto len = _len;
+        for (auto i = 0u; i < len; ++i) {
+            auto cmd_index = static_cast<size_t>(_order[i]);
+            batch[i] = Entry{_order[i], _args[cmd_index]};
+            _is_queued[cmd_index] = false;
+        }
+        _len = 0;
+        portEXIT_CRITICAL(&_lock);
+        return len;
+    }
+
+    /** @brief Number of commands which were merged into a pending one
+     * since startup
+     */
+    uint32_t get_merged_count() const {return _merged_count;}
+
+private:
+    std::array<TCmd, n_cmds> _order{};
+    std::array<TArg, n_cmds> _args{};
+    std::array<bool, n_cmds> _is_queued{};
+    size_t _len = 0;
+    uint32_t _merged_count = 0;
+    uint32_t _push_seq = 0;
+    portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+
+    // Caller must hold _lock
+    void _push_locked(TCmd cmd, TArg arg) {
+        auto i = static_cast<size_t>(cmd);
+        assert(i < n_cmds);
+        _args[i] = arg;
+        if (_is_queued[i]) {
+            ++_merged_count;
+            // Move to the tail, keeping the order of the other entries
+            auto pos = size_t{0};
+            while (_order[pos] != cmd) {
+                ++pos;
+            }
+            for (; pos + 1 < _len; ++pos) {
+                _order[pos] = _order[pos + 1];
+            }
+            _order[_len - 1] = cmd;
+        } else {
+            _is_queued[i] = true;
+            _order[_len++] = cmd;
+        }
+    }
+};
+
+#endif
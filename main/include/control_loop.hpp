@@ -0,0 +1,201 @@
+/** @file control_loop.hpp
+ * @brief Fixed-rate closed-loop control engine with anti-windup PID blocks
+ *
+ * All calculations use single-precision float (hardware FPU on ESP32) and
+ * have a fixed number of operations, i.e. bounded execution time.
+ *
+ * License: GPL v.3
+ */
+#ifndef CONTROL_LOOP_HPP__
+#define CONTROL_LOOP_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+
+/** @brief Parameters for PIDController
+ */
+struct PIDParams {
+    // Proportional gain [output unit / input unit]
+    float kp;
+    // Integral gain [output unit / (input unit * s)]
+    float ki;
+    // Derivative gain [output unit * s / input unit]
+    float kd;
+    // Output limits. The integrator is limited to the same range.
+    float out_min;
+    float out_max;
+    // When true, output rises when measurement is above setpoint (e.g. cooling)
+    bool reverse_acting;
+};
+
+
+/** @brief PI/PID controller with anti-windup
+ *
+ * Anti-windup is done by conditional integration: While the output is
+ * saturated, the integrator only integrates in the direction leading out
+ * of saturation. The derivative term acts on the measurement only, so
+ * setpoint steps do not cause output spikes. Set kd = 0 for a PI controller.
+ */
+class PIDController
+{
+public:
+    explicit PIDController(const PIDParams &params)
+        : _params{params}
+    {}
+
+    void set_params(const PIDParams &params) {_params = params;}
+    const PIDParams &get_params() const {return _params;}
+
+    /** @brief Reset integrator to initial output value and derivative state
+     */
+    void reset(float output = 0.0f);
+
+    /** @brief Calculate new output value
+     * @param dt_s: Time since last update in seconds, must be > 0
+     */
+    float update(float setpoint, float measurement, float dt_s);
+
+    float get_output() const {return _output;}
+
+private:
+    PIDParams _params;
+    float _integral = 0.0f;
+    float _last_measurement = 0.0f;
+    bool _has_last_measurement = false;
+    float _output = 0.0f;
+};
+
+
+/** @brief Converts a duty cycle into on/off switching for slow actuators
+ * like relays or fans. Each window of window_ms is switched on for
+ * duty * window_ms. Switching times shorter than min_switch_ms are avoided.
+ */
+class TimeProportioningOutput
+{
+public:
+    TimeProportioningOutput(uint32_t window_ms, uint32_t min_switch_ms)
+        : _window_us{window_ms * 1000ll}
+        , _min_switch_us{min_switch_ms * 1000ll}
+    {}
+
+    /** @return Output state at time now_us for duty cycle 0...1
+     */
+    bool update(float duty, int64_t now_us);
+
+private:
+    const int64_t _window_us;
+    const int64_t _min_switch_us;
+    int64_t _window_start_us = 0;
+};
+
+
+/** @brief Fixed-rate control loop: Reads an input, runs a PIDController
+ * and writes an output, once every period.
+ *
+ * Parameters can be changed from any task, see set_param().
+ * Input and output functions are called from the task running the engine.
+ */
+class ControlLoop
+{
+public:
+    using input_fn_t = float (*)(void *arg);
+    using output_fn_t = void (*)(float output, void *arg);
+
+    /** @brief Parameters which can be changed at runtime */
+    enum class Param : uint8_t {setpoint, kp, ki, kd, _count};
+
+    ControlLoop(const char *name, uint32_t period_ms, float setpoint,
+                const PIDParams &params,
+                input_fn_t input_fn, output_fn_t output_fn, void *arg)
+        : name{name}
+        , _period_us{period_ms * 1000ll}
+        , _setpoint{setpoint}
+        , _params{params}
+        , _pid{params}
+        , _input_fn{input_fn}
+        , _output_fn{output_fn}
+        , _arg{arg}
+    {}
+
+    // Name used e.g. for the API commands
+    const char *const name;
+
+    /** @brief Set a runtime parameter. Thread-safe.
+     */
+    void set_param(Param param, float value);
+    float get_param(Param param) const;
+
+    /** @brief Disabled loops do not call the output function.
+     * When re-enabled, the loop restarts with a reset integrator.
+     */
+    void set_enabled(bool enabled) {_enabled = enabled;}
+    bool is_enabled() const {return _enabled;}
+
+    /** @brief Run the loop if it is due at time now_us.
+     *
+     * Periods missed completely are counted as overruns, as are
+     * executions taking longer than one period.
+     * @return true if the loop was run
+     */
+    bool run_if_due(int64_t now_us);
+
+    float get_output() const {return _pid.get_output();}
+    uint32_t get_overruns() const {return _overruns;}
+    uint32_t get_exec_time_us() const {return _exec_time_us;}
+
+private:
+    const int64_t _period_us;
+    float _setpoint;
+    PIDParams _params;
+    PIDController _pid;
+    input_fn_t _input_fn;
+    output_fn_t _output_fn;
+    void *_arg;
+    volatile bool _enabled = true;
+    bool _was_enabled = false;
+    int64_t _next_due_us = 0;
+    uint32_t _overruns = 0;
+    uint32_t _exec_time_us = 0;
+    // Protects _setpoint and _params
+    mutable portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+};
+
+
+/** @brief Runs up to max_loops ControlLoop objects, each at its own rate.
+ *
+ * run_due() is to be called periodically at least as often as required by
+ * the fastest loop, e.g. from the application task fast tick.
+ */
+class ControlLoopEngine
+{
+public:
+    static constexpr size_t max_loops = 4;
+
+    /** @return ESP_ERR_NO_MEM if more than max_loops are added
+     */
+    esp_err_t add_loop(ControlLoop &loop);
+
+    /** @brief Run all loops which are due at time now_us
+     */
+    void run_due(int64_t now_us);
+
+    /** @brief Sum of overruns of all loops
+     */
+    uint32_t get_overruns() const;
+
+    /** @brief Loop with given name or nullptr
+     */
+    ControlLoop *find(const char *name) const;
+
+    const std::array<ControlLoop*, max_loops> &get_loops() const {return _loops;}
+
+private:
+    std::array<ControlLoop*, max_loops> _loops{};
+};
+
+#endif
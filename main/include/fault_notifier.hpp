@@ -0,0 +1,83 @@
+/** @file fault_notifier.hpp
+ * @brief Interrupt-driven notification of hardware fault events
+ *
+ * License: GPL v.3
+ */
+#ifndef FAULT_NOTIFIER_HPP__
+#define FAULT_NOTIFIER_HPP__
+
+#include <cstdint>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "esp_err.h"
+
+
+/** @brief Fault event as seen by the notified task
+ */
+struct FaultEvent {
+    // esp_timer_get_time() when the fault edge was detected by the ISR
+    int64_t fault_time_us;
+    // Time from fault edge until the event was taken by the notified task
+    uint32_t latency_us;
+    // Number of fault edges since startup, including merged ones
+    uint32_t count;
+};
+
+
+/** @brief Interrupt-driven notification of hardware fault events
+ *
+ * A GPIO edge interrupt on the fault input pin wakes a task using a task
+ * notification. The time of the first edge is recorded so the task can
+ * determine the notification latency. Further edges before the task has
+ * taken the event are only counted.
+ *
+ * The hardware fault shutdown itself is done by the MCPWM peripheral and
+ * does not depend on this.
+ *
+ * For testing without hardware, on_fault_edge() is the fault source
+ * stand-in. It can also be called from task context with a simulated time.
+ */
+class FaultNotifier
+{
+public:
+    FaultNotifier() = default;
+    ~FaultNotifier();
+
+    /** @brief Setup the GPIO interrupt.
+     *
+     * @param gpio_num: Fault input pin, can also be used by the MCPWM
+     * @param active_low: Interrupt on falling instead of rising edge
+     * @param task: Task which is notified
+     * @param notify_bits: Set in the task notification value, eSetBits
+     */
+    esp_err_t begin(gpio_num_t gpio_num, bool active_low,
+                    TaskHandle_t task, uint32_t notify_bits);
+
+    /** @brief Record a fault edge at time now_us.
+     *
+     * Called from the ISR, safe to call from any task.
+     * @return true if this is a new event, i.e. the task must be notified.
+     */
+    bool on_fault_edge(int64_t now_us);
+
+    /** @brief Take the pending fault event, called by the notified task.
+     *
+     * @return false if no event was pending
+     */
+    bool take_event(int64_t now_us, FaultEvent *event);
+
+private:
+    gpio_num_t _gpio_num = GPIO_NUM_NC;
+    TaskHandle_t _task = nullptr;
+    uint32_t _notify_bits = 0;
+    int64_t _fault_time_us = 0;
+    uint32_t _count = 0;
+    bool _pending = false;
+    portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+
+    static void _isr_handler(void *arg);
+};
+
+#endif
@@ -0,0 +1,133 @@
+/** @file fixed_point_format.hpp
+ * @brief Fast float to text conversion with fixed number of decimal places
+ *
+ * License: GPL v.3
+ */
+#ifndef FIXED_POINT_FORMAT_HPP__
+#define FIXED_POINT_FORMAT_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+
+/** @brief Float to text conversion with fixed number of decimal places,
+ * e.g. "-12.340" for three decimal places.
+ *
+ * The value is rounded to the given precision and converted using integer
+ * arithmetic, which is much faster than printf("%.*f") and does not print
+ * digits beyond the declared precision. Ties are rounded away from zero.
+ *
+ * The magnitude of the value must be smaller than max_abs. Non-finite and
+ * out-of-range values are not converted.
+ */
+namespace FixedPoint {
+    static constexpr float max_abs = 1e9f;
+    static constexpr uint8_t max_decimal_places = 9;
+
+    /** @brief Maximum length of the text, without terminating null
+     */
+    constexpr size_t max_len(uint8_t decimal_places) {
+        if (decimal_places > max_decimal_places) {
+            decimal_places = max_decimal_places;
+        }
+        // Sign and ten integer digits, as rounding can reach max_abs
+        return 11 + (decimal_places ? 1 + decimal_places : 0);
+    }
+
+    /** @brief Write value as null-terminated text into buf, which must have
+     * room for max_len(decimal_places) + 1 characters.
+     *
+     * Decimal places are limited to max_decimal_places.
+     *
+     * @return Text length, 0 if value is non-finite or out of range
+     */
+    inline size_t format(char *buf, float value, uint8_t decimal_places) {
+        static constexpr uint32_t powers_of_ten[max_decimal_places + 1] = {
+            1u, 10u, 100u, 1000u, 10000u, 100000u,
+            1000000u, 10000000u, 100000000u, 1000000000u};
+        if (!std::isfinite(value) || std::fabs(value) >= max_abs) {
+            buf[0] = '\0';
+            return 0;
+        }
+        if (decimal_places > max_decimal_places) {
+            decimal_places = max_decimal_places;
+        }
+        // The float value is mantissa * 2^-shift exactly. Integer and
+        // fractional part are computed from this using integer arithmetic,
+        // which gives correctly rounded results also for many decimal places.
+        // There is no double arithmetic, the ESP32 FPU has no double support.
+        auto bits = uint32_t{0};
+        std::memcpy(&bits, &value, sizeof(bits));
+        const auto biased_exponent = static_cast<int>((bits >> 23) & 0xff);
+        auto mantissa = bits & 0x7fffff;
+        auto shift = 149;
+        if (biased_exponent != 0) {
+            mantissa |= 0x800000;
+            shift = 150 - biased_exponent;
+        }
+        const auto scale = powers_of_ten[decimal_places];
+        auto integer_part = uint32_t{0};
+        auto fraction = uint32_t{0};
+        if (shift <= 0) {
+            // Fits as value is smaller than max_abs
+            integer_part = mantissa << -shift;
+        } else if (shift < 32) {
+            integer_part = mantissa >> shift;
+            const auto fraction_bits = uint64_t{mantissa & ((1u << shift) - 1)};
+            // Below 2^54, rounded half up
+            fraction = static_cast<uint32_t>(
+                (fraction_bits * scale + (uint64_t{1} << (shift - 1))) >> shift);
+        } else if (shift < 56) {
+            fraction = static_cast<uint32_t>(
+                (uint64_t{mantissa} * scale + (uint64_t{1} << (shift - 1))) >> shift);
+        }
+        if (fraction >= scale) {
+            fraction -= scale;
+            ++integer_part;
+        }
+        const auto is_zero = integer_part == 0 && fraction == 0;
+        // Digits are generated in reverse order
+        char digits[max_len(max_decimal_places)];
+        auto n = size_t{0};
+        for (auto i = 0; i < decimal_places; ++i) {
+            digits[n++] = static_cast<char>('0' + fraction % 10);
+            fraction /= 10;
+        }
+        if (decimal_places) {
+            digits[n++] = '.';
+        }
+        do {
+            digits[n++] = static_cast<char>('0' + integer_part % 10);
+            integer_part /= 10;
+        } while (integer_part);
+        // No sign for values rounding to zero
+        if (value < 0.0f && !is_zero) {
+            digits[n++] = '-';
+        }
+        for (size_t i = 0; i < n; ++i) {
+            buf[i] = digits[n - 1 - i];
+        }
+        buf[n] = '\0';
+        return n;
+    }
+
+    /** @brief Formatted value as a null-terminated string, e.g. for use
+     * with printf("%s") or for appending to a String.
+     *
+     * Non-finite and out-of-range values result in an empty string.
+     */
+    struct Text {
+        Text(float value, uint8_t decimal_places) {
+            format(_buf, value, decimal_places);
+        }
+
+        const char *c_str() const {return _buf;}
+
+    private:
+        char _buf[max_len(max_decimal_places) + 1];
+    };
+}
+
+#endif
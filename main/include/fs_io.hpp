@@ -16,6 +16,8 @@ namespace FSIO {
     bool write_to_file_uint8(const char *filename, uint8_t *buf, size_t len);
 
     size_t read_from_file_uint8(const char *filename, uint8_t *buf, size_t max_len);
+
+    bool remove_file(const char *filename);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,75 @@
+/** @file json_stream_writer.hpp
+ * @brief Minimal streaming JSON writer for flat objects
+ *
+ * License: GPL v.3
+ */
+#ifndef JSON_STREAM_WRITER_HPP__
+#define JSON_STREAM_WRITER_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "fixed_point_format.hpp"
+
+
+/** @brief Writes a flat JSON object directly into a character buffer
+ *
+ * There is no intermediate document and no heap allocation. Keys are
+ * written as-is, i.e. they must not contain characters needing escapes,
+ * string values are escaped.
+ * Floats are written with a fixed number of decimal places, see
+ * FixedPoint::format(). Non-finite values and values of magnitude
+ * FixedPoint::max_abs or larger are written as null.
+ *
+ * When the buffer is too small, the output is truncated, finish()
+ * returns 0 and the buffer contains an empty string.
+ */
+class JsonStreamWriter
+{
+public:
+    /** @brief Maximum length of a float value written by this
+     */
+    static constexpr size_t float_max_len(uint8_t decimal_places) {
+        return FixedPoint::max_len(decimal_places);
+    }
+
+    JsonStreamWriter(char *buf, size_t buf_len)
+        : _buf{buf}
+        , _buf_len{buf_len}
+    {}
+
+    void begin_object();
+    void end_object();
+
+    /** @brief Write a key, preceded by a separator if needed
+     */
+    void key(const char *key);
+
+    void value(bool value);
+    void value(uint32_t value);
+    void value(float value, uint8_t decimal_places);
+    /** @brief Write a string value. Quotes, backslashes and control
+     * characters are escaped, so this can be used for untrusted input.
+     * Each input character takes up to 6 characters of output.
+     */
+    void value(const char *value);
+
+    /** @brief Null-terminate the output
+     * @return Output length without terminating null, 0 on overflow
+     */
+    size_t finish();
+
+    bool has_overflowed() const {return _overflow;}
+
+private:
+    char *_buf;
+    size_t _buf_len;
+    size_t _pos = 0;
+    bool _overflow = false;
+    bool _first_member = true;
+
+    void _put(char c);
+    void _put(const char *str);
+};
+
+#endif
@@ -0,0 +1,86 @@
+/** @file latency_histogram.hpp
+ * @brief Low-overhead execution time and latency histograms
+ *
+ * License: GPL v.3
+ */
+#ifndef LATENCY_HISTOGRAM_HPP__
+#define LATENCY_HISTOGRAM_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+
+#include "hal/cpu_hal.h"
+
+
+/** @brief Histogram of durations in CPU cycles with fixed log2 buckets
+ *
+ * Bucket i counts durations from 2^i up to 2^(i+1) - 1 cycles, bucket 0
+ * also counts zero durations. Recording a value takes a few instructions
+ * only (count leading zeros is a single instruction on Xtensa), so this can
+ * be used in the control tick.
+ *
+ * Durations are taken from the CPU cycle counter, see now_cycles(). This is
+ * a per-core counter, so start and stop must be on the same core, i.e.
+ * from a core-pinned task. It wraps after 2^32 cycles (17.9 s at 240 MHz),
+ * longer durations are not supported.
+ *
+ * record() must only be called from one task. Other tasks can read the
+ * values without locking. These could then be off by the sample which is
+ * just being recorded, which is fine for statistics.
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr size_t n_buckets = 32;
+
+    static uint32_t now_cycles() {
+        return cpu_hal_get_cycle_count();
+    }
+
+    /** @brief Record a duration given in CPU cycles
+     */
+    void record(uint32_t cycles) {
+        if (_reset_requested) {
+            _buckets.fill(0);
+            _count = 0;
+            _sum = 0;
+            _max = 0;
+            _reset_requested = false;
+        }
+        ++_buckets[cycles ? 31 - __builtin_clz(cycles) : 0];
+        ++_count;
+        _sum += cycles;
+        if (cycles > _max) {
+            _max = cycles;
+        }
+    }
+
+    /** @brief Record the duration from start_cycles until now
+     */
+    void record_since(uint32_t start_cycles) {
+        record(now_cycles() - start_cycles);
+    }
+
+    /** @brief Reset is done by the recording task on the next record() call.
+     * Safe to call from any task.
+     */
+    void request_reset() {_reset_requested = true;}
+
+    uint32_t get_count() const {return _count;}
+    uint32_t get_max() const {return _max;}
+    uint32_t get_mean() const {
+        auto count = _count;
+        return count ? static_cast<uint32_t>(_sum / count) : 0;
+    }
+    const std::array<uint32_t, n_buckets> &get_buckets() const {return _buckets;}
+
+private:
+    std::array<uint32_t, n_buckets> _buckets{};
+    uint32_t _count = 0;
+    uint64_t _sum = 0;
+    uint32_t _max = 0;
+    volatile bool _reset_requested = false;
+};
+
+#endif
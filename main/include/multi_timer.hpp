@@ -9,7 +9,9 @@
 
 //#include <functional> // Has std::invoke but is only available from C++17..
 //#include <type_traits> // C++20 version has the std::type_identity_t built in
+#include <cstdint>
 #include "freertos/semphr.h"
+#include "esp_timer.h"
 #include <Ticker.h>
 
 // Allows calling a ordinary (non-static) class member function by inserting a
@@ -110,7 +112,7 @@ class MultiTimer : private Ticker
      *     repeats, please use the Ticker class which features the periodic
      *     attach_ms() which has better long-term accuracy.
      * 
-     * @param milliseconds: Timer interval in milliseconds
+     * @param microseconds: Timer interval in microseconds
      * @param total_repeat_count: Timer is stopped after this many repeats
      * @param callback: Callback function to register into this timer
      * @param arg: Numeric arg or pointer to object, e.g. calling class instance
@@ -120,105 +122,97 @@ class MultiTimer : private Ticker
      *                            until total repeat count is reached
      */
     template <typename TArg>
-    esp_err_t attach_static_ms(uint32_t milliseconds,
+    esp_err_t attach_static_us(uint64_t microseconds,
                                uint32_t total_repeat_count,
                                void (*callback)(type_identity_t<TArg>, uint32_t),
                                TArg arg,
                                bool first_tick_nodelay=false) {
-        static_assert(sizeof(TArg) <= sizeof(uint32_t),
-                      "attach_ms() callback argument size must be <= 4 bytes");
-        _interval_ms = milliseconds;
+        static_assert(sizeof(TArg) <= sizeof(uintptr_t),
+                      "attach_us() callback argument must fit into a pointer");
+        _interval_us = microseconds;
         _repeat_count_requested = total_repeat_count;
         _callback = reinterpret_cast<callback_t>(callback);
-        _orig_arg = (uint32_t)arg;
+        _orig_arg = (uintptr_t)arg;
         _first_tick_nodelay = first_tick_nodelay;
-        _cb_lambda = [](void *_this){
-            auto self = static_cast<decltype(this)>(_this);
-            self->_mutex_take();
-            auto repeat_count = ++self->_repeat_count;
-            if (repeat_count < self->_repeat_count_requested) {
-                esp_timer_start_once(self->_timer, self->_interval_ms*1000ull);
-            } else {
-                self->_repeat_count = 0;
-            }
-            auto cb = reinterpret_cast<callback_with_arg_and_count_t>(self->_callback);
-            auto arg = (TArg)(self->_orig_arg);
-            cb(arg, repeat_count);
-            self->_mutex_give();
-            };
-        return _attach_ms((uint32_t)this);
+        _cb_trampoline = _on_timer_with_arg_and_count<TArg>;
+        return _attach_us(this);
     }
 
     template <typename TArg>
-    esp_err_t attach_static_ms(uint32_t milliseconds,
+    esp_err_t attach_static_us(uint64_t microseconds,
                                uint32_t total_repeat_count,
                                void (*callback)(type_identity_t<TArg>),
                                TArg arg,
                                bool first_tick_nodelay=false) {
-        static_assert(sizeof(TArg) <= sizeof(uint32_t),
-                      "attach_ms() callback argument size must be <= 4 bytes");
-        _interval_ms = milliseconds;
+        static_assert(sizeof(TArg) <= sizeof(uintptr_t),
+                      "attach_us() callback argument must fit into a pointer");
+        _interval_us = microseconds;
         _repeat_count_requested = total_repeat_count;
         _callback = reinterpret_cast<callback_t>(callback);
-        _orig_arg = (uint32_t)arg;
+        _orig_arg = (uintptr_t)arg;
         _first_tick_nodelay = first_tick_nodelay;
-        _cb_lambda = [](void *_this){
-            auto self = static_cast<decltype(this)>(_this);
-            self->_mutex_take();
-            auto repeat_count = ++self->_repeat_count;
-            if (repeat_count < self->_repeat_count_requested) {
-                esp_timer_start_once(self->_timer, self->_interval_ms*1000ull);
-            } else {
-                self->_repeat_count = 0;
-            }
-            auto cb = reinterpret_cast<callback_with_arg_t>(self->_callback);
-            auto arg = (TArg)(self->_orig_arg);
-            cb(arg);
-            self->_mutex_give();
-            };
-        return _attach_ms((uint32_t)this);
+        _cb_trampoline = _on_timer_with_arg<TArg>;
+        return _attach_us(this);
     }
 
-    esp_err_t attach_static_ms(uint32_t milliseconds,
+    esp_err_t attach_static_us(uint64_t microseconds,
                                uint32_t total_repeat_count,
                                callback_t callback,
                                bool first_tick_nodelay=false) {
-        _interval_ms = milliseconds;
+        _interval_us = microseconds;
         _repeat_count_requested = total_repeat_count;
         _callback = reinterpret_cast<callback_t>(callback);
         _first_tick_nodelay = first_tick_nodelay;
-        _cb_lambda = [](void *_this){
-            auto self = static_cast<decltype(this)>(_this);
-            self->_mutex_take();
-            auto repeat_count = ++self->_repeat_count;
-            if (repeat_count < self->_repeat_count_requested) {
-                esp_timer_start_once(self->_timer, self->_interval_ms*1000ull);
-            } else {
-                self->_repeat_count = 0;
-            }
-            self->_callback();
-            self->_mutex_give();
-            };
-        return _attach_ms((uint32_t)this);
+        _cb_trampoline = _on_timer;
+        return _attach_us(this);
+    }
+
+    /** @brief Same as attach_static_us() but with interval in milliseconds
+     */
+    template <typename TArg>
+    esp_err_t attach_static_ms(uint32_t milliseconds,
+                               uint32_t total_repeat_count,
+                               void (*callback)(type_identity_t<TArg>, uint32_t),
+                               TArg arg,
+                               bool first_tick_nodelay=false) {
+        return attach_static_us<TArg>(milliseconds*1000ull, total_repeat_count,
+                                      callback, arg, first_tick_nodelay);
+    }
+
+    template <typename TArg>
+    esp_err_t attach_static_ms(uint32_t milliseconds,
+                               uint32_t total_repeat_count,
+                               void (*callback)(type_identity_t<TArg>),
+                               TArg arg,
+                               bool first_tick_nodelay=false) {
+        return attach_static_us<TArg>(milliseconds*1000ull, total_repeat_count,
+                                      callback, arg, first_tick_nodelay);
+    }
+
+    esp_err_t attach_static_ms(uint32_t milliseconds,
+                               uint32_t total_repeat_count,
+                               callback_t callback,
+                               bool first_tick_nodelay=false) {
+        return attach_static_us(milliseconds*1000ull, total_repeat_count,
+                                callback, first_tick_nodelay);
     }
 
     /** Without return value, we don't get this out of the lambda without
      * another class member.. 
      */
     void start() {
-        if (_first_tick_nodelay && _cb_lambda) {
-            _cb_lambda(this);
+        if (_first_tick_nodelay && _cb_trampoline) {
+            _cb_trampoline(this);
         } else {
-            esp_timer_start_once(_timer, _interval_ms*1000ull);
+            esp_timer_start_once(_timer, _interval_us);
         }
     }
     void start(uint32_t interval_ms) {
-        _interval_ms = interval_ms;
-        if (_first_tick_nodelay && _cb_lambda) {
-            _cb_lambda(this);
-        } else {
-            esp_timer_start_once(_timer, _interval_ms*1000ull);
-        }
+        start_us(interval_ms*1000ull);
+    }
+    void start_us(uint64_t interval_us) {
+        _interval_us = interval_us;
+        start();
     }
 
     void stop() {
@@ -239,10 +233,10 @@ class MultiTimer : private Ticker
     }
 
     void resume() {
-        esp_timer_start_once(_timer, _interval_ms*1000ull);
+        esp_timer_start_once(_timer, _interval_us);
     }
     esp_err_t resume_return_errors() {
-        return esp_timer_start_once(_timer, _interval_ms*1000ull);
+        return esp_timer_start_once(_timer, _interval_us);
     }
 
     // The only other functions we make available again in this class
@@ -251,23 +245,24 @@ class MultiTimer : private Ticker
 
 protected:
     using Ticker::_timer;
-    uint32_t _interval_ms;
+    uint64_t _interval_us{0};
     uint32_t _repeat_count_requested{1};
     uint32_t _repeat_count{0};
     // Original callback cast into a callback_t
     callback_t _callback;
-    uint32_t _orig_arg{0};
-    // Callback encapsulated into lambda function with repeat counter etc.
-    callback_with_arg_t _cb_lambda{nullptr};
+    uintptr_t _orig_arg{0};
+    // Calls the original callback and does the repeat counting etc.
+    callback_with_arg_t _cb_trampoline{nullptr};
     bool _first_tick_nodelay{false};
     SemaphoreHandle_t _reentry_mutex = NULL;
 
-    esp_err_t _attach_ms(uint32_t arg) {
+    esp_err_t _attach_us(void *arg) {
         esp_timer_create_args_t _timerConfig;
-        _timerConfig.callback = _cb_lambda;
-        _timerConfig.arg = reinterpret_cast<void*>(arg);
+        _timerConfig.callback = _cb_trampoline;
+        _timerConfig.arg = arg;
         _timerConfig.dispatch_method = ESP_TIMER_TASK;
         _timerConfig.name = "MultiTimer";
+        _timerConfig.skip_unhandled_events = false;
         if (_timer) {
             esp_timer_stop(_timer);
             esp_timer_delete(_timer);
@@ -282,6 +277,47 @@ class MultiTimer : private Ticker
     inline void _mutex_give() {
         xSemaphoreGive(_reentry_mutex);
     }
+
+    // Counts the call and restarts the timer if more repeats are due.
+    // Returns the number of this call. Caller must hold the reentry lock.
+    inline uint32_t _count_repeat() {
+        auto repeat_count = ++_repeat_count;
+        if (repeat_count < _repeat_count_requested) {
+            esp_timer_start_once(_timer, _interval_us);
+        } else {
+            _repeat_count = 0;
+        }
+        return repeat_count;
+    }
+
+    // Timer callbacks, the type of the original callback is restored here
+    static void _on_timer(void *_this) {
+        auto self = static_cast<MultiTimer*>(_this);
+        self->_mutex_take();
+        self->_count_repeat();
+        self->_callback();
+        self->_mutex_give();
+    }
+
+    template <typename TArg>
+    static void _on_timer_with_arg(void *_this) {
+        auto self = static_cast<MultiTimer*>(_this);
+        self->_mutex_take();
+        self->_count_repeat();
+        auto cb = reinterpret_cast<void (*)(TArg)>(self->_callback);
+        cb((TArg)(self->_orig_arg));
+        self->_mutex_give();
+    }
+
+    template <typename TArg>
+    static void _on_timer_with_arg_and_count(void *_this) {
+        auto self = static_cast<MultiTimer*>(_this);
+        self->_mutex_take();
+        auto repeat_count = self->_count_repeat();
+        auto cb = reinterpret_cast<void (*)(TArg, uint32_t)>(self->_callback);
+        cb((TArg)(self->_orig_arg), repeat_count);
+        self->_mutex_give();
+    }
 };
 
 
@@ -326,27 +362,13 @@ class MultiTimerNonStatic : public MultiTimer
                                      mem_func_ptr_t mem_func_ptr,
                                      TClass *inst,
                                      bool first_tick_nodelay=false) {
-        _interval_ms = milliseconds;
+        _interval_us = milliseconds*1000ull;
         _repeat_count_requested = total_repeat_count;
         _mem_func_ptr = mem_func_ptr;
-        _orig_arg = reinterpret_cast<uint32_t>(inst);
+        _orig_arg = reinterpret_cast<uintptr_t>(inst);
         _first_tick_nodelay = first_tick_nodelay;
-        _cb_lambda = [](void *_this){
-            auto self = static_cast<decltype(this)>(_this);
-            self->_mutex_take();
-            auto repeat_count = ++self->_repeat_count;
-            if (repeat_count < self->_repeat_count_requested) {
-                esp_timer_start_once(self->_timer, self->_interval_ms*1000ull);
-            } else {
-                self->_repeat_count = 0;
-            }
-            auto inst = reinterpret_cast<TClass*>(self->_orig_arg);
-            //std::invoke(self->_mem_func_ptr, *inst);
-            auto mfp = self->_mem_func_ptr;
-            (inst->*mfp)();
-            self->_mutex_give();
-            };
-        return _attach_ms((uint32_t)this);
+        _cb_trampoline = _on_timer_mem_func;
+        return _attach_us(this);
     }
 
     esp_err_t attach_mem_func_ptr_ms(uint32_t milliseconds,
@@ -354,34 +376,39 @@ class MultiTimerNonStatic : public MultiTimer
                                      mem_func_ptr_with_count_t mem_func_ptr,
                                      TClass *inst,
                                      bool first_tick_nodelay=false) {                   
-        _interval_ms = milliseconds;
+        _interval_us = milliseconds*1000ull;
         _repeat_count_requested = total_repeat_count;
         _mem_func_ptr = reinterpret_cast<mem_func_ptr_t>(mem_func_ptr);
-        //_mem_func_ptr_with_count = mem_func_ptr;
-        _orig_arg = reinterpret_cast<uint32_t>(inst);
+        _orig_arg = reinterpret_cast<uintptr_t>(inst);
         _first_tick_nodelay = first_tick_nodelay;
-        _cb_lambda = [](void *_this){
-            auto self = static_cast<decltype(this)>(_this);
-            self->_mutex_take();
-            auto repeat_count = ++self->_repeat_count;
-            if (repeat_count < self->_repeat_count_requested) {
-                esp_timer_start_once(self->_timer, self->_interval_ms*1000ull);
-            } else {
-                self->_repeat_count = 0;
-            }
-            auto inst = reinterpret_cast<TClass*>(self->_orig_arg);
-            //std::invoke(self->_mem_func_ptr, *inst, self->_repeat_count);
-            auto mfp = reinterpret_cast<mem_func_ptr_with_count_t>(self->_mem_func_ptr);
-            //auto mfp = self->_mem_func_ptr_with_count;
-            (inst->*mfp)(repeat_count);
-            self->_mutex_give();
-            };
-        return _attach_ms((uint32_t)this);
+        _cb_trampoline = _on_timer_mem_func_with_count;
+        return _attach_us(this);
     }
 
 protected:
     mem_func_ptr_t _mem_func_ptr;
-    //mem_func_ptr_with_count_t _mem_func_ptr_with_count;
+
+    // See MultiTimer::_on_timer()
+    static void _on_timer_mem_func(void *_this) {
+        auto self = static_cast<MultiTimerNonStatic*>(_this);
+        self->_mutex_take();
+        self->_count_repeat();
+        auto inst = reinterpret_cast<TClass*>(self->_orig_arg);
+        //std::invoke(self->_mem_func_ptr, *inst);
+        auto mfp = self->_mem_func_ptr;
+        (inst->*mfp)();
+        self->_mutex_give();
+    }
+
+    static void _on_timer_mem_func_with_count(void *_this) {
+        auto self = static_cast<MultiTimerNonStatic*>(_this);
+        self->_mutex_take();
+        auto repeat_count = self->_count_repeat();
+        auto inst = reinterpret_cast<TClass*>(self->_orig_arg);
+        auto mfp = reinterpret_cast<mem_func_ptr_with_count_t>(self->_mem_func_ptr);
+        (inst->*mfp)(repeat_count);
+        self->_mutex_give();
+    }
 };
 
 
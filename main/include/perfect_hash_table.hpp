@@ -0,0 +1,215 @@
+/** @file perfect_hash_table.hpp
+ * @brief Compile-time perfect hash table for string keys
+ *
+ * License: GPL v.3
+ */
+#ifndef PERFECT_HASH_TABLE_HPP__
+#define PERFECT_HASH_TABLE_HPP__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+namespace PerfectHash {
+    // Power of two with at least two slots per entry, and at least four
+    // slots so that there are at least two buckets
+    constexpr size_t slots_for(size_t n_entries) {
+        auto n = size_t{4};
+        while (n < 2 * n_entries) {
+            n *= 2;
+        }
+        return n;
+    }
+
+    constexpr uint32_t log2(size_t power_of_two) {
+        auto bits = uint32_t{0};
+        while ((size_t{1} << bits) < power_of_two) {
+            ++bits;
+        }
+        return bits;
+    }
+}
+
+/** @brief Compile-time perfect hash table for string keys
+ *
+ * The table is built from a fixed list of entries in a constexpr context,
+ * i.e. there is no registration at runtime and it can live in flash.
+ *
+ * Keys are hashed into buckets of about one key each. For every bucket, a
+ * displacement is searched for which moves all its keys into free slots
+ * ("hash and displace"), starting with the largest buckets. A single seed
+ * mapping all keys into different slots would only be found for small
+ * tables, as the chance falls exponentially with the number of keys.
+ * A lookup costs hashing the key plus one string comparison, independent
+ * of the number of entries.
+ *
+ * Declare the table constexpr and check is_valid() using static_assert,
+ * which fails at compile time for duplicate keys.
+ *
+ * @param TEntry: Entry type with a "const char *name" member as the key
+ * @param n_entries: Number of entries, less than 255.
+ *                   Keys must be shorter than 256 characters.
+ */
+template<typename TEntry, size_t n_entries>
+class PerfectHashTable
+{
+public:
+    static_assert(n_entries > 0 && n_entries < 255, "Unsupported number of entries");
+    static constexpr size_t n_slots = PerfectHash::slots_for(n_entries);
+    static constexpr size_t n_buckets = n_slots / 2;
+    // A seed is only rejected if two keys of a bucket have the same hash,
+    // or for very unlucky bucket sizes
+    static constexpr uint32_t max_seed = 100;
+
+    constexpr explicit PerfectHashTable(const std::array<TEntry, n_entries> &entries)
+        : _entries{entries}
+    {
+        for (size_t i = 0; i < n_entries; ++i) {
+            auto len = size_t{0};
+            while (_entries[i].name[len]) {
+                ++len;
+            }
+            _key_lens[i] = static_cast<uint8_t>(len);
+        }
+        if (_has_duplicate_keys()) {
+            return;
+        }
+        for (auto seed = uint32_t{1}; seed <= max_seed; ++seed) {
+            if (_try_seed(seed)) {
+                _seed = seed;
+                return;
+            }
+        }
+    }
+
+    /** @brief True if all keys are unique and the table was built
+     */
+    constexpr bool is_valid() const {return _seed != 0;}
+
+    /** @brief Entry with the given key, which needs not be null-terminated
+     *
+     * @return nullptr if not found
+     */
+    const TEntry *find(const char *key, size_t key_len) const {
+        const auto h = hash(_seed, key, key_len);
+        const auto slot = _slots[_slot_index(h, _displacements[_bucket_index(h)])];
+        if (slot == 0 || _key_lens[slot - 1] != key_len) {
+            return nullptr;
+        }
+        const auto &entry = _entries[slot - 1];
+        return std::memcmp(entry.name, key, key_len) == 0 ? &entry : nullptr;
+    }
+
+    constexpr const std::array<TEntry, n_entries> &entries() const {return _entries;}
+
+    /** @brief Bernstein hash (djb2a) with the initial value set by seed.
+     *
+     * This needs only shifts and adds per character, the result is spread
+     * by _bucket_index() and _slot_index()
+     */
+    static constexpr uint32_t hash(uint32_t seed, const char *key, size_t key_len) {
+        auto h = uint32_t{5381} + seed;
+        for (size_t i = 0; i < key_len; ++i) {
+            h = ((h << 5) + h) ^ static_cast<uint8_t>(key[i]);
+        }
+        return h;
+    }
+
+private:
+    static constexpr uint32_t _slot_bits = PerfectHash::log2(n_slots);
+    static constexpr uint32_t _bucket_bits = PerfectHash::log2(n_buckets);
+    static constexpr uint32_t max_displacement = 255;
+
+    std::array<TEntry, n_entries> _entries;
+    std::array<uint8_t, n_entries> _key_lens{};
+    // Entry index plus one, zero for empty slots
+    std::array<uint8_t, n_slots> _slots{};
+    std::array<uint8_t, n_buckets> _displacements{};
+    uint32_t _seed = 0;
+
+    // Fibonacci hashing, i.e. the upper bits of the product are used.
+    // Bucket and slot use different multipliers, so that the keys of one
+    // bucket are spread over the slots.
+    static constexpr size_t _bucket_index(uint32_t h) {
+        return (h * 2654435769u) >> (32 - _bucket_bits);
+    }
+
+    static constexpr size_t _slot_index(uint32_t h, uint8_t displacement) {
+        return ((h ^ (displacement * 0x9e3779b9u)) * 0x85ebca6bu) >> (32 - _slot_bits);
+    }
+
+    constexpr bool _has_duplicate_keys() const {
+        for (size_t i = 0; i < n_entries; ++i) {
+            for (size_t j = i + 1; j < n_entries; ++j) {
+                if (_key_lens[i] != _key_lens[j]) {
+                    continue;
+                }
+                auto k = size_t{0};
+                while (k < _key_lens[i] && _entries[i].name[k] == _entries[j].name[k]) {
+                    ++k;
+                }
+                if (k == _key_lens[i]) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    constexpr bool _try_seed(uint32_t seed) {
+        auto hashes = std::array<uint32_t, n_entries>{};
+        auto bucket_sizes = std::array<uint8_t, n_buckets>{};
+        auto max_bucket_size = size_t{0};
+        for (size_t i = 0; i < n_entries; ++i) {
+            hashes[i] = hash(seed, _entries[i].name, _key_lens[i]);
+            auto &size = bucket_sizes[_bucket_index(hashes[i])];
+            ++size;
+            max_bucket_size = size > max_bucket_size ? size : max_bucket_size;
+        }
+        _slots = std::array<uint8_t, n_slots>{};
+        _displacements = std::array<uint8_t, n_buckets>{};
+        // Largest buckets first, while most slots are still free
+        for (auto size = max_bucket_size; size > 0; --size) {
+            for (size_t bucket = 0; bucket < n_buckets; ++bucket) {
+                if (bucket_sizes[bucket] == size && !_place_bucket(bucket, hashes)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Finds a displacement for which all keys of the bucket go to free slots
+    constexpr bool _place_bucket(size_t bucket, const std::array<uint32_t, n_entries> &hashes) {
+        for (auto d = uint32_t{0}; d <= max_displacement; ++d) {
+            const auto displacement = static_cast<uint8_t>(d);
+            auto is_free = true;
+            for (size_t i = 0; i < n_entries && is_free; ++i) {
+                if (_bucket_index(hashes[i]) != bucket) {
+                    continue;
+                }
+                auto &slot = _slots[_slot_index(hashes[i], displacement)];
+                if (slot == 0) {
+                    slot = static_cast<uint8_t>(i + 1);
+                } else {
+                    is_free = false;
+                }
+            }
+            if (is_free) {
+                _displacements[bucket] = displacement;
+                return true;
+            }
+            // Undo, also the slots of this bucket must be free again
+            for (auto &slot : _slots) {
+                if (slot && _bucket_index(hashes[slot - 1]) == bucket) {
+                    slot = 0;
+                }
+            }
+        }
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,79 @@
+/** @file push_scheduler.hpp
+ * @brief Rate limiter for push updates with trailing-edge flush
+ *
+ * License: GPL v.3
+ */
+#ifndef PUSH_SCHEDULER_HPP__
+#define PUSH_SCHEDULER_HPP__
+
+#include <cstdint>
+
+
+/** @brief Rate limiter for push updates with trailing-edge flush
+ *
+ * Any number of push requests within the minimum interval are collapsed
+ * into one single push. A push requested within the minimum interval after
+ * the last one is not dropped but delayed until the interval has expired
+ * (trailing edge), so the last state change always reaches the clients.
+ *
+ * This is not thread-safe, it is meant to be used from the application task
+ * only. Time values are based on esp_timer_get_time().
+ */
+class PushScheduler
+{
+public:
+    /** Returned by get_next_due_time() when no push is pending */
+    static constexpr int64_t none_pending = -1;
+
+    explicit PushScheduler(int64_t min_interval_us)
+        : _min_interval_us{min_interval_us}
+    {}
+
+    /** @brief Request a push. Requests already pending are merged.
+     */
+    void request() {
+        if (_pending) {
+            ++_suppressed_count;
+        }
+        _pending = true;
+    }
+
+    /** @brief Returns true if a push is pending and due at time now_us.
+     *
+     * If so, the caller must do the push and the request is cleared.
+     */
+    bool poll(int64_t now_us) {
+        if (!_pending || now_us - _last_push_us < _min_interval_us) {
+            return false;
+        }
+        mark_pushed(now_us);
+        return true;
+    }
+
+    /** @brief Notify that a push was done bypassing the scheduler.
+     * This also clears any pending request.
+     */
+    void mark_pushed(int64_t now_us) {
+        _pending = false;
+        _last_push_us = now_us;
+    }
+
+    /** @brief Time when the pending push is due or none_pending.
+     */
+    int64_t get_next_due_time() const {
+        return _pending ? _last_push_us + _min_interval_us : none_pending;
+    }
+
+    /** @brief Number of requests which were merged into a pending push
+     * since startup
+     */
+    uint32_t get_suppressed_count() const {return _suppressed_count;}
+
+private:
+    const int64_t _min_interval_us;
+    int64_t _last_push_us = INT64_MIN / 2;
+    uint32_t _suppressed_count = 0;
+    bool _pending = false;
+};
+
+#endif
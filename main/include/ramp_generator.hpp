@@ -0,0 +1,238 @@
+/** @file ramp_generator.hpp
+ * @brief Setpoint ramp generator with linear, S-curve and exponential profiles
+ *
+ * Each RampAxis moves one output value (e.g. the PWM frequency) towards its
+ * target value in small steps. The RampGenerator runs all axes clocked by
+ * one high-rate esp_timer which is only active while any ramp is in progress.
+ *
+ * The RampAxis step calculation has no hardware or RTOS dependencies, so
+ * it can be run on a host using a stand-in for the output function.
+ *
+ * License: GPL v.3
+ */
+#ifndef RAMP_GENERATOR_HPP__
+#define RAMP_GENERATOR_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+
+#include "esp_timer.h"
+#include "esp_err.h"
+
+
+enum class RampProfile : uint8_t {
+    // Constant rate of change until target is reached
+    linear = 0,
+    // Like linear, but with limited acceleration and jerk. Two cascaded
+    // moving average filters make the rate of change itself a smooth curve.
+    s_curve = 1,
+    // First-order lag towards target, but never faster than linear
+    exponential = 2,
+    _count
+};
+
+
+/** @brief One ramped output value. Not thread-safe, see RampGenerator.
+ */
+class RampAxis
+{
+public:
+    /** Maximum length of each of the two S-curve moving average filters */
+    static constexpr size_t max_filter_len = 64;
+
+    /** Output function, called for each changed output value */
+    using output_fn_t = void (*)(float value, void *arg);
+
+    RampAxis(output_fn_t output_fn, void *arg)
+        : _output_fn{output_fn}
+        , _arg{arg}
+    {}
+
+    /** @brief Set the ramp profile and its parameters.
+     *
+     * @param profile: See enum RampProfile
+     * @param s_curve_filter_len: Number of steps of each moving average
+     *        filter for the S-curve profile (1...max_filter_len). Sum of both
+     *        is the time needed to reach the full rate of change.
+     * @param exp_time_constant_steps: Time constant for the exponential
+     *        profile in steps
+     */
+    void configure(RampProfile profile,
+                   size_t s_curve_filter_len,
+                   float exp_time_constant_steps);
+
+    /** @brief Maximum change of the value per step.
+     * Zero (or less) means no limit, i.e. the output jumps to the target
+     * on the next step for all profiles.
+     */
+    void set_rate(float rate_per_step) {_rate = rate_per_step;}
+
+    /** @brief Set new target value. The ramp starts on the next step().
+     */
+    void set_target(float target) {_target = target;}
+
+    /** @brief Set output and target to value without ramping.
+     * The output function is called if call_output is true.
+     */
+    void jump_to(float value, bool call_output = true);
+
+    /** @brief Calculate and output the next value.
+     * @return true if the output value changed.
+     */
+    bool step();
+
+    float get_output() const {return _output;}
+    float get_target() const {return _target;}
+    bool is_settled() const {return _output == _target && _position == _target;}
+
+private:
+    // Moving average of the last "len" values. Returns the input value
+    // itself once all values in the window are equal, so that the result
+    // exactly settles on the target without any rounding error.
+    class MovingAverage {
+    public:
+        void reset(float value, size_t len);
+        float push(float value);
+    private:
+        std::array<float, max_filter_len> _buf{};
+        size_t _len = 1;
+        size_t _index = 0;
+        size_t _n_equal = 0;
+    };
+
+    output_fn_t _output_fn;
+    void *_arg;
+    RampProfile _profile = RampProfile::linear;
+    float _rate = 0.0f;
+    float _exp_factor = 1.0f;
+    size_t _filter_len = 1;
+    // Linear ramp value, this is the input for the S-curve filters
+    float _position = 0.0f;
+    float _target = 0.0f;
+    float _output = 0.0f;
+    MovingAverage _filter_1;
+    MovingAverage _filter_2;
+
+    float _step_linear(float from) const;
+};
+
+
+/** @brief Runs up to max_axes RampAxis objects clocked by one esp_timer.
+ *
+ * The timer is started when a ramp begins and is stopped when all axes have
+ * settled. It is dispatched from the esp_timer ISR and only calls the wake
+ * function passed to begin(). This must wake up the task owning the
+ * hardware, which then does the steps by calling run_due(). So the output
+ * functions are called from that task.
+ *
+ * The number of steps due is determined from the elapsed time, so a delayed
+ * wake-up is detected. Steps not done in time are counted as missed. With
+ * catch-up enabled, these steps are done late instead, i.e. the ramp keeps
+ * its configured rate of change on average.
+ *
+ * This class is not thread-safe: All methods, as well as any access to the
+ * RampAxis objects, must be done from the task which calls run_due().
+ */
+class RampGenerator
+{
+public:
+    static constexpr size_t max_axes = 4;
+
+    /** Wake function, called from the esp_timer ISR for each step */
+    using wake_fn_t = void (*)(void *arg);
+    /** Called from run_due() when all ramps have finished */
+    using finished_fn_t = void (*)(void *arg);
+
+    RampGenerator() = default;
+    ~RampGenerator();
+
+    /** @brief Create the timer. To be called once on startup.
+     *
+     * The timer uses ISR dispatch, i.e. the project sdkconfig must have
+     * CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD set.
+     *
+     * @param step_interval_us: Timer period, i.e. time for one ramp step
+     * @param wake_fn: Called from the esp_timer ISR, must be IRAM_ATTR
+     *                 and only call ISR-safe functions, e.g. xTaskNotifyFromISR()
+     * @param wake_fn_arg: Passed to wake_fn
+     * @param finished_fn: Optional callback, called when all ramps finished
+     */
+    esp_err_t begin(uint32_t step_interval_us,
+                    wake_fn_t wake_fn, void *wake_fn_arg,
+                    finished_fn_t finished_fn = nullptr, void *arg = nullptr);
+
+    /** @brief When enabled, up to max_steps missed steps are done in one
+     * call of run_due(). Any more are dropped.
+     */
+    void set_catch_up(bool enabled, uint32_t max_steps) {
+        _catch_up_max_steps = enabled ? max_steps : 1;
+    }
+
+    /** @brief Add an axis. Must be called before any ramp is started.
+     * @return ESP_ERR_NO_MEM if more than max_axes are added
+     */
+    esp_err_t add_axis(RampAxis &axis);
+
+    /** @brief Set the profile for all axes
+     *
+     * @param s_curve_time_us: Total time of both S-curve filters
+     * @param exp_time_constant_us: Time constant for the exponential profile
+     */
+    void configure(RampProfile profile,
+                   uint32_t s_curve_time_us,
+                   uint32_t exp_time_constant_us);
+
+    /** @brief Set maximum rate of change of axis in units per second
+     */
+    void set_rate(RampAxis &axis, float rate_per_sec);
+
+    /** @brief Start ramping axis towards a new target value
+     */
+    void set_target(RampAxis &axis, float target);
+
+    /** @brief Set axis to a new value immediately, stopping any ramp
+     */
+    void jump_to(RampAxis &axis, float value);
+
+    /** @brief Do all steps due at time "now_us" and stop the timer when
+     * all axes have settled.
+     *
+     * To be called by the task woken by the wake function, with
+     * esp_timer_get_time() as the argument. Can also be driven using a
+     * simulated clock.
+     */
+    void run_due(int64_t now_us);
+
+    /** @brief True while any ramp is in progress
+     */
+    bool is_active() const {return _active;}
+
+    /** @brief Number of steps which were not done since startup
+     */
+    uint32_t get_missed_steps() const {return _missed_steps;}
+    /** @brief Number of steps which were done late by catching up
+     */
+    uint32_t get_caught_up_steps() const {return _caught_up_steps;}
+
+private:
+    std::array<RampAxis*, max_axes> _axes{};
+    esp_timer_handle_t _timer = nullptr;
+    uint32_t _step_interval_us = 1000;
+    wake_fn_t _wake_fn = nullptr;
+    void *_wake_fn_arg = nullptr;
+    finished_fn_t _finished_fn = nullptr;
+    void *_finished_fn_arg = nullptr;
+    volatile bool _active = false;
+    // Time of the last step as scheduled, for determining the steps due
+    int64_t _last_step_us = 0;
+    uint32_t _catch_up_max_steps = 1;
+    uint32_t _missed_steps = 0;
+    uint32_t _caught_up_steps = 0;
+
+    void _start_timer();
+
+    static void _on_timer(void *arg);
+};
+
+#endif
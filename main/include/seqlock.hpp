@@ -0,0 +1,73 @@
+/** @file seqlock.hpp
+ * @brief Sequence lock for publishing consistent copies of a data structure
+ *
+ * License: GPL v.3
+ */
+#ifndef SEQLOCK_HPP__
+#define SEQLOCK_HPP__
+
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+#include "freertos/FreeRTOS.h"
+
+
+/** @brief Sequence lock for publishing consistent copies of a data structure
+ * from one writer task to any number of reader tasks.
+ *
+ * The writer never waits for the readers. Readers never block the writer,
+ * they retry the copy should the writer have been active meanwhile.
+ *
+ * The write is done in a critical section, so the writer can not be
+ * preempted by a reader running on the same CPU core, which would otherwise
+ * spin forever. For this reason, T should be a small structure which can be
+ * copied in well below a microsecond.
+ */
+template<typename T>
+class SeqLock
+{
+public:
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "SeqLock data type must be trivially copyable");
+
+    /** @brief Publish a new value. Only one writer task is allowed.
+     */
+    void write(const T &value) {
+        portENTER_CRITICAL(&_write_lock);
+        auto seq = _seq.load(std::memory_order_relaxed);
+        // Odd sequence number signals a write in progress
+        _seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&_data, &value, sizeof(T));
+        _seq.store(seq + 2, std::memory_order_release);
+        portEXIT_CRITICAL(&_write_lock);
+    }
+
+    /** @brief Get a consistent copy of the last published value.
+     */
+    T read() const {
+        T value;
+        uint32_t seq_before, seq_after;
+        do {
+            seq_before = _seq.load(std::memory_order_acquire);
+            std::memcpy(&value, &_data, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            seq_after = _seq.load(std::memory_order_relaxed);
+        } while ((seq_before & 1u) || seq_before != seq_after);
+        return value;
+    }
+
+    /** @brief Sequence number, incremented by two for each write()
+     */
+    uint32_t get_sequence() const {
+        return _seq.load(std::memory_order_acquire);
+    }
+
+private:
+    std::atomic<uint32_t> _seq{0};
+    T _data{};
+    portMUX_TYPE _write_lock = portMUX_INITIALIZER_UNLOCKED;
+};
+
+#endif
@@ -0,0 +1,113 @@
+/** @file setpoint_sequencer.hpp
+ * @brief On-device sequencer for scripted setpoint sweeps
+ *
+ * License: GPL v.3
+ */
+#ifndef SETPOINT_SEQUENCER_HPP__
+#define SETPOINT_SEQUENCER_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+
+#include "ArduinoJson.h"
+
+#include "timed_sequence.hpp"
+
+
+/** @brief One step of a setpoint sequence.
+ *
+ * Setpoints are in the units of the /cmd API, i.e. kHz, % and ns, as they
+ * are applied through the same setters. Setpoints which are NAN (or -1 for
+ * output_enabled) are left unchanged by the step.
+ */
+struct SequencerStep
+{
+    // Time until the next step is applied
+    uint32_t duration_us;
+    float frequency_khz;
+    float duty_percent;
+    float lead_dt_ns;
+    float lag_dt_ns;
+    // 1: Output on, 0: Output off, -1: Unchanged
+    int8_t output_enabled;
+};
+
+
+/** @brief Runs a table of setpoint steps with deterministic timing.
+ *
+ * The step table is uploaded as JSON, see load_from_json(). The sequence is
+ * run by the common SequenceRunner, i.e. each step is applied from the task
+ * calling SequenceRunner::run_due(). Step times are relative to the scheduled
+ * and not to the actual time of the previous step, so there is no accumulated
+ * timing error.
+ */
+class SetpointSequencer
+{
+public:
+    static constexpr size_t max_steps = 64;
+
+    /** Called from the SequenceRunner::run_due() task for each step */
+    using apply_fn_t = void (*)(const SequencerStep &step, void *arg);
+
+    SetpointSequencer(SequenceRunner &runner, apply_fn_t apply_fn, void *arg)
+        : _runner{runner}
+        , _apply_fn{apply_fn}
+        , _arg{arg}
+    {}
+
+    /** @brief Replace the step table from a JSON array of objects like:
+     *
+     * [{"duration": 0.5, "frequency": 100.0, "duty": 20.0,
+     *   "lead_dt": 125, "lag_dt": 125, "output": true}, ...]
+     *
+     * Units are seconds, kHz, %, ns, as for the /cmd API. All keys except
+     * "duration" are optional, missing values are left unchanged.
+     * Step durations must be 100 us...1 h.
+     *
+     * @return ESP_ERR_INVALID_ARG if the table is invalid or too long,
+     *         ESP_ERR_INVALID_STATE if the sequencer is running.
+     */
+    esp_err_t load_from_json(JsonArrayConst steps);
+
+    /** @brief Start running from the first step.
+     * @return ESP_ERR_INVALID_STATE if there are no steps loaded
+     */
+    esp_err_t start();
+
+    void stop();
+
+    /** @brief When true, the sequence restarts after the last step
+     */
+    void set_loop(bool loop) {_loop = loop;}
+    bool get_loop() const {return _loop;}
+
+    bool is_active() const {return _seq.is_active();}
+    size_t get_n_steps() const {return _n_steps;}
+    /** @brief Index of the step currently applied */
+    size_t get_step_index() const {return _step_index;}
+    /** @brief Number of completed passes through the table since start */
+    uint32_t get_pass_count() const {return _pass_count;}
+
+private:
+    SequenceRunner &_runner;
+    apply_fn_t _apply_fn;
+    void *_arg;
+    std::array<SequencerStep, max_steps> _steps{};
+    size_t _n_steps = 0;
+    size_t _step_index = 0;
+    uint32_t _pass_count = 0;
+    volatile bool _loop = false;
+    // Set while the table is written, prevents start()
+    bool _loading = false;
+    portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+
+    TimedSequence _seq{
+        [](TimedSequence &seq, void *self) {
+            return static_cast<SetpointSequencer*>(self)->_run(seq);},
+        this};
+
+    int64_t _run(TimedSequence &seq);
+};
+
+#endif
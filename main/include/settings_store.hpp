@@ -0,0 +1,92 @@
+/** @file settings_store.hpp
+ * @brief Write-behind persistence of the runtime settings
+ *
+ * License: GPL v.3
+ */
+#ifndef SETTINGS_STORE_HPP__
+#define SETTINGS_STORE_HPP__
+
+#include <array>
+#include <cstdint>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+
+#include "app_state_model.hpp"
+
+
+/** @brief Write-behind persistence of the runtime settings in NVS
+ *
+ * Save requests only copy the settings and wake a low-priority worker task,
+ * so the requesting task is never blocked by a flash write or erase.
+ *
+ * The worker writes the settings when the delay of the last request has
+ * expired, i.e. requests in quick succession result in one write. Before
+ * writing, the settings blob is compared with the stored one, and the write
+ * is skipped when nothing has changed. This avoids needless flash wear.
+ *
+ * Writes are atomic as NVS keeps the previous blob until the new one has
+ * been written completely.
+ *
+ * For testing without a task, request_save(), take_due() and store() can
+ * be called directly with a simulated time.
+ */
+class SettingsStore
+{
+public:
+    SettingsStore() = default;
+
+    /** @brief Read the stored settings for comparison and create the
+     * worker task.
+     */
+    esp_err_t begin(uint32_t stack_size, UBaseType_t priority, BaseType_t core_id);
+
+    /** @brief Request saving settings delay_ms after now_us.
+     *
+     * A later request replaces the settings of a pending one and restarts
+     * the delay. An autosave request does however not postpone a pending
+     * explicit save.
+     *
+     * Safe to call from any task.
+     */
+    void request_save(const AppStateSnapshot &settings, int64_t now_us,
+                      uint32_t delay_ms, bool is_autosave = false);
+
+    /** @brief Take the pending settings if their delay has expired,
+     * called by the worker task.
+     *
+     * @param wait_us: Time until the pending request is due,
+     *                 -1 if there is no pending request
+     * @return false if no request is due
+     */
+    bool take_due(int64_t now_us, AppStateSnapshot *settings, int64_t *wait_us);
+
+    /** @brief Write settings to NVS unless they equal the stored ones.
+     *
+     * @return true if the settings were written
+     */
+    bool store(const AppStateSnapshot &settings);
+
+    // Number of writes done and skipped as unchanged, for diagnostics
+    uint32_t get_writes() const {return _writes;}
+    uint32_t get_writes_skipped() const {return _writes_skipped;}
+
+private:
+    TaskHandle_t _task_handle = nullptr;
+    // Pending request, guarded by _lock
+    AppStateSnapshot _pending_settings{};
+    int64_t _due_time_us = 0;
+    bool _pending = false;
+    bool _explicit_pending = false;
+    portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+    // Copy of the stored blob, only accessed by the worker task
+    std::array<uint8_t, AppState::settings_blob_len> _stored_blob{};
+    size_t _stored_blob_len = 0;
+    uint32_t _writes = 0;
+    uint32_t _writes_skipped = 0;
+
+    static void _task(void *pVParameters);
+};
+
+#endif
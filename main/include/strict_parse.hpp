@@ -0,0 +1,162 @@
+/** @file strict_parse.hpp
+ * @brief Strict conversion of text into numbers and booleans
+ *
+ * License: GPL v.3
+ */
+#ifndef STRICT_PARSE_HPP__
+#define STRICT_PARSE_HPP__
+
+#include <cstdint>
+#include <climits>
+#include <cmath>
+#include <string_view>
+
+
+/** @brief Strict conversion of text into numbers and booleans, in the
+ * manner of std::from_chars().
+ *
+ * Unlike atof(), String::toFloat() etc., the complete text must be a valid
+ * number. Empty text, surrounding whitespace, trailing characters and
+ * out-of-range values are rejected instead of giving zero or a clipped value.
+ *
+ * Nothing is allocated and the text needs not be null-terminated.
+ * The output value is only written on success.
+ */
+namespace StrictParse {
+    /** @brief "true" or "false"
+     */
+    inline bool to_bool(std::string_view text, bool *value) {
+        if (text == "true") {
+            *value = true;
+            return true;
+        }
+        if (text == "false") {
+            *value = false;
+            return true;
+        }
+        return false;
+    }
+
+    /** @brief Decimal integer with optional sign, e.g. "-12"
+     */
+    inline bool to_int(std::string_view text, int *value) {
+        auto pos = size_t{0};
+        auto is_negative = false;
+        if (pos < text.size() && (text[pos] == '-' || text[pos] == '+')) {
+            is_negative = text[pos++] == '-';
+        }
+        if (pos == text.size()) {
+            return false;
+        }
+        // Magnitude limit of the result, INT_MIN has one more
+        const auto limit = uint32_t{INT_MAX} + (is_negative ? 1 : 0);
+        auto magnitude = uint32_t{0};
+        for (; pos < text.size(); ++pos) {
+            const auto digit = static_cast<uint32_t>(text[pos] - '0');
+            if (digit > 9 || magnitude > (limit - digit) / 10) {
+                return false;
+            }
+            magnitude = magnitude * 10 + digit;
+        }
+        *value = is_negative ? static_cast<int>(0u - magnitude)
+                             : static_cast<int>(magnitude);
+        return true;
+    }
+
+    /** @brief Decimal number with optional sign, fractional part and
+     * exponent, e.g. "-12", "0.25", ".5", "1e-7", "2.5E3".
+     *
+     * Infinity, NaN and hexadecimal notation are not accepted. Values too large
+ * for a float, and non-zero values so small that they would become zero,
+ * are rejected.
+     *
+     * Conversion uses single-precision arithmetic only, as the ESP32 FPU
+     * has no double support. With up to seven significant digits and
+     * decimal exponents up to ±10, the result is correctly rounded.
+     * Otherwise, it can differ by a few units in the last place.
+     */
+    inline bool to_float(std::string_view text, float *value) {
+        // Up to 19 significant digits fit into the integer mantissa,
+        // further digits only change the decimal exponent.
+        static constexpr int max_digits = 19;
+        static constexpr int max_exponent = 38;
+        auto pos = size_t{0};
+        auto is_negative = false;
+        if (pos < text.size() && (text[pos] == '-' || text[pos] == '+')) {
+            is_negative = text[pos++] == '-';
+        }
+        auto mantissa = uint64_t{0};
+        auto n_mantissa_digits = 0;
+        auto n_digits = 0;
+        auto exponent = 0;
+        auto is_fraction = false;
+        for (; pos < text.size(); ++pos) {
+            const auto c = text[pos];
+            if (c == '.' && !is_fraction) {
+                is_fraction = true;
+                continue;
+            }
+            const auto digit = static_cast<unsigned>(c - '0');
+            if (digit > 9) {
+                break;
+            }
+            ++n_digits;
+            // Leading zeros are not significant
+            if (n_mantissa_digits < max_digits && (mantissa || digit)) {
+                mantissa = mantissa * 10 + digit;
+                ++n_mantissa_digits;
+                exponent -= is_fraction;
+            } else if (mantissa) {
+                exponent += !is_fraction;
+            } else {
+                exponent -= is_fraction;
+            }
+        }
+        if (n_digits == 0) {
+            return false;
+        }
+        if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+            auto exponent_value = 0;
+            if (!to_int(text.substr(pos + 1), &exponent_value)
+                    || exponent_value > 1000 || exponent_value < -1000) {
+                return false;
+            }
+            exponent += exponent_value;
+            pos = text.size();
+        }
+        if (pos != text.size()) {
+            return false;
+        }
+        if (mantissa == 0) {
+            *value = is_negative ? -0.0f : 0.0f;
+            return true;
+        }
+        // Normalized to one integer digit, for the range check
+        const auto normalized_exponent = exponent + n_mantissa_digits - 1;
+        if (normalized_exponent > max_exponent) {
+            return false;
+        }
+        // Powers of ten up to 1e10 are exact in single precision
+        static constexpr float powers_of_ten[] = {
+            1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+        auto result = static_cast<float>(mantissa);
+        while (exponent > 0) {
+            const auto step = exponent > 10 ? 10 : exponent;
+            result *= powers_of_ten[step];
+            exponent -= step;
+        }
+        while (exponent < 0) {
+            const auto step = exponent < -10 ? 10 : -exponent;
+            result /= powers_of_ten[step];
+            exponent += step;
+        }
+        // Overflow, or underflow of a non-zero value
+        if (!std::isfinite(result) || result == 0.0f) {
+            return false;
+        }
+        *value = is_negative ? -result : result;
+        return true;
+    }
+}
+
+#endif
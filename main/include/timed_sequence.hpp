@@ -0,0 +1,184 @@
+/** @file timed_sequence.hpp
+ * @brief Resumable multi-step hardware sequences timed by one common esp_timer
+ *
+ * A sequence is written as a single function containing the complete
+ * sequence of actions and delays, e.g.:
+ *
+ * @code
+ * int64_t AppController::_oc_reset_sequence(TimedSequence &seq) {
+ *     SEQ_BEGIN(seq);
+ *     aux_hw_drv.reset_oc_shutdown_start();
+ *     SEQ_DELAY_MS(seq, 20);
+ *     aux_hw_drv.reset_oc_shutdown_finish();
+ *     SEQ_END(seq);
+ * }
+ * @endcode
+ *
+ * On each delay, the function returns to the SequenceRunner and is resumed
+ * at the same position when the delay has expired. This is a stackless
+ * design (like C++20 coroutines, which the current xtensa toolchain does
+ * not support yet): There is no stack or heap allocation per sequence and
+ * all sequences share one single esp_timer instance.
+ *
+ * The esp_timer only wakes up the task owning the hardware, which then runs
+ * the steps by calling SequenceRunner::run_due(). So delays are timed with
+ * microsecond resolution, but the steps are delayed by the wake-up latency
+ * of that task: Some 10 µs when it is the highest-priority ready task on
+ * its core, up to the run time of any higher-priority task otherwise.
+ *
+ * ==> Because the step function returns on each delay, local variables do
+ *     /not/ keep their values across delays. Use class members instead.
+ *     Also, the resume position is identified by the source line number,
+ *     so there must not be more than one SEQ_DELAY_xx() per line.
+ *
+ * License: GPL v.3
+ */
+#ifndef TIMED_SEQUENCE_HPP__
+#define TIMED_SEQUENCE_HPP__
+
+#include <cstddef>
+#include <array>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_err.h"
+
+/** Must be the first statement in a sequence step function
+ */
+#define SEQ_BEGIN(seq) switch ((seq).resume_point) { case 0:
+/** Return to the SequenceRunner and resume here after delay_us microseconds
+ */
+#define SEQ_DELAY_US(seq, delay_us) \
+    do { \
+        (seq).resume_point = __LINE__; \
+        return static_cast<int64_t>(delay_us); \
+        case __LINE__:; \
+    } while (0)
+/** Return to the SequenceRunner and resume here after delay_ms milliseconds
+ */
+#define SEQ_DELAY_MS(seq, delay_ms) SEQ_DELAY_US(seq, (delay_ms) * 1000ll)
+/** Must be the last statement in a sequence step function
+ */
+#define SEQ_END(seq) } (seq).resume_point = 0; return TimedSequence::finished
+
+
+/** @brief State of one resumable sequence, see file description.
+ *
+ * Objects of this class are usually members of the class implementing the
+ * step function, so that no dynamic allocation is needed.
+ */
+class TimedSequence
+{
+public:
+    /** Returned by the step function when the sequence has finished */
+    static constexpr int64_t finished = -1;
+
+    /** Step function. Returns the delay in microseconds until the next
+     * invocation, or TimedSequence::finished.
+     */
+    using step_fn_t = int64_t (*)(TimedSequence &seq, void *arg);
+
+    /** @param step_fn: Free function, static member or non-capturing lambda
+     * @param arg: Passed to step_fn, usually the calling class instance
+     */
+    TimedSequence(step_fn_t step_fn, void *arg)
+        : _step_fn{step_fn}
+        , _arg{arg}
+    {}
+
+    /** True from SequenceRunner::start() until the sequence has finished
+     * or was stopped.
+     */
+    bool is_active() const {return _active;}
+
+    // Position in the step function where execution is resumed.
+    // Only to be used by the SEQ_xxx macros.
+    uint32_t resume_point = 0;
+
+private:
+    friend class SequenceRunner;
+    step_fn_t _step_fn;
+    void *_arg;
+    // Absolute time for the next step, based on esp_timer_get_time()
+    int64_t _wake_time_us = 0;
+    // Incremented by SequenceRunner::start(), detects restarts during a step
+    uint32_t _start_count = 0;
+    volatile bool _active = false;
+};
+
+
+/** @brief Runs any number of TimedSequence objects (up to max_sequences)
+ * using one common esp_timer.
+ *
+ * The timer is dispatched from the esp_timer ISR and only calls the wake
+ * function passed to begin(). This must wake up the task which then calls
+ * run_due(), i.e. the step functions are run by that task.
+ *
+ * start() and stop() can be called from any task, also from a step
+ * function. A sequence restarted while its step function is running is
+ * resumed from the beginning, the result of the running step is dropped.
+ *
+ * Delays are added to the scheduled and not to the actual wake-up time,
+ * so timing errors do not sum up over the steps of a sequence.
+ */
+class SequenceRunner
+{
+public:
+    static constexpr size_t max_sequences = 8;
+
+    /** Wake function, called from the esp_timer ISR when steps are due */
+    using wake_fn_t = void (*)(void *arg);
+
+    SequenceRunner() = default;
+    ~SequenceRunner();
+
+    /** @brief Create the esp_timer. To be called once on startup.
+     *
+     * The timer uses ISR dispatch, i.e. the project sdkconfig must have
+     * CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD set.
+     *
+     * @param wake_fn: Called from the esp_timer ISR, must be IRAM_ATTR and
+     *                 only call ISR-safe functions, e.g. xTaskNotifyFromISR()
+     * @param arg: Passed to wake_fn
+     */
+    esp_err_t begin(wake_fn_t wake_fn, void *arg);
+
+    /** @brief Start a sequence. The first step is run as soon as possible.
+     *
+     * If the sequence is already active, it is restarted from the beginning.
+     * This does not log, so it may be called from a critical section.
+     *
+     * @return ESP_ERR_NO_MEM if more than max_sequences are active.
+     */
+    esp_err_t start(TimedSequence &seq);
+
+    /** @brief Stop a sequence. It is not resumed until started again.
+     */
+    void stop(TimedSequence &seq);
+
+    /** @brief Run all sequence steps which are due at time "now_us",
+     * then re-arm the timer for the next due step.
+     *
+     * To be called by the task woken by the wake function, always from the
+     * same task, with esp_timer_get_time() as the argument. Can also be
+     * driven using a simulated clock.
+     *
+     * @return Time of next due step or TimedSequence::finished if no
+     *         sequence is active.
+     */
+    int64_t run_due(int64_t now_us);
+
+private:
+    std::array<TimedSequence*, max_sequences> _slots{};
+    esp_timer_handle_t _timer = nullptr;
+    wake_fn_t _wake_fn = nullptr;
+    void *_wake_fn_arg = nullptr;
+    portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+
+    int64_t _next_wake_time_locked() const;
+    void _rearm_timer_locked(int64_t now_us);
+
+    static void _on_timer(void *arg);
+};
+
+#endif
@@ -0,0 +1,98 @@
+/* Minimal streaming JSON writer for flat objects
+ *
+ * License: GPL v.3
+ */
+#include "json_stream_writer.hpp"
+
+
+void JsonStreamWriter::begin_object() {
+    _put('{');
+    _first_member = true;
+}
+
+void JsonStreamWriter::end_object() {
+    _put('}');
+}
+
+void JsonStreamWriter::key(const char *key) {
+    if (!_first_member) {
+        _put(',');
+    }
+    _first_member = false;
+    _put('"');
+    _put(key);
+    _put("\":");
+}
+
+void JsonStreamWriter::value(bool value) {
+    _put(value ? "true" : "false");
+}
+
+void JsonStreamWriter::value(uint32_t value) {
+    // Digits are generated in reverse order
+    char digits[10];
+    auto n_digits = 0;
+    do {
+        digits[n_digits++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value);
+    while (n_digits) {
+        _put(digits[--n_digits]);
+    }
+}
+
+void JsonStreamWriter::value(float value, uint8_t decimal_places) {
+    char text[FixedPoint::max_len(FixedPoint::max_decimal_places) + 1];
+    // JSON has no representation for non-finite values
+    if (FixedPoint::format(text, value, decimal_places) == 0) {
+        _put("null");
+        return;
+    }
+    _put(text);
+}
+
+void JsonStreamWriter::value(const char *value) {
+    static constexpr char hex_digits[] = "0123456789abcdef";
+    _put('"');
+    for (; *value; ++value) {
+        const auto c = static_cast<unsigned char>(*value);
+        if (c == '"' || c == '\\') {
+            _put('\\');
+            _put(static_cast<char>(c));
+        } else if (c < 0x20) {
+            _put("\\u00");
+            _put(hex_digits[c >> 4]);
+            _put(hex_digits[c & 0xf]);
+        } else {
+            _put(static_cast<char>(c));
+        }
+    }
+    _put('"');
+}
+
+size_t JsonStreamWriter::finish() {
+    if (_buf_len == 0) {
+        return 0;
+    }
+    if (_overflow) {
+        _buf[0] = '\0';
+        return 0;
+    }
+    _buf[_pos] = '\0';
+    return _pos;
+}
+
+void JsonStreamWriter::_put(char c) {
+    // One byte is always reserved for the terminating null
+    if (_pos + 1 >= _buf_len) {
+        _overflow = true;
+        return;
+    }
+    _buf[_pos++] = c;
+}
+
+void JsonStreamWriter::_put(const char *str) {
+    while (*str) {
+        _put(*str++);
+    }
+}
@@ -0,0 +1,231 @@
+/* Setpoint ramp generator with linear, S-curve and exponential profiles
+ *
+ * License: GPL v.3
+ */
+#include <algorithm>
+#include <cmath>
+
+#include "sdkconfig.h"
+#include "esp_attr.h"
+
+#include "ramp_generator.hpp"
+
+// The wake function is called from the esp_timer ISR
+#ifndef CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+#error "RampGenerator requires CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD in sdkconfig"
+#endif
+
+#undef LOG_LOCAL_LEVEL
+#define LOG_LOCAL_LEVEL ESP_LOG_INFO
+#include "esp_log.h"
+static auto TAG = "RampGenerator";
+
+
+//////////// RampAxis ///////////
+
+void RampAxis::configure(RampProfile profile,
+                         size_t s_curve_filter_len,
+                         float exp_time_constant_steps) {
+    _profile = profile;
+    _filter_len = std::max(size_t{1}, std::min(s_curve_filter_len, max_filter_len));
+    _exp_factor = 1.0f - std::exp(-1.0f / std::max(exp_time_constant_steps, 1.0f));
+    // A ramp in progress continues from the current output value
+    _position = _output;
+    _filter_1.reset(_output, _filter_len);
+    _filter_2.reset(_output, _filter_len);
+}
+
+void RampAxis::jump_to(float value, bool call_output) {
+    _target = value;
+    _position = value;
+    _output = value;
+    _filter_1.reset(value, _filter_len);
+    _filter_2.reset(value, _filter_len);
+    if (call_output) {
+        _output_fn(value, _arg);
+    }
+}
+
+bool RampAxis::step() {
+    const auto last_output = _output;
+    if (_rate <= 0.0f) {
+        // No rate limit, i.e. no ramp. This would never settle otherwise.
+        const auto is_changed = _target != last_output;
+        jump_to(_target, is_changed);
+        return is_changed;
+    }
+    switch (_profile) {
+    case RampProfile::s_curve:
+        _position = _step_linear(_position);
+        _output = _filter_2.push(_filter_1.push(_position));
+        break;
+    case RampProfile::exponential: {
+        auto dx = (_target - _position) * _exp_factor;
+        auto next = _position + std::max(-_rate, std::min(dx, _rate));
+        // The approach is asymptotic. Snap to target when the remaining
+        // difference is negligible or below the float resolution.
+        if (next == _position || std::fabs(_target - next) < 1e-3f * _rate) {
+            next = _target;
+        }
+        _position = next;
+        _output = _position;
+        break;
+    }
+    case RampProfile::linear:
+    default:
+        _position = _step_linear(_position);
+        _output = _position;
+    }
+    if (_output == last_output) {
+        return false;
+    }
+    _output_fn(_output, _arg);
+    return true;
+}
+
+float RampAxis::_step_linear(float from) const {
+    auto dx = _target - from;
+    if (std::fabs(dx) <= _rate) {
+        return _target;
+    }
+    return dx > 0.0f ? from + _rate : from - _rate;
+}
+
+void RampAxis::MovingAverage::reset(float value, size_t len) {
+    _len = len;
+    std::fill_n(_buf.begin(), _len, value);
+    _index = 0;
+    _n_equal = _len;
+}
+
+float RampAxis::MovingAverage::push(float value) {
+    auto last_value = _buf[(_index + _len - 1) % _len];
+    _n_equal = value == last_value ? _n_equal + 1 : 1;
+    _buf[_index] = value;
+    _index = (_index + 1) % _len;
+    if (_n_equal >= _len) {
+        return value;
+    }
+    auto sum = 0.0f;
+    for (auto i = 0u; i < _len; ++i) {
+        sum += _buf[i];
+    }
+    return sum / _len;
+}
+
+
+//////////// RampGenerator ///////////
+
+RampGenerator::~RampGenerator() {
+    if (_timer) {
+        esp_timer_stop(_timer);
+        esp_timer_delete(_timer);
+    }
+}
+
+esp_err_t RampGenerator::begin(uint32_t step_interval_us,
+                               wake_fn_t wake_fn, void *wake_fn_arg,
+                               finished_fn_t finished_fn, void *arg) {
+    _step_interval_us = step_interval_us;
+    _wake_fn = wake_fn;
+    _wake_fn_arg = wake_fn_arg;
+    _finished_fn = finished_fn;
+    _finished_fn_arg = arg;
+    esp_timer_create_args_t timer_config;
+    timer_config.callback = _on_timer;
+    timer_config.arg = this;
+    timer_config.dispatch_method = ESP_TIMER_ISR;
+    timer_config.name = "RampGenerator";
+    timer_config.skip_unhandled_events = false;
+    return esp_timer_create(&timer_config, &_timer);
+}
+
+esp_err_t RampGenerator::add_axis(RampAxis &axis) {
+    auto slot = std::find(_axes.begin(), _axes.end(), nullptr);
+    if (slot == _axes.end()) {
+        ESP_LOGE(TAG, "Maximum number of ramp axes reached!");
+        return ESP_ERR_NO_MEM;
+    }
+    *slot = &axis;
+    return ESP_OK;
+}
+
+void RampGenerator::configure(RampProfile profile,
+                              uint32_t s_curve_time_us,
+                              uint32_t exp_time_constant_us) {
+    // Two filters in series, each one gets half of the total time
+    auto filter_len = s_curve_time_us / _step_interval_us / 2;
+    auto time_constant_steps = static_cast<float>(exp_time_constant_us) / _step_interval_us;
+    for (auto axis : _axes) {
+        if (axis) {
+            axis->configure(profile, filter_len, time_constant_steps);
+        }
+    }
+}
+
+void RampGenerator::set_rate(RampAxis &axis, float rate_per_sec) {
+    axis.set_rate(rate_per_sec * _step_interval_us * 1e-6f);
+}
+
+void RampGenerator::set_target(RampAxis &axis, float target) {
+    axis.set_target(target);
+    if (!axis.is_settled()) {
+        _start_timer();
+    }
+}
+
+void RampGenerator::jump_to(RampAxis &axis, float value) {
+    axis.jump_to(value);
+}
+
+void RampGenerator::run_due(int64_t now_us) {
+    // Wake-ups can still be pending after the timer was stopped
+    if (!_active) {
+        return;
+    }
+    // Steps already done or dropped by an earlier call are not due any more
+    const auto steps_due = static_cast<uint32_t>(
+        (now_us - _last_step_us) / _step_interval_us);
+    if (steps_due == 0) {
+        return;
+    }
+    _last_step_us += int64_t{steps_due} * _step_interval_us;
+    const auto n_steps = std::min(steps_due, _catch_up_max_steps);
+    _missed_steps += steps_due - n_steps;
+    auto all_settled = true;
+    for (uint32_t i = 0; i < n_steps; ++i) {
+        _caught_up_steps += i > 0;
+        all_settled = true;
+        for (auto axis : _axes) {
+            if (axis) {
+                axis->step();
+                all_settled &= axis->is_settled();
+            }
+        }
+        if (all_settled) {
+            break;
+        }
+    }
+    if (all_settled) {
+        esp_timer_stop(_timer);
+        _active = false;
+        if (_finished_fn) {
+            _finished_fn(_finished_fn_arg);
+        }
+    }
+}
+
+
+void RampGenerator::_start_timer() {
+    if (!_active) {
+        _active = true;
+        _last_step_us = esp_timer_get_time();
+        esp_timer_start_periodic(_timer, _step_interval_us);
+    }
+}
+
+// Called from the esp_timer ISR
+void IRAM_ATTR RampGenerator::_on_timer(void *arg) {
+    auto self = static_cast<RampGenerator*>(arg);
+    self->_wake_fn(self->_wake_fn_arg);
+}
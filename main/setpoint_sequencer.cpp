@@ -0,0 +1,113 @@
+/* On-device sequencer for scripted setpoint sweeps
+ *
+ * License: GPL v.3
+ */
+#include <cmath>
+
+#include "setpoint_sequencer.hpp"
+
+#undef LOG_LOCAL_LEVEL
+#define LOG_LOCAL_LEVEL ESP_LOG_INFO
+#include "esp_log.h"
+static auto TAG = "SetpointSequencer";
+
+// Shorter steps would keep the application task busy
+static constexpr uint32_t min_step_duration_us = 100;
+// Durations are stored as uint32_t in us, i.e. must be below 4294.97 s
+static constexpr uint32_t max_step_duration_us = 3600ul * 1000 * 1000;
+
+// Missing values are returned as NAN, meaning "unchanged"
+static float get_or_nan(JsonVariantConst jv) {
+    return jv.is<float>() ? jv.as<float>() : NAN;
+}
+
+
+esp_err_t SetpointSequencer::load_from_json(JsonArrayConst steps) {
+    if (steps.isNull() || steps.size() == 0 || steps.size() > max_steps) {
+        ESP_LOGE(TAG, "Sequence must have 1...%u steps", max_steps);
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Validate everything before touching the current table
+    for (JsonObjectConst step : steps) {
+        auto duration = step["duration"];
+        auto duration_us = duration.as<float>() * 1e6f;
+        // Negated comparison, so that NaN is rejected as well
+        if (step.isNull() || !duration.is<float>()
+            || !(duration_us >= min_step_duration_us
+                 && duration_us <= max_step_duration_us)) {
+            ESP_LOGE(TAG, "Invalid step or duration. Duration must be %u...%u us",
+                     min_step_duration_us, max_step_duration_us);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    portENTER_CRITICAL(&_lock);
+    auto is_busy = _seq.is_active() || _loading;
+    _loading = !is_busy;
+    portEXIT_CRITICAL(&_lock);
+    if (is_busy) {
+        ESP_LOGE(TAG, "Can not load sequence while running!");
+        return ESP_ERR_INVALID_STATE;
+    }
+    auto n_steps = size_t{0};
+    for (JsonObjectConst step : steps) {
+        auto output = step["output"];
+        _steps[n_steps++] = SequencerStep{
+            static_cast<uint32_t>(step["duration"].as<float>() * 1e6f),
+            get_or_nan(step["frequency"]),
+            get_or_nan(step["duty"]),
+            get_or_nan(step["lead_dt"]),
+            get_or_nan(step["lag_dt"]),
+            static_cast<int8_t>(output.is<bool>() ? output.as<bool>() : -1)
+        };
+    }
+    _n_steps = n_steps;
+    _step_index = 0;
+    _pass_count = 0;
+    portENTER_CRITICAL(&_lock);
+    _loading = false;
+    portEXIT_CRITICAL(&_lock);
+    ESP_LOGI(TAG, "Loaded sequence with %u steps", n_steps);
+    return ESP_OK;
+}
+
+/* The runner is started while holding the lock, so that load_from_json()
+ * can not begin writing the table in between.
+ */
+esp_err_t SetpointSequencer::start() {
+    portENTER_CRITICAL(&_lock);
+    auto can_start = _n_steps > 0 && !_loading;
+    auto errors = can_start ? _runner.start(_seq) : ESP_ERR_INVALID_STATE;
+    portEXIT_CRITICAL(&_lock);
+    if (!can_start) {
+        ESP_LOGE(TAG, "No sequence loaded!");
+    } else if (errors != ESP_OK) {
+        ESP_LOGE(TAG, "Maximum number of active sequences reached!");
+    }
+    return errors;
+}
+
+void SetpointSequencer::stop() {
+    _runner.stop(_seq);
+}
+
+
+/* Sequence step function, see timed_sequence.hpp.
+ * Loop counters must be class members as the function returns on each delay.
+ */
+int64_t SetpointSequencer::_run(TimedSequence &seq) {
+    SEQ_BEGIN(seq);
+    _pass_count = 0;
+    while (true) {
+        for (_step_index = 0; _step_index < _n_steps; ++_step_index) {
+            _apply_fn(_steps[_step_index], _arg);
+            SEQ_DELAY_US(seq, _steps[_step_index].duration_us);
+        }
+        ++_pass_count;
+        if (!_loop) {
+            break;
+        }
+    }
+    // Last step index remains valid for the progress display
+    _step_index = _n_steps - 1;
+    SEQ_END(seq);
+}
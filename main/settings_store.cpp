@@ -0,0 +1,107 @@
+/* Write-behind persistence of the runtime settings
+ *
+ * License: GPL v.3
+ */
+#include <cstring>
+
+#include "esp_timer.h"
+
+#include "settings_store.hpp"
+
+#undef LOG_LOCAL_LEVEL
+#define LOG_LOCAL_LEVEL ESP_LOG_INFO
+#include "esp_log.h"
+static auto TAG = "SettingsStore";
+
+
+esp_err_t SettingsStore::begin(uint32_t stack_size, UBaseType_t priority,
+                               BaseType_t core_id) {
+    auto len = _stored_blob.size();
+    auto err = AppState::read_settings_blob(_stored_blob.data(), &len);
+    // Stored blob of another schema version or none at all.
+    // In both cases, the next save is written.
+    _stored_blob_len = err == ESP_OK ? len : 0;
+    xTaskCreatePinnedToCore(_task, "settings_store", stack_size,
+                            static_cast<void*>(this), priority,
+                            &_task_handle, core_id);
+    if (!_task_handle) {
+        ESP_LOGE(TAG, "Failed to create settings store task!");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void SettingsStore::request_save(const AppStateSnapshot &settings, int64_t now_us,
+                                 uint32_t delay_ms, bool is_autosave) {
+    portENTER_CRITICAL(&_lock);
+    _pending_settings = settings;
+    if (!(is_autosave && _explicit_pending)) {
+        _due_time_us = now_us + int64_t{delay_ms} * 1000;
+    }
+    _explicit_pending |= !is_autosave;
+    _pending = true;
+    portEXIT_CRITICAL(&_lock);
+    if (_task_handle) {
+        xTaskNotifyGive(_task_handle);
+    }
+}
+
+bool SettingsStore::take_due(int64_t now_us, AppStateSnapshot *settings,
+                             int64_t *wait_us) {
+    auto is_due = false;
+    portENTER_CRITICAL(&_lock);
+    if (!_pending) {
+        *wait_us = -1;
+    } else if (now_us < _due_time_us) {
+        *wait_us = _due_time_us - now_us;
+    } else {
+        *settings = _pending_settings;
+        _pending = false;
+        _explicit_pending = false;
+        *wait_us = -1;
+        is_due = true;
+    }
+    portEXIT_CRITICAL(&_lock);
+    return is_due;
+}
+
+bool SettingsStore::store(const AppStateSnapshot &settings) {
+    auto blob = std::array<uint8_t, AppState::settings_blob_len>{};
+    auto blob_len = AppState::serialize_settings_blob(settings, blob.data(), blob.size());
+    if (blob_len == _stored_blob_len
+            && std::memcmp(blob.data(), _stored_blob.data(), blob_len) == 0) {
+        ++_writes_skipped;
+        ESP_LOGI(TAG, "Settings unchanged, not written");
+        return false;
+    }
+    auto err = AppState::write_settings_blob(blob.data(), blob_len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error saving settings to NVS: %s", esp_err_to_name(err));
+        return false;
+    }
+    _stored_blob = blob;
+    _stored_blob_len = blob_len;
+    ++_writes;
+    ESP_LOGI(TAG, "Saved %d bytes of settings to NVS", blob_len);
+    return true;
+}
+
+/* Worker task, sleeps until the next request is due or a new one arrives
+ */
+void SettingsStore::_task(void *pVParameters) {
+    auto self = static_cast<SettingsStore*>(pVParameters);
+    ESP_LOGI(TAG, "Starting settings store task");
+    auto settings = AppStateSnapshot{};
+    while (true) {
+        auto wait_us = int64_t{0};
+        if (self->take_due(esp_timer_get_time(), &settings, &wait_us)) {
+            self->store(settings);
+            continue;
+        }
+        // Rounded up so that the request is due on wake-up
+        const auto us_per_tick = int64_t{portTICK_PERIOD_MS} * 1000;
+        const auto wait_ticks = wait_us < 0 ? portMAX_DELAY
+            : static_cast<TickType_t>((wait_us + us_per_tick - 1) / us_per_tick);
+        ulTaskNotifyTake(pdTRUE, wait_ticks);
+    }
+}
@@ -0,0 +1,132 @@
+/* Resumable multi-step hardware sequences timed by one common esp_timer
+ *
+ * License: GPL v.3
+ */
+#include <algorithm>
+
+#include "sdkconfig.h"
+#include "esp_attr.h"
+
+#include "timed_sequence.hpp"
+
+// The wake function is called from the esp_timer ISR
+#ifndef CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+#error "SequenceRunner requires CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD in sdkconfig"
+#endif
+
+
+SequenceRunner::~SequenceRunner() {
+    if (_timer) {
+        esp_timer_stop(_timer);
+        esp_timer_delete(_timer);
+    }
+}
+
+esp_err_t SequenceRunner::begin(wake_fn_t wake_fn, void *arg) {
+    _wake_fn = wake_fn;
+    _wake_fn_arg = arg;
+    esp_timer_create_args_t timer_config;
+    timer_config.callback = _on_timer;
+    timer_config.arg = this;
+    timer_config.dispatch_method = ESP_TIMER_ISR;
+    timer_config.name = "SequenceRunner";
+    timer_config.skip_unhandled_events = false;
+    return esp_timer_create(&timer_config, &_timer);
+}
+
+esp_err_t SequenceRunner::start(TimedSequence &seq) {
+    assert(_timer);
+    auto now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&_lock);
+    auto slot = std::find(_slots.begin(), _slots.end(), &seq);
+    if (slot == _slots.end()) {
+        slot = std::find(_slots.begin(), _slots.end(), nullptr);
+    }
+    if (slot == _slots.end()) {
+        portEXIT_CRITICAL(&_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    *slot = &seq;
+    seq.resume_point = 0;
+    seq._wake_time_us = now_us;
+    ++seq._start_count;
+    seq._active = true;
+    _rearm_timer_locked(now_us);
+    portEXIT_CRITICAL(&_lock);
+    return ESP_OK;
+}
+
+void SequenceRunner::stop(TimedSequence &seq) {
+    portENTER_CRITICAL(&_lock);
+    auto slot = std::find(_slots.begin(), _slots.end(), &seq);
+    if (slot != _slots.end()) {
+        *slot = nullptr;
+    }
+    seq._active = false;
+    portEXIT_CRITICAL(&_lock);
+}
+
+int64_t SequenceRunner::run_due(int64_t now_us) {
+    for (auto i = 0u; i < max_sequences; ++i) {
+        portENTER_CRITICAL(&_lock);
+        auto seq = _slots[i];
+        auto is_due = seq && seq->_wake_time_us <= now_us;
+        auto start_count = is_due ? seq->_start_count : 0;
+        portEXIT_CRITICAL(&_lock);
+        if (!is_due) {
+            continue;
+        }
+        // Step function is called without holding the lock because it
+        // may well start or stop other sequences.
+        auto delay_us = seq->_step_fn(*seq, seq->_arg);
+        portENTER_CRITICAL(&_lock);
+        if (seq->_start_count != start_count) {
+            // Restarted meanwhile. The step function has overwritten the
+            // resume point set by start().
+            seq->resume_point = 0;
+        } else if (_slots[i] == seq) {
+            // Not stopped meanwhile
+            if (delay_us == TimedSequence::finished) {
+                _slots[i] = nullptr;
+                seq->_active = false;
+            } else {
+                seq->_wake_time_us += delay_us;
+            }
+        }
+        portEXIT_CRITICAL(&_lock);
+    }
+    portENTER_CRITICAL(&_lock);
+    auto next_wake_time_us = _next_wake_time_locked();
+    if (_timer) {
+        _rearm_timer_locked(esp_timer_get_time());
+    }
+    portEXIT_CRITICAL(&_lock);
+    return next_wake_time_us;
+}
+
+
+int64_t SequenceRunner::_next_wake_time_locked() const {
+    auto next_wake_time_us = TimedSequence::finished;
+    for (auto seq : _slots) {
+        if (seq && (next_wake_time_us == TimedSequence::finished
+                    || seq->_wake_time_us < next_wake_time_us)) {
+            next_wake_time_us = seq->_wake_time_us;
+        }
+    }
+    return next_wake_time_us;
+}
+
+void SequenceRunner::_rearm_timer_locked(int64_t now_us) {
+    esp_timer_stop(_timer);
+    auto next_wake_time_us = _next_wake_time_locked();
+    if (next_wake_time_us != TimedSequence::finished) {
+        auto timeout_us = std::max(next_wake_time_us - now_us, int64_t{0});
+        esp_timer_start_once(_timer, static_cast<uint64_t>(timeout_us));
+    }
+}
+
+// Called from the esp_timer ISR
+void IRAM_ATTR SequenceRunner::_on_timer(void *arg) {
+    auto self = static_cast<SequenceRunner*>(arg);
+    self->_wake_fn(self->_wake_fn_arg);
+}
@@ -0,0 +1,55 @@
+/** @file FS.h
+ * @brief Host stand-in for the Arduino header of the same name
+ *
+ * A File refers to the contents of a file of the in-memory file system,
+ * see SPIFFS.h.
+ *
+ * License: GPL v.3
+ */
+#ifndef FS_H__
+#define FS_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+class File
+{
+public:
+    File() = default;
+    explicit File(std::vector<uint8_t> *data)
+        : _data{data}
+    {}
+
+    explicit operator bool() const {return _data != nullptr;}
+
+    size_t size() const {return _data ? _data->size() : 0;}
+
+    size_t write(const uint8_t *buf, size_t size) {
+        if (!_data) {
+            return 0;
+        }
+        _data->insert(_data->end(), buf, buf + size);
+        return size;
+    }
+
+    size_t read(uint8_t *buf, size_t size) {
+        if (!_data) {
+            return 0;
+        }
+        auto len = std::min(size, _data->size() - _pos);
+        std::memcpy(buf, _data->data() + _pos, len);
+        _pos += len;
+        return len;
+    }
+
+    void close() {_data = nullptr;}
+
+private:
+    std::vector<uint8_t> *_data = nullptr;
+    size_t _pos = 0;
+};
+
+#endif
@@ -0,0 +1,26 @@
+/** @file IPAddress.h
+ * @brief Host stand-in for the Arduino header of the same name
+ *
+ * License: GPL v.3
+ */
+#ifndef IPADDRESS_H__
+#define IPADDRESS_H__
+
+#include <array>
+#include <cstdint>
+
+class IPAddress
+{
+public:
+    IPAddress() = default;
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+        : _address{a, b, c, d}
+    {}
+
+    uint8_t operator[](int index) const {return _address[index];}
+
+private:
+    std::array<uint8_t, 4> _address{};
+};
+
+#endif
@@ -0,0 +1,44 @@
+/** @file SPIFFS.h
+ * @brief Host stand-in for the Arduino header of the same name
+ *
+ * Files are kept in memory. Tests can put files there using
+ * SPIFFS.files[filename] and reset the file system with SPIFFS.files.clear().
+ *
+ * License: GPL v.3
+ */
+#ifndef SPIFFS_H__
+#define SPIFFS_H__
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "FS.h"
+
+class SPIFFSFS
+{
+public:
+    std::map<std::string, std::vector<uint8_t>> files{};
+
+    bool begin(bool format_on_fail) {return true;}
+
+    bool exists(const char *path) const {return files.count(path) != 0;}
+
+    /* Mode "w" truncates the file, "r" fails if it does not exist
+     */
+    File open(const char *path, const char *mode) {
+        if (mode[0] == 'w') {
+            files[path].clear();
+        } else if (!exists(path)) {
+            return File{};
+        }
+        return File{&files[path]};
+    }
+
+    bool remove(const char *path) {return files.erase(path) != 0;}
+};
+
+inline SPIFFSFS SPIFFS{};
+
+#endif
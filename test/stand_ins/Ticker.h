@@ -0,0 +1,39 @@
+/** @file Ticker.h
+ * @brief Host stand-in for the arduino-esp32 Ticker, as far as it is
+ * used by MultiTimer
+ *
+ * License: GPL v.3
+ */
+#ifndef TICKER_H__
+#define TICKER_H__
+
+#include <cstdint>
+
+#include "esp_timer.h"
+
+class Ticker
+{
+public:
+    Ticker() = default;
+    ~Ticker() {detach();}
+
+    typedef void (*callback_t)(void);
+    typedef void (*callback_with_arg_t)(void*);
+
+    void detach() {
+        if (_timer) {
+            esp_timer_stop(_timer);
+            esp_timer_delete(_timer);
+            _timer = nullptr;
+        }
+    }
+
+    bool active() {
+        return _timer && _timer->armed;
+    }
+
+protected:
+    esp_timer_handle_t _timer = nullptr;
+};
+
+#endif
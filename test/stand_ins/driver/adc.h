@@ -0,0 +1,17 @@
+/** @file adc.h
+ * @brief Host stand-in for the ESP-IDF ADC driver configuration types
+ *
+ * License: GPL v.3
+ */
+#ifndef ADC_H__
+#define ADC_H__
+
+typedef enum {
+    ADC1_CHANNEL_0,
+    ADC1_CHANNEL_1,
+    ADC1_CHANNEL_2,
+    ADC1_CHANNEL_3,
+    ADC1_CHANNEL_MAX = 8,
+} adc1_channel_t;
+
+#endif
@@ -0,0 +1,156 @@
+/** @file gpio.h
+ * @brief Host stand-in for the ESP-IDF GPIO driver interrupt functions
+ * and configuration types
+ *
+ * Registered ISR handlers are not run by any hardware. A test simulates an
+ * edge on a pin by calling GpioStandIn::trigger().
+ *
+ * License: GPL v.3
+ */
+#ifndef GPIO_H__
+#define GPIO_H__
+
+#include <array>
+#include <cstdint>
+
+#include "esp_err.h"
+
+typedef enum {
+    GPIO_NUM_NC = -1,
+    GPIO_NUM_0 = 0,
+    GPIO_NUM_2 = 2,
+    GPIO_NUM_4 = 4,
+    GPIO_NUM_16 = 16,
+    GPIO_NUM_17 = 17,
+    GPIO_NUM_18 = 18,
+    GPIO_NUM_19 = 19,
+    GPIO_NUM_21 = 21,
+    GPIO_NUM_22 = 22,
+    GPIO_NUM_23 = 23,
+    GPIO_NUM_25 = 25,
+    GPIO_NUM_26 = 26,
+    GPIO_NUM_27 = 27,
+    GPIO_NUM_32 = 32,
+    GPIO_NUM_33 = 33,
+    GPIO_NUM_39 = 39,
+    GPIO_NUM_MAX,
+} gpio_num_t;
+
+typedef enum {
+    GPIO_INTR_DISABLE,
+    GPIO_INTR_POSEDGE,
+    GPIO_INTR_NEGEDGE,
+    GPIO_INTR_ANYEDGE,
+} gpio_int_type_t;
+
+typedef enum {
+    GPIO_MODE_DISABLE,
+    GPIO_MODE_INPUT,
+    GPIO_MODE_OUTPUT,
+} gpio_mode_t;
+
+typedef enum {
+    GPIO_PULLUP_DISABLE,
+    GPIO_PULLUP_ENABLE,
+} gpio_pullup_t;
+
+typedef enum {
+    GPIO_PULLDOWN_DISABLE,
+    GPIO_PULLDOWN_ENABLE,
+} gpio_pulldown_t;
+
+typedef struct {
+    uint64_t pin_bit_mask;
+    gpio_mode_t mode;
+    gpio_pullup_t pull_up_en;
+    gpio_pulldown_t pull_down_en;
+    gpio_int_type_t intr_type;
+} gpio_config_t;
+
+typedef void (*gpio_isr_t)(void *arg);
+
+
+/** @brief Interrupt configuration per pin
+ */
+struct GpioStandIn {
+    struct Pin {
+        gpio_int_type_t intr_type;
+        gpio_isr_t handler;
+        void *arg;
+        bool intr_enabled;
+    };
+
+    static inline bool isr_service_installed = false;
+    static inline std::array<Pin, GPIO_NUM_MAX> pins{};
+
+    static void reset() {
+        isr_service_installed = false;
+        pins = {};
+    }
+
+    /** @brief Run the ISR handler of the pin, like an edge would
+     *
+     * @return false if the interrupt is not enabled or has no handler
+     */
+    static bool trigger(gpio_num_t gpio_num) {
+        auto &pin = pins[gpio_num];
+        if (!isr_service_installed || !pin.intr_enabled || !pin.handler
+                || pin.intr_type == GPIO_INTR_DISABLE) {
+            return false;
+        }
+        pin.handler(pin.arg);
+        return true;
+    }
+};
+
+
+inline bool gpio_stand_in_is_valid(gpio_num_t gpio_num) {
+    return gpio_num >= 0 && gpio_num < GPIO_NUM_MAX;
+}
+
+inline esp_err_t gpio_install_isr_service(int intr_alloc_flags) {
+    if (GpioStandIn::isr_service_installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    GpioStandIn::isr_service_installed = true;
+    return ESP_OK;
+}
+
+inline esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type) {
+    if (!gpio_stand_in_is_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    GpioStandIn::pins[gpio_num].intr_type = intr_type;
+    return ESP_OK;
+}
+
+inline esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t handler, void *arg) {
+    if (!gpio_stand_in_is_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!GpioStandIn::isr_service_installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    GpioStandIn::pins[gpio_num].handler = handler;
+    GpioStandIn::pins[gpio_num].arg = arg;
+    return ESP_OK;
+}
+
+inline esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num) {
+    if (!gpio_stand_in_is_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    GpioStandIn::pins[gpio_num].handler = nullptr;
+    GpioStandIn::pins[gpio_num].arg = nullptr;
+    return ESP_OK;
+}
+
+inline esp_err_t gpio_intr_enable(gpio_num_t gpio_num) {
+    if (!gpio_stand_in_is_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    GpioStandIn::pins[gpio_num].intr_enabled = true;
+    return ESP_OK;
+}
+
+#endif
@@ -0,0 +1,64 @@
+/** @file ledc.h
+ * @brief Host stand-in for the ESP-IDF LEDC driver configuration types
+ *
+ * License: GPL v.3
+ */
+#ifndef LEDC_H__
+#define LEDC_H__
+
+#include <cstdint>
+
+typedef enum {
+    LEDC_HIGH_SPEED_MODE,
+    LEDC_LOW_SPEED_MODE,
+} ledc_mode_t;
+
+typedef enum {
+    LEDC_TIMER_1_BIT = 1,
+    LEDC_TIMER_8_BIT = 8,
+    LEDC_TIMER_10_BIT = 10,
+    LEDC_TIMER_12_BIT = 12,
+} ledc_timer_bit_t;
+
+typedef enum {
+    LEDC_TIMER_0,
+    LEDC_TIMER_1,
+    LEDC_TIMER_2,
+    LEDC_TIMER_3,
+} ledc_timer_t;
+
+typedef enum {
+    LEDC_AUTO_CLK,
+    LEDC_USE_REF_TICK,
+    LEDC_USE_APB_CLK,
+} ledc_clk_cfg_t;
+
+typedef enum {
+    LEDC_CHANNEL_0,
+    LEDC_CHANNEL_1,
+} ledc_channel_t;
+
+typedef enum {
+    LEDC_INTR_DISABLE,
+    LEDC_INTR_FADE_END,
+} ledc_intr_type_t;
+
+typedef struct {
+    ledc_mode_t speed_mode;
+    ledc_timer_bit_t duty_resolution;
+    ledc_timer_t timer_num;
+    uint32_t freq_hz;
+    ledc_clk_cfg_t clk_cfg;
+} ledc_timer_config_t;
+
+typedef struct {
+    int gpio_num;
+    ledc_mode_t speed_mode;
+    ledc_channel_t channel;
+    ledc_intr_type_t intr_type;
+    ledc_timer_t timer_sel;
+    uint32_t duty;
+    int hpoint;
+} ledc_channel_config_t;
+
+#endif
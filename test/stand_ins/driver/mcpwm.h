@@ -0,0 +1,27 @@
+/** @file mcpwm.h
+ * @brief Host stand-in for the ESP-IDF MCPWM driver configuration types
+ *
+ * License: GPL v.3
+ */
+#ifndef MCPWM_H__
+#define MCPWM_H__
+
+typedef enum {
+    MCPWM_UNIT_0,
+    MCPWM_UNIT_1,
+    MCPWM_UNIT_MAX,
+} mcpwm_unit_t;
+
+typedef enum {
+    MCPWM_LOW_LEVEL_TGR,
+    MCPWM_HIGH_LEVEL_TGR,
+} mcpwm_fault_input_level_t;
+
+typedef enum {
+    MCPWM_NO_CHANGE_IN_MCPWMXA,
+    MCPWM_FORCE_MCPWMXA_LOW,
+    MCPWM_FORCE_MCPWMXA_HIGH,
+    MCPWM_TOG_MCPWMXA,
+} mcpwm_action_on_pwmxa_t;
+
+#endif
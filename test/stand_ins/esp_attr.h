@@ -0,0 +1,12 @@
+/** @file esp_attr.h
+ * @brief Host stand-in for the ESP-IDF header of the same name
+ *
+ * License: GPL v.3
+ */
+#ifndef ESP_ATTR_H__
+#define ESP_ATTR_H__
+
+// Placement in IRAM has no meaning on the host
+#define IRAM_ATTR
+
+#endif
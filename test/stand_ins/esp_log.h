@@ -0,0 +1,36 @@
+/** @file esp_log.h
+ * @brief Host stand-in for the ESP-IDF header of the same name
+ *
+ * Log output is discarded, only the arguments are type-checked.
+ *
+ * License: GPL v.3
+ */
+#ifndef ESP_LOG_H__
+#define ESP_LOG_H__
+
+#include <cstdio>
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+#define ESP_STAND_IN_LOG(tag, format, ...) \
+    do { \
+        if (false) { \
+            (void)(tag); \
+            printf(format, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) ESP_STAND_IN_LOG(tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_STAND_IN_LOG(tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_STAND_IN_LOG(tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_STAND_IN_LOG(tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) ESP_STAND_IN_LOG(tag, format, ##__VA_ARGS__)
+
+#endif
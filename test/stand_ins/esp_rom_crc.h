@@ -0,0 +1,24 @@
+/** @file esp_rom_crc.h
+ * @brief Host stand-in for the ESP-IDF header of the same name
+ *
+ * Same result as the ROM function, i.e. the CRC-32 of zlib when crc is zero.
+ *
+ * License: GPL v.3
+ */
+#ifndef ESP_ROM_CRC_H__
+#define ESP_ROM_CRC_H__
+
+#include <cstdint>
+
+inline uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; ++i) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+#endif
@@ -0,0 +1,15 @@
+/** @file esp_spiffs.h
+ * @brief Host stand-in for the ESP-IDF header of the same name
+ *
+ * The stand-in file system is always mounted, see SPIFFS.h.
+ *
+ * License: GPL v.3
+ */
+#ifndef ESP_SPIFFS_H__
+#define ESP_SPIFFS_H__
+
+inline bool esp_spiffs_mounted(const char *partition_label) {
+    return true;
+}
+
+#endif
@@ -0,0 +1,173 @@
+/** @file esp_timer.h
+ * @brief Host stand-in for the ESP-IDF esp_timer with a simulated clock
+ *
+ * Time only advances when a test calls EspTimerStandIn::advance_to() or
+ * EspTimerStandIn::advance_by(). Timers due in the meantime are run in the
+ * order of their alarm times, with the clock set to the alarm time, i.e.
+ * callbacks run exactly on time regardless of the dispatch method.
+ *
+ * Like for ESP-IDF, starting a running timer and stopping a timer which is
+ * not running return ESP_ERR_INVALID_STATE.
+ *
+ * License: GPL v.3
+ */
+#ifndef ESP_TIMER_H__
+#define ESP_TIMER_H__
+
+#include <cstdint>
+#include <array>
+
+#include "esp_err.h"
+
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef enum {
+    ESP_TIMER_TASK,
+    ESP_TIMER_ISR,
+} esp_timer_dispatch_t;
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void *arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char *name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    esp_timer_dispatch_t dispatch_method;
+    bool armed;
+    // Zero for one-shot timers
+    uint64_t period_us;
+    int64_t alarm_us;
+    // Number of callback invocations since creation
+    uint32_t n_calls;
+};
+typedef struct esp_timer *esp_timer_handle_t;
+
+
+/** @brief Simulated clock and timer registry
+ */
+struct EspTimerStandIn {
+    static constexpr size_t max_timers = 16;
+
+    static inline int64_t now_us = 0;
+    static inline std::array<esp_timer, max_timers> timers{};
+    static inline std::array<bool, max_timers> in_use{};
+
+    /** @brief Delete all timers and set the clock to zero
+     */
+    static void reset() {
+        now_us = 0;
+        timers = {};
+        in_use = {};
+    }
+
+    /** @brief Run all timers due until t_us, then set the clock to t_us
+     *
+     * @return Number of callbacks run
+     */
+    static uint32_t advance_to(int64_t t_us) {
+        auto n_calls = uint32_t{0};
+        while (true) {
+            auto next = static_cast<esp_timer*>(nullptr);
+            for (size_t i = 0; i < max_timers; ++i) {
+                if (in_use[i] && timers[i].armed && timers[i].alarm_us <= t_us
+                        && (!next || timers[i].alarm_us < next->alarm_us)) {
+                    next = &timers[i];
+                }
+            }
+            if (!next) {
+                break;
+            }
+            now_us = next->alarm_us;
+            if (next->period_us) {
+                next->alarm_us += static_cast<int64_t>(next->period_us);
+            } else {
+                next->armed = false;
+            }
+            ++next->n_calls;
+            ++n_calls;
+            next->callback(next->arg);
+        }
+        if (t_us > now_us) {
+            now_us = t_us;
+        }
+        return n_calls;
+    }
+
+    static uint32_t advance_by(int64_t dt_us) {
+        return advance_to(now_us + dt_us);
+    }
+
+    /** @brief Number of timers which are currently running
+     */
+    static size_t n_armed() {
+        auto n = size_t{0};
+        for (size_t i = 0; i < max_timers; ++i) {
+            n += in_use[i] && timers[i].armed;
+        }
+        return n;
+    }
+};
+
+
+inline int64_t esp_timer_get_time() {
+    return EspTimerStandIn::now_us;
+}
+
+inline esp_err_t esp_timer_create(const esp_timer_create_args_t *args,
+                                  esp_timer_handle_t *out_handle) {
+    for (size_t i = 0; i < EspTimerStandIn::max_timers; ++i) {
+        if (!EspTimerStandIn::in_use[i]) {
+            EspTimerStandIn::in_use[i] = true;
+            EspTimerStandIn::timers[i] = esp_timer{
+                args->callback, args->arg, args->dispatch_method, false, 0, 0, 0};
+            *out_handle = &EspTimerStandIn::timers[i];
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+inline esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    if (!timer || timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = true;
+    timer->period_us = 0;
+    timer->alarm_us = EspTimerStandIn::now_us + static_cast<int64_t>(timeout_us);
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    if (!timer || timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = true;
+    timer->period_us = period_us;
+    timer->alarm_us = EspTimerStandIn::now_us + static_cast<int64_t>(period_us);
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (!timer || !timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = false;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    if (!timer || timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    EspTimerStandIn::in_use[static_cast<size_t>(timer - EspTimerStandIn::timers.data())] = false;
+    return ESP_OK;
+}
+
+inline void esp_timer_isr_dispatch_need_yield() {}
+
+#endif
@@ -0,0 +1,39 @@
+/** @file FreeRTOS.h
+ * @brief Host stand-in for the FreeRTOS header of the same name
+ *
+ * Tests are single-threaded, so critical sections only keep track of the
+ * nesting depth, which tests can check for being balanced.
+ *
+ * License: GPL v.3
+ */
+#ifndef FREERTOS_H__
+#define FREERTOS_H__
+
+#include <cstdint>
+#include <cassert>
+
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define portMAX_DELAY static_cast<TickType_t>(0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) static_cast<TickType_t>(ms)
+// Same as for ESP32
+#define PRO_CPU_NUM 0
+#define APP_CPU_NUM 1
+
+typedef struct {
+    int nesting;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) (++(mux)->nesting)
+#define portEXIT_CRITICAL(mux) (assert((mux)->nesting > 0), --(mux)->nesting)
+#define portENTER_CRITICAL_SAFE(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_SAFE(mux) portEXIT_CRITICAL(mux)
+#define portYIELD_FROM_ISR()
+
+#endif
@@ -0,0 +1,34 @@
+/** @file semphr.h
+ * @brief Host stand-in for the FreeRTOS header of the same name
+ *
+ * License: GPL v.3
+ */
+#ifndef SEMPHR_H__
+#define SEMPHR_H__
+
+#include "freertos/FreeRTOS.h"
+
+// Mutexes only count the takes, tests are single-threaded
+typedef int *SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return new int{0};
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t) {
+    assert(*mutex == 0);
+    ++*mutex;
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex) {
+    assert(*mutex == 1);
+    --*mutex;
+    return pdTRUE;
+}
+
+inline void vSemaphoreDelete(SemaphoreHandle_t mutex) {
+    delete mutex;
+}
+
+#endif
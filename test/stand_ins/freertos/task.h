@@ -0,0 +1,77 @@
+/** @file task.h
+ * @brief Host stand-in for the FreeRTOS header of the same name
+ *
+ * Task notifications are recorded in the notification value of a
+ * TaskStandIn object, which is used as the task handle.
+ *
+ * Created tasks are not run, tests call the task functions instead.
+ *
+ * License: GPL v.3
+ */
+#ifndef TASK_H__
+#define TASK_H__
+
+#include <deque>
+
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *params);
+
+struct TaskStandIn {
+    uint32_t notified_value = 0;
+    uint32_t n_notifications = 0;
+    TaskFunction_t function = nullptr;
+    void *params = nullptr;
+
+    // Tasks created by xTaskCreatePinnedToCore()
+    static inline std::deque<TaskStandIn> created{};
+};
+typedef TaskStandIn *TaskHandle_t;
+
+typedef enum {
+    eNoAction,
+    eSetBits,
+} eNotifyAction;
+
+inline BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    if (action == eSetBits) {
+        task->notified_value |= value;
+    }
+    ++task->n_notifications;
+    return pdTRUE;
+}
+
+inline BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value,
+                                     eNotifyAction action,
+                                     BaseType_t *higher_priority_task_woken) {
+    *higher_priority_task_woken = pdTRUE;
+    return xTaskNotify(task, value, action);
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    ++task->notified_value;
+    ++task->n_notifications;
+    return pdTRUE;
+}
+
+/* No task is running, so there is nothing to wait for
+ */
+inline uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait) {
+    return 0;
+}
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name,
+                                          uint32_t stack_depth, void *params,
+                                          UBaseType_t priority,
+                                          TaskHandle_t *created_task,
+                                          BaseType_t core_id) {
+    auto &task = TaskStandIn::created.emplace_back();
+    task.function = function;
+    task.params = params;
+    if (created_task) {
+        *created_task = &task;
+    }
+    return pdTRUE;
+}
+
+#endif
@@ -0,0 +1,117 @@
+/** @file nvs.h
+ * @brief Host stand-in for the ESP-IDF NVS API with an in-memory store
+ *
+ * Only blobs are supported. Items are kept per namespace and key until
+ * NvsStandIn::reset() is called. Like for ESP-IDF, opening a namespace
+ * read-only fails with ESP_ERR_NVS_NOT_FOUND before anything was written
+ * to it.
+ *
+ * License: GPL v.3
+ */
+#ifndef NVS_H__
+#define NVS_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum {
+    NVS_READONLY,
+    NVS_READWRITE,
+} nvs_open_mode_t;
+
+
+/** @brief Stored items and call counters
+ */
+struct NvsStandIn {
+    using Namespace = std::map<std::string, std::vector<uint8_t>>;
+
+    static inline std::map<std::string, Namespace> namespaces{};
+    // Namespace name per handle, index is the handle minus one
+    static inline std::vector<std::string> handles{};
+    static inline uint32_t n_set_blob = 0;
+    static inline uint32_t n_commit = 0;
+
+    static void reset() {
+        namespaces.clear();
+        handles.clear();
+        n_set_blob = 0;
+        n_commit = 0;
+    }
+
+    static Namespace *get_namespace(nvs_handle_t handle) {
+        if (handle == 0 || handle > handles.size()) {
+            return nullptr;
+        }
+        return &namespaces[handles[handle - 1]];
+    }
+};
+
+
+inline esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode,
+                          nvs_handle_t *out_handle) {
+    if (open_mode == NVS_READONLY && !NvsStandIn::namespaces.count(name)) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    NvsStandIn::namespaces[name];
+    NvsStandIn::handles.push_back(name);
+    *out_handle = static_cast<nvs_handle_t>(NvsStandIn::handles.size());
+    return ESP_OK;
+}
+
+inline esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key,
+                              const void *value, size_t length) {
+    auto ns = NvsStandIn::get_namespace(handle);
+    if (!ns) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    auto bytes = static_cast<const uint8_t*>(value);
+    (*ns)[key].assign(bytes, bytes + length);
+    ++NvsStandIn::n_set_blob;
+    return ESP_OK;
+}
+
+/* Like for ESP-IDF, out_value can be null for querying the length
+ */
+inline esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key,
+                              void *out_value, size_t *length) {
+    auto ns = NvsStandIn::get_namespace(handle);
+    if (!ns) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    auto item = ns->find(key);
+    if (item == ns->end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    const auto &blob = item->second;
+    if (!out_value) {
+        *length = blob.size();
+        return ESP_OK;
+    }
+    if (*length < blob.size()) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    std::memcpy(out_value, blob.data(), blob.size());
+    *length = blob.size();
+    return ESP_OK;
+}
+
+inline esp_err_t nvs_commit(nvs_handle_t handle) {
+    if (!NvsStandIn::get_namespace(handle)) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    ++NvsStandIn::n_commit;
+    return ESP_OK;
+}
+
+inline void nvs_close(nvs_handle_t handle) {
+}
+
+#endif
@@ -0,0 +1,32 @@
+/** @file ps_pwm.h
+ * @brief Host stand-in for the setpoint types of the esp32_ps_pwm component
+ *
+ * Only the types used by the application state model are defined.
+ *
+ * License: GPL v.3
+ */
+#ifndef PS_PWM_H__
+#define PS_PWM_H__
+
+#include <cstdint>
+
+typedef struct {
+    uint32_t base_clk_prescale;
+    uint32_t timer_clk_prescale;
+} pspwm_clk_conf_t;
+
+typedef struct {
+    float frequency;
+    float ps_duty;
+    float lead_red;
+    float lag_red;
+    bool output_enabled;
+} pspwm_setpoint_t;
+
+typedef struct {
+    float frequency_min;
+    float frequency_max;
+    float dt_sum_max;
+} pspwm_setpoint_limits_t;
+
+#endif
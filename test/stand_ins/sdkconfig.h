@@ -0,0 +1,12 @@
+/** @file sdkconfig.h
+ * @brief Host stand-in with the options of the project sdkconfig which
+ * the modules under test depend on
+ *
+ * License: GPL v.3
+ */
+#ifndef SDKCONFIG_H__
+#define SDKCONFIG_H__
+
+#define CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD 1
+
+#endif
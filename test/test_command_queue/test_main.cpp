@@ -0,0 +1,142 @@
+/* Host tests for the CommandQueue
+ *
+ * License: GPL v.3
+ */
+#include <iterator>
+#include <unity.h>
+
+#include "command_queue.hpp"
+
+enum class TestCmd : uint8_t {
+    a,
+    b,
+    c,
+    d,
+};
+static constexpr size_t n_test_cmds = 4;
+
+using TestQueue = CommandQueue<TestCmd, int, n_test_cmds>;
+
+static void assert_entry(const TestQueue::Entry &entry, TestCmd cmd, int arg) {
+    TEST_ASSERT_EQUAL(static_cast<int>(cmd), static_cast<int>(entry.cmd));
+    TEST_ASSERT_EQUAL(arg, entry.arg);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+
+void test_drain_empty() {
+    auto queue = TestQueue{};
+    auto batch = TestQueue::Batch{};
+    auto seq = uint32_t{123};
+    TEST_ASSERT_EQUAL(0, queue.drain(batch, &seq));
+    TEST_ASSERT_EQUAL(0, seq);
+}
+
+/* Commands are drained in push order, and only once
+ */
+void test_push_order() {
+    auto queue = TestQueue{};
+    auto batch = TestQueue::Batch{};
+    queue.push(TestCmd::c, 3);
+    queue.push(TestCmd::a, 1);
+    queue.push(TestCmd::d, 4);
+    TEST_ASSERT_EQUAL(3, queue.drain(batch));
+    assert_entry(batch[0], TestCmd::c, 3);
+    assert_entry(batch[1], TestCmd::a, 1);
+    assert_entry(batch[2], TestCmd::d, 4);
+    TEST_ASSERT_EQUAL(0, queue.drain(batch));
+    TEST_ASSERT_EQUAL(0, queue.get_merged_count());
+}
+
+/* A command pushed again while pending is moved to the tail with the
+ * newest argument, the order of the others is kept
+ */
+void test_merged_command_moves_to_tail() {
+    auto queue = TestQueue{};
+    auto batch = TestQueue::Batch{};
+    queue.push(TestCmd::a, 1);
+    queue.push(TestCmd::b, 2);
+    queue.push(TestCmd::c, 3);
+    queue.push(TestCmd::a, 10);
+    TEST_ASSERT_EQUAL(1, queue.get_merged_count());
+    TEST_ASSERT_EQUAL(3, queue.drain(batch));
+    assert_entry(batch[0], TestCmd::b, 2);
+    assert_entry(batch[1], TestCmd::c, 3);
+    assert_entry(batch[2], TestCmd::a, 10);
+    // Pushing the tail entry again keeps the order
+    queue.push(TestCmd::a, 1);
+    queue.push(TestCmd::b, 2);
+    queue.push(TestCmd::b, 20);
+    TEST_ASSERT_EQUAL(2, queue.get_merged_count());
+    TEST_ASSERT_EQUAL(2, queue.drain(batch));
+    assert_entry(batch[0], TestCmd::a, 1);
+    assert_entry(batch[1], TestCmd::b, 20);
+}
+
+/* A flood of pushes never holds more than one entry per command
+ */
+void test_flood_is_bounded() {
+    auto queue = TestQueue{};
+    auto batch = TestQueue::Batch{};
+    for (auto i = 0; i < 1000; ++i) {
+        queue.push(static_cast<TestCmd>(i % n_test_cmds), i);
+    }
+    TEST_ASSERT_EQUAL(1000 - n_test_cmds, queue.get_merged_count());
+    TEST_ASSERT_EQUAL(n_test_cmds, queue.drain(batch));
+    for (size_t i = 0; i < n_test_cmds; ++i) {
+        assert_entry(batch[i], static_cast<TestCmd>(i), 996 + i);
+    }
+}
+
+/* Entries of a batch are drained together, later entries for the same
+ * command replace earlier ones
+ */
+void test_push_batch() {
+    auto queue = TestQueue{};
+    auto batch = TestQueue::Batch{};
+    queue.push(TestCmd::b, 2);
+    const TestQueue::Entry entries[] = {
+        {TestCmd::a, 1}, {TestCmd::b, 20}, {TestCmd::c, 3}, {TestCmd::a, 10}};
+    queue.push_batch(entries, std::size(entries));
+    TEST_ASSERT_EQUAL(2, queue.get_merged_count());
+    TEST_ASSERT_EQUAL(3, queue.drain(batch));
+    assert_entry(batch[0], TestCmd::b, 20);
+    assert_entry(batch[1], TestCmd::c, 3);
+    assert_entry(batch[2], TestCmd::a, 10);
+}
+
+/* Each push and each batch increments the sequence number once,
+ * drain() reports the one of the last push included
+ */
+void test_sequence_numbers() {
+    auto queue = TestQueue{};
+    auto batch = TestQueue::Batch{};
+    auto seq = uint32_t{0};
+    TEST_ASSERT_EQUAL(1, queue.push(TestCmd::a, 1));
+    TEST_ASSERT_EQUAL(2, queue.push(TestCmd::a, 2));
+    const TestQueue::Entry entries[] = {{TestCmd::b, 1}, {TestCmd::c, 1}};
+    TEST_ASSERT_EQUAL(3, queue.push_batch(entries, std::size(entries)));
+    TEST_ASSERT_EQUAL(3, queue.drain(batch, &seq));
+    TEST_ASSERT_EQUAL(3, seq);
+    TEST_ASSERT_EQUAL(4, queue.push(TestCmd::d, 1));
+    TEST_ASSERT_EQUAL(1, queue.drain(batch, &seq));
+    TEST_ASSERT_EQUAL(4, seq);
+    // Unchanged when nothing was pushed
+    TEST_ASSERT_EQUAL(0, queue.drain(batch, &seq));
+    TEST_ASSERT_EQUAL(4, seq);
+}
+
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_drain_empty);
+    RUN_TEST(test_push_order);
+    RUN_TEST(test_merged_command_moves_to_tail);
+    RUN_TEST(test_flood_is_bounded);
+    RUN_TEST(test_push_batch);
+    RUN_TEST(test_sequence_numbers);
+    return UNITY_END();
+}
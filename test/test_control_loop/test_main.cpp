@@ -0,0 +1,149 @@
+/* Host tests for the PIDController and the TimeProportioningOutput
+ *
+ * License: GPL v.3
+ */
+#include <unity.h>
+
+#include "../../main/control_loop.cpp"
+
+static constexpr float dt_s = 1.0f;
+
+void setUp() {}
+
+void tearDown() {}
+
+
+void test_pi_output() {
+    auto pid = PIDController{PIDParams{2.0f, 1.0f, 0.0f, -100.0f, 100.0f, false}};
+    // P: 2 * 2, I: 1 * 2 * 1 s
+    TEST_ASSERT_EQUAL_FLOAT(6.0f, pid.update(10.0f, 8.0f, dt_s));
+    TEST_ASSERT_EQUAL_FLOAT(8.0f, pid.update(10.0f, 8.0f, dt_s));
+    TEST_ASSERT_EQUAL_FLOAT(8.0f, pid.get_output());
+    // Integral is kept when the error is zero
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, pid.update(10.0f, 10.0f, dt_s));
+}
+
+/* Output rises when the measurement is above the setpoint, e.g. for
+ * the heatsink fan
+ */
+void test_reverse_acting() {
+    auto pid = PIDController{PIDParams{0.5f, 0.1f, 0.0f, 0.0f, 10.0f, true}};
+    TEST_ASSERT_EQUAL_FLOAT(0.6f, pid.update(40.0f, 41.0f, dt_s));
+    TEST_ASSERT_EQUAL_FLOAT(1.3f, pid.update(40.0f, 42.0f, dt_s));
+    // Measurement below setpoint winds the integral down
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, pid.update(40.0f, 39.0f, dt_s));
+}
+
+/* While saturated high, the integral does not wind up, so the output
+ * leaves saturation as soon as the error has become small
+ */
+void test_anti_windup_high() {
+    auto pid = PIDController{PIDParams{1.0f, 0.1f, 0.0f, 0.0f, 1.0f, false}};
+    for (auto i = 0; i < 100; ++i) {
+        TEST_ASSERT_EQUAL_FLOAT(1.0f, pid.update(5.0f, 0.0f, dt_s));
+    }
+    // P: 0.5, I: 0.1 * 0.5 * 1 s, integrated from zero
+    TEST_ASSERT_EQUAL_FLOAT(0.55f, pid.update(0.5f, 0.0f, dt_s));
+}
+
+void test_anti_windup_low() {
+    auto pid = PIDController{PIDParams{1.0f, 0.1f, 0.0f, -1.0f, 1.0f, false}};
+    pid.reset(0.2f);
+    for (auto i = 0; i < 100; ++i) {
+        TEST_ASSERT_EQUAL_FLOAT(-1.0f, pid.update(0.0f, 5.0f, dt_s));
+    }
+    // P: -0.5, I: 0.2 - 0.1 * 0.5 * 1 s
+    TEST_ASSERT_EQUAL_FLOAT(-0.35f, pid.update(0.0f, 0.5f, dt_s));
+}
+
+/* While saturated, the integral is still integrated in the direction
+ * leading out of saturation
+ */
+void test_saturated_integral_winds_down() {
+    auto pid = PIDController{PIDParams{0.0f, 1.0f, 4.0f, -1.0f, 1.0f, false}};
+    pid.reset(1.0f);
+    TEST_ASSERT_EQUAL_FLOAT(0.9f, pid.update(0.0f, 1.0f, 0.1f));
+    // Falling measurement, the D term keeps the output saturated high
+    // while the negative error is integrated
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, pid.update(0.0f, 0.5f, dt_s));
+    // I: 0.9 - 0.5 - 0.5
+    TEST_ASSERT_EQUAL_FLOAT(-0.1f, pid.update(0.0f, 0.5f, dt_s));
+}
+
+/* The derivative acts on the measurement only, setpoint steps do not
+ * cause an output spike
+ */
+void test_derivative_on_measurement() {
+    auto pid = PIDController{PIDParams{0.0f, 0.0f, 1.0f, -100.0f, 100.0f, false}};
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, pid.update(0.0f, 5.0f, dt_s));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, pid.update(10.0f, 5.0f, dt_s));
+    TEST_ASSERT_EQUAL_FLOAT(-1.0f, pid.update(10.0f, 6.0f, dt_s));
+    // No derivative after a reset
+    pid.reset();
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, pid.update(10.0f, 20.0f, dt_s));
+}
+
+void test_reset_clamps_to_limits() {
+    auto pid = PIDController{PIDParams{0.0f, 1.0f, 0.0f, 0.0f, 1.0f, false}};
+    pid.reset(5.0f);
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, pid.get_output());
+    pid.reset(-5.0f);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, pid.get_output());
+}
+
+
+void test_time_proportioning() {
+    auto out = TimeProportioningOutput{1000, 100};
+    TEST_ASSERT_TRUE(out.update(0.5f, 0));
+    TEST_ASSERT_TRUE(out.update(0.5f, 499999));
+    TEST_ASSERT_FALSE(out.update(0.5f, 500000));
+    TEST_ASSERT_FALSE(out.update(0.5f, 999999));
+    // Next window
+    TEST_ASSERT_TRUE(out.update(0.5f, 1000000));
+    TEST_ASSERT_FALSE(out.update(0.25f, 1250000));
+}
+
+/* On and off times shorter than the minimum switching time are avoided
+ */
+void test_time_proportioning_min_switch_time() {
+    auto out = TimeProportioningOutput{1000, 100};
+    // 50 ms on time is not switched on
+    TEST_ASSERT_FALSE(out.update(0.05f, 0));
+    TEST_ASSERT_FALSE(out.update(0.05f, 10000));
+    // 100 ms on time is
+    TEST_ASSERT_TRUE(out.update(0.1f, 99999));
+    TEST_ASSERT_FALSE(out.update(0.1f, 100000));
+    // 50 ms off time is not switched off
+    TEST_ASSERT_TRUE(out.update(0.95f, 999999));
+    // 100 ms off time is
+    TEST_ASSERT_FALSE(out.update(0.9f, 1950000));
+    // Out of range duty is limited
+    TEST_ASSERT_TRUE(out.update(2.0f, 2999999));
+    TEST_ASSERT_FALSE(out.update(-1.0f, 3000000));
+}
+
+/* Missed updates keep the phase of the switching windows
+ */
+void test_time_proportioning_keeps_window_phase() {
+    auto out = TimeProportioningOutput{1000, 100};
+    TEST_ASSERT_TRUE(out.update(0.5f, 0));
+    TEST_ASSERT_TRUE(out.update(0.5f, 5300000));
+    TEST_ASSERT_FALSE(out.update(0.5f, 5600000));
+    TEST_ASSERT_TRUE(out.update(0.5f, 6000000));
+}
+
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_pi_output);
+    RUN_TEST(test_reverse_acting);
+    RUN_TEST(test_anti_windup_high);
+    RUN_TEST(test_anti_windup_low);
+    RUN_TEST(test_saturated_integral_winds_down);
+    RUN_TEST(test_derivative_on_measurement);
+    RUN_TEST(test_reset_clamps_to_limits);
+    RUN_TEST(test_time_proportioning);
+    RUN_TEST(test_time_proportioning_min_switch_time);
+    RUN_TEST(test_time_proportioning_keeps_window_phase);
+    return UNITY_END();
+}
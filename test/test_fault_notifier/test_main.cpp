@@ -0,0 +1,111 @@
+/* Host tests for the FaultNotifier, using the GPIO stand-in as the fault
+ * edge source and the esp_timer stand-in clock for the latency
+ *
+ * License: GPL v.3
+ */
+#include <unity.h>
+
+#include "../../main/fault_notifier.cpp"
+
+static constexpr auto fault_gpio = GPIO_NUM_4;
+static constexpr uint32_t hw_fault_bit = 1u << 6;
+
+
+void setUp(void) {
+    EspTimerStandIn::reset();
+    GpioStandIn::reset();
+}
+
+void tearDown(void) {}
+
+
+void test_begin_configures_interrupt() {
+    auto task = TaskStandIn{};
+    auto notifier = FaultNotifier{};
+    TEST_ASSERT_EQUAL(ESP_OK, notifier.begin(fault_gpio, true, &task, hw_fault_bit));
+    TEST_ASSERT_EQUAL(GPIO_INTR_NEGEDGE, GpioStandIn::pins[fault_gpio].intr_type);
+    TEST_ASSERT_TRUE(GpioStandIn::pins[fault_gpio].intr_enabled);
+    // A second instance shares the already installed ISR service
+    auto other_task = TaskStandIn{};
+    auto other = FaultNotifier{};
+    TEST_ASSERT_EQUAL(ESP_OK, other.begin(GPIO_NUM_0, false, &other_task, hw_fault_bit));
+    TEST_ASSERT_EQUAL(GPIO_INTR_POSEDGE, GpioStandIn::pins[GPIO_NUM_0].intr_type);
+}
+
+void test_edge_notifies_task_with_latency() {
+    auto task = TaskStandIn{};
+    auto notifier = FaultNotifier{};
+    notifier.begin(fault_gpio, true, &task, hw_fault_bit);
+    EspTimerStandIn::advance_to(1000);
+    TEST_ASSERT_TRUE(GpioStandIn::trigger(fault_gpio));
+    TEST_ASSERT_EQUAL(1, task.n_notifications);
+    TEST_ASSERT_EQUAL(hw_fault_bit, task.notified_value);
+    auto event = FaultEvent{};
+    TEST_ASSERT_TRUE(notifier.take_event(1250, &event));
+    TEST_ASSERT_EQUAL(1000, event.fault_time_us);
+    TEST_ASSERT_EQUAL(250, event.latency_us);
+    TEST_ASSERT_EQUAL(1, event.count);
+    // Nothing pending anymore
+    TEST_ASSERT_FALSE(notifier.take_event(1300, &event));
+    TEST_ASSERT_EQUAL(0, event.latency_us);
+}
+
+void test_edges_before_take_are_merged() {
+    auto task = TaskStandIn{};
+    auto notifier = FaultNotifier{};
+    notifier.begin(fault_gpio, true, &task, hw_fault_bit);
+    EspTimerStandIn::advance_to(100);
+    GpioStandIn::trigger(fault_gpio);
+    EspTimerStandIn::advance_to(150);
+    GpioStandIn::trigger(fault_gpio);
+    GpioStandIn::trigger(fault_gpio);
+    // Only the first edge notifies, its time is kept
+    TEST_ASSERT_EQUAL(1, task.n_notifications);
+    auto event = FaultEvent{};
+    TEST_ASSERT_TRUE(notifier.take_event(200, &event));
+    TEST_ASSERT_EQUAL(100, event.fault_time_us);
+    TEST_ASSERT_EQUAL(100, event.latency_us);
+    TEST_ASSERT_EQUAL(3, event.count);
+    // Next edge is a new event again, the count continues
+    EspTimerStandIn::advance_to(500);
+    GpioStandIn::trigger(fault_gpio);
+    TEST_ASSERT_EQUAL(2, task.n_notifications);
+    TEST_ASSERT_TRUE(notifier.take_event(510, &event));
+    TEST_ASSERT_EQUAL(500, event.fault_time_us);
+    TEST_ASSERT_EQUAL(4, event.count);
+}
+
+void test_simulated_fault_source() {
+    auto task = TaskStandIn{};
+    auto notifier = FaultNotifier{};
+    notifier.begin(fault_gpio, true, &task, hw_fault_bit);
+    TEST_ASSERT_TRUE(notifier.on_fault_edge(2000));
+    TEST_ASSERT_FALSE(notifier.on_fault_edge(2010));
+    // Called from task context, there is no notification
+    TEST_ASSERT_EQUAL(0, task.n_notifications);
+    auto event = FaultEvent{};
+    TEST_ASSERT_TRUE(notifier.take_event(2040, &event));
+    TEST_ASSERT_EQUAL(40, event.latency_us);
+    TEST_ASSERT_EQUAL(2, event.count);
+}
+
+void test_destructor_removes_handler() {
+    auto task = TaskStandIn{};
+    {
+        auto notifier = FaultNotifier{};
+        notifier.begin(fault_gpio, true, &task, hw_fault_bit);
+    }
+    TEST_ASSERT_NULL(GpioStandIn::pins[fault_gpio].handler);
+    TEST_ASSERT_FALSE(GpioStandIn::trigger(fault_gpio));
+}
+
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_begin_configures_interrupt);
+    RUN_TEST(test_edge_notifies_task_with_latency);
+    RUN_TEST(test_edges_before_take_are_merged);
+    RUN_TEST(test_simulated_fault_source);
+    RUN_TEST(test_destructor_removes_handler);
+    return UNITY_END();
+}
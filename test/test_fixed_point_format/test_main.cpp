@@ -0,0 +1,139 @@
+/* Host tests for FixedPoint::format(), compared with printf("%.*f")
+ *
+ * License: GPL v.3
+ */
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <unity.h>
+
+#include "fixed_point_format.hpp"
+
+using FixedPoint::max_decimal_places;
+
+static constexpr int n_random_values = 200000;
+
+/* Reference conversion. The double conversion of the float is exact, so
+ * printf rounds the exact binary value, like FixedPoint::format().
+ *
+ * Two differences are expected and normalized here: printf rounds exact
+ * ties to even, FixedPoint away from zero, and printf writes a sign for
+ * negative values rounding to zero.
+ *
+ * @return false for exact ties, which are checked separately
+ */
+static bool format_reference(char *buf, size_t len, float value, uint8_t decimal_places) {
+    const auto scaled = std::fabs(static_cast<double>(value))
+                        * std::pow(10.0, decimal_places);
+    // Exact for all tested values, as the product has less than 53 bits
+    if (scaled - std::floor(scaled) == 0.5) {
+        return false;
+    }
+    snprintf(buf, len, "%.*f", decimal_places, static_cast<double>(value));
+    if (buf[0] == '-' && std::strspn(buf + 1, "0.") == std::strlen(buf + 1)) {
+        std::memmove(buf, buf + 1, std::strlen(buf));
+    }
+    return true;
+}
+
+static void check_against_printf(float value, uint8_t decimal_places) {
+    auto expected = std::array<char, 64>{};
+    if (!format_reference(expected.data(), expected.size(), value, decimal_places)) {
+        return;
+    }
+    auto buf = std::array<char, FixedPoint::max_len(max_decimal_places) + 1>{};
+    const auto len = FixedPoint::format(buf.data(), value, decimal_places);
+    if (std::strcmp(expected.data(), buf.data()) != 0) {
+        auto message = std::array<char, 128>{};
+        snprintf(message.data(), message.size(), "%.9g with %u places: \"%s\", expected \"%s\"",
+                 value, decimal_places, buf.data(), expected.data());
+        TEST_FAIL_MESSAGE(message.data());
+    }
+    TEST_ASSERT_EQUAL(std::strlen(expected.data()), len);
+    TEST_ASSERT_LESS_OR_EQUAL(FixedPoint::max_len(decimal_places), len);
+}
+
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+
+void test_examples() {
+    TEST_ASSERT_EQUAL_STRING("-12.340", FixedPoint::Text(-12.34f, 3).c_str());
+    TEST_ASSERT_EQUAL_STRING("0", FixedPoint::Text(0.0f, 0).c_str());
+    TEST_ASSERT_EQUAL_STRING("0.00", FixedPoint::Text(-0.001f, 2).c_str());
+    TEST_ASSERT_EQUAL_STRING("1.000", FixedPoint::Text(0.9999f, 3).c_str());
+    TEST_ASSERT_EQUAL_STRING("100000.000000000", FixedPoint::Text(1e5f, 9).c_str());
+}
+
+void test_ties_round_away_from_zero() {
+    TEST_ASSERT_EQUAL_STRING("1", FixedPoint::Text(0.5f, 0).c_str());
+    TEST_ASSERT_EQUAL_STRING("3", FixedPoint::Text(2.5f, 0).c_str());
+    TEST_ASSERT_EQUAL_STRING("-0.13", FixedPoint::Text(-0.125f, 2).c_str());
+    TEST_ASSERT_EQUAL_STRING("0.38", FixedPoint::Text(0.375f, 2).c_str());
+}
+
+void test_non_finite_and_out_of_range() {
+    auto buf = std::array<char, FixedPoint::max_len(max_decimal_places) + 1>{};
+    buf[0] = 'x';
+    const float invalid[] = {
+        NAN, INFINITY, -INFINITY, FixedPoint::max_abs, -FixedPoint::max_abs, 3e38f};
+    for (auto value : invalid) {
+        TEST_ASSERT_EQUAL(0, FixedPoint::format(buf.data(), value, 3));
+        TEST_ASSERT_EQUAL_STRING("", buf.data());
+    }
+}
+
+void test_decimal_places_are_limited() {
+    auto buf = std::array<char, FixedPoint::max_len(max_decimal_places) + 1>{};
+    FixedPoint::format(buf.data(), 1.5f, 20);
+    TEST_ASSERT_EQUAL_STRING("1.500000000", buf.data());
+    TEST_ASSERT_EQUAL(FixedPoint::max_len(max_decimal_places), FixedPoint::max_len(20));
+}
+
+void test_boundary_values_against_printf() {
+    const float values[] = {
+        0.0f, -0.0f, 1.0f, -1.0f, 0.1f, 0.7f, 9.9995f, 99.5f,
+        std::numeric_limits<float>::denorm_min(),
+        std::numeric_limits<float>::min(),
+        std::nextafter(FixedPoint::max_abs, 0.0f),
+        -std::nextafter(FixedPoint::max_abs, 0.0f),
+        // Largest values where the integer and fractional part overlap
+        8388607.5f, 16777215.0f, 4294967.0f};
+    for (auto value : values) {
+        for (uint8_t places = 0; places <= max_decimal_places; ++places) {
+            check_against_printf(value, places);
+        }
+    }
+}
+
+void test_random_values_against_printf() {
+    auto rng = std::mt19937{12345};
+    // Uniform in the exponent, covers all code paths
+    auto exponent = std::uniform_real_distribution<float>{-40.0f, 29.8f};
+    auto sign = std::bernoulli_distribution{0.5};
+    auto places = std::uniform_int_distribution<int>{0, max_decimal_places};
+    for (int i = 0; i < n_random_values; ++i) {
+        auto value = std::exp2(exponent(rng)) * (sign(rng) ? -1.0f : 1.0f);
+        if (std::fabs(value) >= FixedPoint::max_abs) {
+            continue;
+        }
+        check_against_printf(value, static_cast<uint8_t>(places(rng)));
+    }
+}
+
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_examples);
+    RUN_TEST(test_ties_round_away_from_zero);
+    RUN_TEST(test_non_finite_and_out_of_range);
+    RUN_TEST(test_decimal_places_are_limited);
+    RUN_TEST(test_boundary_values_against_printf);
+    RUN_TEST(test_random_values_against_printf);
+    return UNITY_END();
+}
@@ -0,0 +1,177 @@
+/* Host tests for the JsonStreamWriter, and benchmark of the state telegram
+ * written by AppState::serialize_snapshot() compared with serializing the
+ * same state_schema fields using ArduinoJson
+ *
+ * License: GPL v.3
+ */
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <unity.h>
+
+#include "ArduinoJson.h"
+
+#include "../../main/json_stream_writer.cpp"
+#include "../../main/app_state_model.cpp"
+// fs_io.cpp has its own static log tag
+#define TAG fs_io_TAG
+#include "../../main/fs_io.cpp"
+#undef TAG
+
+static constexpr size_t buf_len = AppState::json_buf_len;
+static constexpr int n_runs = 20000;
+
+static AppStateSnapshot snap{};
+
+
+/* Telegram value of each field, as float
+ */
+static float telegram_value(const StateField &field) {
+    switch (field.type) {
+    case FieldType::boolean: return read_field<bool>(snap, field);
+    case FieldType::uint8: return read_field<uint8_t>(snap, field);
+    case FieldType::uint32: return read_field<uint32_t>(snap, field) * field.scale;
+    case FieldType::float32: return read_field<float>(snap, field) * field.scale;
+    }
+    return NAN;
+}
+
+static size_t write_stream(char *buf, size_t len) {
+    return AppState::serialize_snapshot(snap, buf, len);
+}
+
+/* Same schema-driven telegram, built as an ArduinoJson document
+ */
+static size_t write_arduinojson(char *buf, size_t len) {
+    auto doc = StaticJsonDocument<AppState::json_doc_size>{};
+    for (const auto &field : state_schema) {
+        switch (field.type) {
+        case FieldType::boolean:
+            doc[field.key] = read_field<bool>(snap, field);
+            break;
+        case FieldType::uint8:
+            doc[field.key] = uint32_t{read_field<uint8_t>(snap, field)};
+            break;
+        case FieldType::uint32:
+            if (field.scale == 1.0f) {
+                doc[field.key] = read_field<uint32_t>(snap, field);
+            } else {
+                doc[field.key] = read_field<uint32_t>(snap, field) * field.scale;
+            }
+            break;
+        case FieldType::float32:
+            doc[field.key] = read_field<float>(snap, field) * field.scale;
+            break;
+        }
+    }
+    return serializeJson(doc, buf, len);
+}
+
+// Output lengths are summed up here so the loop can not be optimized away
+static volatile size_t total_len = 0;
+
+/* Mean run time in ns
+ */
+template<typename TFn>
+static double benchmark(TFn fn, char *buf, size_t len) {
+    const auto t_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n_runs; ++i) {
+        total_len = total_len + fn(buf, len);
+    }
+    const auto t_end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t_end - t_start).count() / n_runs;
+}
+
+
+/* Fills all fields with values of different magnitude and sign,
+ * in telegram units
+ */
+void setUp(void) {
+    snap = AppStateSnapshot{};
+    auto i = 0u;
+    for (const auto &field : state_schema) {
+        switch (field.type) {
+        case FieldType::boolean:
+            write_snapshot_field(snap, field, i % 2 == 0);
+            break;
+        case FieldType::uint8:
+            write_snapshot_field(snap, field, static_cast<uint8_t>(i));
+            break;
+        case FieldType::uint32:
+            write_snapshot_field(snap, field, uint32_t{1000 * i + 7});
+            break;
+        case FieldType::float32:
+            write_snapshot_field(snap, field, static_cast<float>(
+                (i % 2 ? -1.0f : 1.0f) * 1.2345f * std::pow(3.0f, i % 12) / field.scale));
+            break;
+        }
+        ++i;
+    }
+}
+
+void tearDown(void) {}
+
+
+void test_parses_like_arduinojson_output() {
+    auto buf = std::array<char, buf_len>{};
+    TEST_ASSERT_GREATER_THAN(0, write_stream(buf.data(), buf.size()));
+    auto doc = StaticJsonDocument<AppState::json_doc_size>{};
+    TEST_ASSERT_TRUE(deserializeJson(doc, buf.data()) == DeserializationError::Ok);
+    TEST_ASSERT_EQUAL(AppState::n_state_fields, doc.as<JsonObjectConst>().size());
+    for (const auto &field : state_schema) {
+        const auto value = telegram_value(field);
+        if (field.type == FieldType::boolean) {
+            TEST_ASSERT_EQUAL(value != 0.0f, doc[field.key].as<bool>());
+            continue;
+        }
+        // Rounded to decimal_places
+        const auto tolerance = 0.5f * std::pow(10.0f, -field.decimal_places)
+                               + std::fabs(value) * 1e-6f;
+        TEST_ASSERT_FLOAT_WITHIN(tolerance, value, doc[field.key].as<float>());
+    }
+}
+
+void test_string_value_escaping_round_trip() {
+    const char *text = "quote\" backslash\\ tab\t newline\n bell\x07";
+    auto buf = std::array<char, 128>{};
+    auto writer = JsonStreamWriter{buf.data(), buf.size()};
+    writer.begin_object();
+    writer.key("text");
+    writer.value(text);
+    writer.end_object();
+    TEST_ASSERT_GREATER_THAN(0, writer.finish());
+    auto doc = StaticJsonDocument<256>{};
+    TEST_ASSERT_TRUE(deserializeJson(doc, buf.data()) == DeserializationError::Ok);
+    TEST_ASSERT_EQUAL_STRING(text, doc["text"].as<const char*>());
+}
+
+void test_overflow_gives_empty_output() {
+    auto buf = std::array<char, 64>{};
+    TEST_ASSERT_EQUAL(0, write_stream(buf.data(), buf.size()));
+    TEST_ASSERT_EQUAL_STRING("", buf.data());
+}
+
+/* Timing is only reported, as it depends on the host. The ratio is what
+ * matters, the ESP32 result must be measured on the target.
+ */
+void test_benchmark_against_arduinojson() {
+    auto buf = std::array<char, buf_len>{};
+    const auto t_stream_ns = benchmark(write_stream, buf.data(), buf.size());
+    const auto t_arduinojson_ns = benchmark(write_arduinojson, buf.data(), buf.size());
+    auto message = std::array<char, 128>{};
+    snprintf(message.data(), message.size(),
+             "serialize_snapshot: %.0f ns, ArduinoJson: %.0f ns, ratio: %.2f",
+             t_stream_ns, t_arduinojson_ns, t_arduinojson_ns / t_stream_ns);
+    TEST_MESSAGE(message.data());
+}
+
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_parses_like_arduinojson_output);
+    RUN_TEST(test_string_value_escaping_round_trip);
+    RUN_TEST(test_overflow_gives_empty_output);
+    RUN_TEST(test_benchmark_against_arduinojson);
+    return UNITY_END();
+}
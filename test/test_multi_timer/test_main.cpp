@@ -0,0 +1,166 @@
+/* Host tests for the MultiTimer repeat state machine, using the esp_timer
+ * stand-in with a simulated clock, see test/stand_ins/esp_timer.h
+ *
+ * License: GPL v.3
+ */
+#include <array>
+#include <unity.h>
+
+#include "multi_timer.hpp"
+
+struct CallLog {
+    static constexpr size_t max_calls = 8;
+    size_t n_calls = 0;
+    std::array<int64_t, max_calls> times_us{};
+    std::array<uint32_t, max_calls> counts{};
+
+    void record(uint32_t count) {
+        TEST_ASSERT_TRUE(n_calls < max_calls);
+        times_us[n_calls] = esp_timer_get_time();
+        counts[n_calls] = count;
+        ++n_calls;
+    }
+};
+
+static void on_tick_with_count(CallLog *log, uint32_t count) {
+    log->record(count);
+}
+
+static void on_tick(CallLog *log) {
+    log->record(0);
+}
+
+static CallLog static_log;
+static void on_tick_without_arg() {
+    static_log.record(0);
+}
+
+class Sequencer {
+public:
+    CallLog log;
+    MultiTimerNonStatic<Sequencer> timer;
+
+    void on_step(uint32_t count) {
+        log.record(count);
+    }
+};
+
+
+void setUp(void) {
+    EspTimerStandIn::reset();
+    static_log = CallLog{};
+}
+
+void tearDown(void) {}
+
+
+void test_repeats_with_count() {
+    auto log = CallLog{};
+    auto timer = MultiTimer{};
+    TEST_ASSERT_EQUAL(ESP_OK, timer.attach_static_us<CallLog*>(50, 3, on_tick_with_count, &log));
+    TEST_ASSERT_EQUAL(0, EspTimerStandIn::n_armed());
+    timer.start();
+    EspTimerStandIn::advance_to(1000);
+    TEST_ASSERT_EQUAL(3, log.n_calls);
+    for (size_t i = 0; i < 3; ++i) {
+        TEST_ASSERT_EQUAL(50 * (i + 1), log.times_us[i]);
+        TEST_ASSERT_EQUAL(i + 1, log.counts[i]);
+    }
+    // Timer stopped after the last repeat, but can be started again
+    TEST_ASSERT_EQUAL(0, EspTimerStandIn::n_armed());
+    timer.start();
+    EspTimerStandIn::advance_to(2000);
+    TEST_ASSERT_EQUAL(6, log.n_calls);
+    TEST_ASSERT_EQUAL(1, log.counts[3]);
+    TEST_ASSERT_EQUAL(1050, log.times_us[3]);
+}
+
+void test_first_tick_nodelay() {
+    auto log = CallLog{};
+    auto timer = MultiTimer{};
+    timer.attach_static_us<CallLog*>(20, 2, on_tick_with_count, &log, true);
+    EspTimerStandIn::advance_to(100);
+    timer.start();
+    TEST_ASSERT_EQUAL(1, log.n_calls);
+    TEST_ASSERT_EQUAL(100, log.times_us[0]);
+    EspTimerStandIn::advance_to(1000);
+    TEST_ASSERT_EQUAL(2, log.n_calls);
+    TEST_ASSERT_EQUAL(120, log.times_us[1]);
+    TEST_ASSERT_EQUAL(2, log.counts[1]);
+}
+
+void test_callback_overloads() {
+    auto log = CallLog{};
+    auto timer_with_arg = MultiTimer{};
+    auto timer_without_arg = MultiTimer{};
+    timer_with_arg.attach_static_ms<CallLog*>(1, 2, on_tick, &log);
+    timer_without_arg.attach_static_us(300, 1, on_tick_without_arg);
+    timer_with_arg.start();
+    timer_without_arg.start();
+    EspTimerStandIn::advance_to(10000);
+    TEST_ASSERT_EQUAL(2, log.n_calls);
+    TEST_ASSERT_EQUAL(1000, log.times_us[0]);
+    TEST_ASSERT_EQUAL(2000, log.times_us[1]);
+    TEST_ASSERT_EQUAL(1, static_log.n_calls);
+    TEST_ASSERT_EQUAL(300, static_log.times_us[0]);
+}
+
+void test_stop_resets_and_pause_keeps_repeats() {
+    auto log = CallLog{};
+    auto timer = MultiTimer{};
+    timer.attach_static_us<CallLog*>(10, 4, on_tick_with_count, &log);
+    timer.start();
+    EspTimerStandIn::advance_to(25);
+    TEST_ASSERT_EQUAL(2, log.n_calls);
+    timer.pause();
+    EspTimerStandIn::advance_to(100);
+    TEST_ASSERT_EQUAL(2, log.n_calls);
+    timer.resume();
+    EspTimerStandIn::advance_to(115);
+    TEST_ASSERT_EQUAL(3, log.n_calls);
+    TEST_ASSERT_EQUAL(3, log.counts[2]);
+    timer.stop();
+    timer.start();
+    EspTimerStandIn::advance_to(1000);
+    // Counting starts again after stop()
+    TEST_ASSERT_EQUAL(7, log.n_calls);
+    TEST_ASSERT_EQUAL(1, log.counts[3]);
+    TEST_ASSERT_EQUAL(4, log.counts[6]);
+}
+
+void test_member_function() {
+    auto seq = Sequencer{};
+    TEST_ASSERT_EQUAL(ESP_OK, seq.timer.attach_mem_func_ptr_ms(2, 3, &Sequencer::on_step, &seq));
+    TEST_ASSERT_EQUAL(ESP_TIMER_TASK, EspTimerStandIn::timers[0].dispatch_method);
+    seq.timer.start();
+    EspTimerStandIn::advance_to(10000);
+    TEST_ASSERT_EQUAL(3, seq.log.n_calls);
+    TEST_ASSERT_EQUAL(6000, seq.log.times_us[2]);
+    TEST_ASSERT_EQUAL(3, seq.log.counts[2]);
+}
+
+void test_reattach_replaces_timer() {
+    auto log = CallLog{};
+    auto timer = MultiTimer{};
+    timer.attach_static_us<CallLog*>(10, 1, on_tick_with_count, &log);
+    timer.start();
+    timer.attach_static_us<CallLog*>(30, 1, on_tick_with_count, &log);
+    timer.start();
+    EspTimerStandIn::advance_to(1000);
+    TEST_ASSERT_EQUAL(1, log.n_calls);
+    TEST_ASSERT_EQUAL(30, log.times_us[0]);
+    timer.detach();
+    TEST_ASSERT_FALSE(timer.active());
+}
+
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_repeats_with_count);
+    RUN_TEST(test_first_tick_nodelay);
+    RUN_TEST(test_callback_overloads);
+    RUN_TEST(test_stop_resets_and_pause_keeps_repeats);
+    RUN_TEST(test_member_function);
+    RUN_TEST(test_reattach_replaces_timer);
+    return UNITY_END();
+}
@@ -0,0 +1,172 @@
+/* Host tests and lookup benchmark for the PerfectHashTable
+ *
+ * The "/cmd" table itself is checked at compile time by the static_assert
+ * in api_cmd_table.hpp. Here, the hash is checked for random key sets of
+ * all supported sizes and compared with a linear search.
+ *
+ * License: GPL v.3
+ */
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include <unity.h>
+
+#include "perfect_hash_table.hpp"
+
+struct Entry {
+    const char *name;
+    int id;
+};
+
+// "/cmd" names, i.e. the AppCmd names, see app_cmd.hpp
+static constexpr std::array<Entry, 29> cmd_entries{{
+    {"set_setpoint_throttling_enabled", 0}, {"set_frequency_min", 1},
+    {"set_frequency_max", 2}, {"set_frequency", 3}, {"set_frequency_changerate", 4},
+    {"set_duty_min", 5}, {"set_duty_max", 6}, {"set_duty", 7},
+    {"set_duty_changerate", 8}, {"set_ramp_profile", 9}, {"set_lag_dt", 10},
+    {"set_lead_dt", 11}, {"set_power_pwm_active", 12}, {"set_oneshot_len", 13},
+    {"trigger_oneshot", 14}, {"clear_shutdown", 15}, {"set_current_limit", 16},
+    {"set_temp_1_limit", 17}, {"set_temp_2_limit", 18}, {"set_relay_ref_active", 19},
+    {"set_relay_dut_active", 20}, {"set_fan_override", 21}, {"set_fan_setpoint", 22},
+    {"set_fan_kp", 23}, {"set_fan_ki", 24}, {"save_settings", 25},
+    {"sequencer_start", 26}, {"sequencer_stop", 27}, {"set_sequencer_loop", 28}}};
+
+static constexpr auto cmd_table = PerfectHashTable<Entry, cmd_entries.size()>{cmd_entries};
+static_assert(cmd_table.is_valid(), "No seed found for the command names");
+
+static constexpr int n_lookups = 1000000;
+
+
+/* Linear search like the former "/cmd" dispatch
+ */
+static const Entry *find_linear(const char *key, size_t key_len) {
+    for (const auto &entry : cmd_entries) {
+        if (std::strlen(entry.name) == key_len
+                && std::memcmp(entry.name, key, key_len) == 0) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+/* Checks that every key has its own slot and is found
+ */
+template<size_t n_entries>
+static void check_random_keys(std::mt19937 &rng) {
+    auto length = std::uniform_int_distribution<int>{1, 32};
+    auto character = std::uniform_int_distribution<int>{'_', 'z'};
+    auto names = std::vector<std::string>{};
+    auto entries = std::array<Entry, n_entries>{};
+    while (names.size() < n_entries) {
+        auto name = std::string("set_");
+        for (auto n = length(rng); n > 0; --n) {
+            name += static_cast<char>(character(rng));
+        }
+        if (std::find(names.begin(), names.end(), name) == names.end()) {
+            names.push_back(name);
+        }
+    }
+    for (size_t i = 0; i < n_entries; ++i) {
+        entries[i] = Entry{names[i].c_str(), static_cast<int>(i)};
+    }
+    const auto table = PerfectHashTable<Entry, n_entries>{entries};
+    TEST_ASSERT_TRUE_MESSAGE(table.is_valid(), "No seed found");
+    for (size_t i = 0; i < n_entries; ++i) {
+        const auto entry = table.find(names[i].data(), names[i].size());
+        TEST_ASSERT_NOT_NULL(entry);
+        TEST_ASSERT_EQUAL(i, entry->id);
+    }
+}
+
+template<size_t... sizes>
+static void check_random_key_sets(std::mt19937 &rng, std::index_sequence<sizes...>) {
+    (check_random_keys<sizes + 1>(rng), ...);
+}
+
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+
+void test_all_commands_found() {
+    for (const auto &entry : cmd_entries) {
+        const auto found = cmd_table.find(entry.name, std::strlen(entry.name));
+        TEST_ASSERT_NOT_NULL(found);
+        TEST_ASSERT_EQUAL(entry.id, found->id);
+    }
+}
+
+void test_unknown_keys_not_found() {
+    const char *unknown[] = {"", "set_dut", "set_duty_", "SET_DUTY", "set_dutz",
+                             "set_frequency_minimum", "x"};
+    for (auto key : unknown) {
+        TEST_ASSERT_NULL(cmd_table.find(key, std::strlen(key)));
+    }
+    // Keys need not be null-terminated, e.g. parts of a request body
+    const char *body = "set_duty=50&set_frequency=100";
+    const auto entry = cmd_table.find(body, 8);
+    TEST_ASSERT_NOT_NULL(entry);
+    TEST_ASSERT_EQUAL(7, entry->id);
+}
+
+void test_duplicate_keys_are_invalid() {
+    constexpr auto table = PerfectHashTable<Entry, 3>{
+        std::array<Entry, 3>{{{"set_duty", 0}, {"set_lag_dt", 1}, {"set_duty", 2}}}};
+    static_assert(!table.is_valid());
+}
+
+void test_random_key_sets_collision_free() {
+    auto rng = std::mt19937{12345};
+    // All supported table sizes, 1...254 entries
+    check_random_key_sets(rng, std::make_index_sequence<254>{});
+}
+
+/* Timing is only reported, as it depends on the host
+ */
+void test_benchmark_against_linear_search() {
+    auto keys = std::array<std::string, cmd_entries.size()>{};
+    for (size_t i = 0; i < keys.size(); ++i) {
+        keys[i] = cmd_entries[i].name;
+    }
+    auto id_sum = 0;
+    auto t_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n_lookups; ++i) {
+        const auto &key = keys[i % keys.size()];
+        id_sum += cmd_table.find(key.data(), key.size())->id;
+    }
+    const auto t_hash = std::chrono::steady_clock::now() - t_start;
+    t_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n_lookups; ++i) {
+        const auto &key = keys[i % keys.size()];
+        id_sum -= find_linear(key.data(), key.size())->id;
+    }
+    const auto t_linear = std::chrono::steady_clock::now() - t_start;
+    // Also keeps the loops from being optimized away
+    TEST_ASSERT_EQUAL(0, id_sum);
+    const auto t_hash_ns = std::chrono::duration<double, std::nano>(t_hash).count() / n_lookups;
+    const auto t_linear_ns = std::chrono::duration<double, std::nano>(t_linear).count()
+                             / n_lookups;
+    auto message = std::array<char, 128>{};
+    snprintf(message.data(), message.size(),
+             "Perfect hash: %.1f ns, linear search: %.1f ns, ratio: %.2f",
+             t_hash_ns, t_linear_ns, t_linear_ns / t_hash_ns);
+    TEST_MESSAGE(message.data());
+}
+
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_all_commands_found);
+    RUN_TEST(test_unknown_keys_not_found);
+    RUN_TEST(test_duplicate_keys_are_invalid);
+    RUN_TEST(test_random_key_sets_collision_free);
+    RUN_TEST(test_benchmark_against_linear_search);
+    return UNITY_END();
+}
@@ -0,0 +1,179 @@
+/* Host tests for the setpoint ramp generator, using a stand-in for the
+ * PWM setpoint output and the esp_timer stand-in with a simulated clock
+ *
+ * License: GPL v.3
+ */
+#include <cmath>
+#include <unity.h>
+
+#include "../../main/ramp_generator.cpp"
+
+/* Stand-in for the pspwm_set_xxx() setpoint output functions
+ */
+struct OutputStandIn {
+    uint32_t n_writes = 0;
+    float value = 0.0f;
+    float max_change = 0.0f;
+    bool is_monotonic = true;
+    float last_change = 0.0f;
+
+    static void write(float value, void *self) {
+        static_cast<OutputStandIn*>(self)->record(value);
+    }
+
+    void record(float new_value) {
+        const auto change = new_value - value;
+        if (n_writes > 0) {
+            max_change = std::max(max_change, std::fabs(change));
+            if (change * last_change < 0.0f) {
+                is_monotonic = false;
+            }
+            last_change = change;
+        }
+        value = new_value;
+        ++n_writes;
+    }
+};
+
+/* Application task stand-in, does the steps immediately when woken
+ */
+static void run_immediately(void *generator) {
+    static_cast<RampGenerator*>(generator)->run_due(esp_timer_get_time());
+}
+
+static uint32_t n_finished = 0;
+static void on_finished(void*) {
+    ++n_finished;
+}
+
+static void do_nothing(void*) {}
+
+// 1 ms step interval as configured in app_config.hpp
+static constexpr uint32_t step_us = 1000;
+
+
+void setUp(void) {
+    EspTimerStandIn::reset();
+    n_finished = 0;
+}
+
+void tearDown(void) {}
+
+
+void test_linear_ramp() {
+    auto output = OutputStandIn{};
+    auto generator = RampGenerator{};
+    auto axis = RampAxis{OutputStandIn::write, &output};
+    TEST_ASSERT_EQUAL(ESP_OK, generator.begin(step_us, run_immediately, &generator,
+                                              on_finished, nullptr));
+    TEST_ASSERT_EQUAL(ESP_TIMER_ISR, EspTimerStandIn::timers[0].dispatch_method);
+    generator.add_axis(axis);
+    generator.jump_to(axis, 100.0f);
+    output = OutputStandIn{};
+    // 1000 units per second, i.e. one unit per step
+    generator.set_rate(axis, 1000.0f);
+    generator.set_target(axis, 110.0f);
+    TEST_ASSERT_TRUE(generator.is_active());
+    EspTimerStandIn::advance_by(9 * step_us);
+    TEST_ASSERT_EQUAL_FLOAT(109.0f, output.value);
+    TEST_ASSERT_TRUE(generator.is_active());
+    EspTimerStandIn::advance_by(step_us);
+    TEST_ASSERT_EQUAL_FLOAT(110.0f, output.value);
+    TEST_ASSERT_EQUAL(10, output.n_writes);
+    TEST_ASSERT_FALSE(generator.is_active());
+    TEST_ASSERT_EQUAL(1, n_finished);
+    TEST_ASSERT_EQUAL(0, EspTimerStandIn::n_armed());
+    TEST_ASSERT_EQUAL(0, generator.get_missed_steps());
+}
+
+void test_zero_rate_jumps_and_stops_timer() {
+    auto output = OutputStandIn{};
+    auto generator = RampGenerator{};
+    auto axis = RampAxis{OutputStandIn::write, &output};
+    generator.begin(step_us, run_immediately, &generator);
+    generator.add_axis(axis);
+    for (auto profile : {RampProfile::linear, RampProfile::s_curve,
+                         RampProfile::exponential}) {
+        generator.configure(profile, 40000, 100000);
+        generator.set_rate(axis, 0.0f);
+        const auto target = output.value + 50.0f;
+        generator.set_target(axis, target);
+        EspTimerStandIn::advance_by(step_us);
+        TEST_ASSERT_EQUAL_FLOAT(target, output.value);
+        TEST_ASSERT_FALSE(generator.is_active());
+        TEST_ASSERT_EQUAL(0, EspTimerStandIn::n_armed());
+    }
+}
+
+void test_s_curve_is_smooth_and_settles_exactly() {
+    auto output = OutputStandIn{};
+    auto generator = RampGenerator{};
+    auto axis = RampAxis{OutputStandIn::write, &output};
+    generator.begin(step_us, run_immediately, &generator);
+    generator.add_axis(axis);
+    // 20 steps for each filter
+    generator.configure(RampProfile::s_curve, 40000, 100000);
+    generator.set_rate(axis, 1000.0f);
+    generator.set_target(axis, 100.0f);
+    // Linear part takes 100 steps, the filters add up to 40 steps
+    EspTimerStandIn::advance_by(130 * step_us);
+    TEST_ASSERT_TRUE(generator.is_active());
+    EspTimerStandIn::advance_by(11 * step_us);
+    TEST_ASSERT_FALSE(generator.is_active());
+    TEST_ASSERT_EQUAL(100.0f, output.value);
+    TEST_ASSERT_TRUE(output.is_monotonic);
+    TEST_ASSERT_LESS_OR_EQUAL(1.0f + 1e-4f, output.max_change);
+}
+
+void test_exponential_settles() {
+    auto output = OutputStandIn{};
+    auto generator = RampGenerator{};
+    auto axis = RampAxis{OutputStandIn::write, &output};
+    generator.begin(step_us, run_immediately, &generator);
+    generator.add_axis(axis);
+    generator.configure(RampProfile::exponential, 40000, 10000);
+    generator.set_rate(axis, 1000.0f);
+    generator.set_target(axis, -100.0f);
+    EspTimerStandIn::advance_by(1000 * step_us);
+    TEST_ASSERT_FALSE(generator.is_active());
+    TEST_ASSERT_EQUAL(-100.0f, output.value);
+    TEST_ASSERT_TRUE(output.is_monotonic);
+    TEST_ASSERT_LESS_OR_EQUAL(1.0f + 1e-4f, output.max_change);
+}
+
+void test_late_wake_up_catch_up() {
+    auto output = OutputStandIn{};
+    auto generator = RampGenerator{};
+    auto axis = RampAxis{OutputStandIn::write, &output};
+    // Wake-ups are ignored, run_due() is called by the test
+    generator.begin(step_us, do_nothing, nullptr);
+    generator.add_axis(axis);
+    generator.set_rate(axis, 1000.0f);
+    generator.set_catch_up(true, 5);
+    generator.set_target(axis, 100.0f);
+    generator.run_due(4 * step_us + 500);
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, output.value);
+    TEST_ASSERT_EQUAL(3, generator.get_caught_up_steps());
+    // Repeated wake-up without any step due
+    generator.run_due(4 * step_us + 900);
+    TEST_ASSERT_EQUAL(4, output.n_writes);
+    // More steps due than allowed for catching up
+    generator.run_due(12 * step_us);
+    TEST_ASSERT_EQUAL_FLOAT(9.0f, output.value);
+    TEST_ASSERT_EQUAL(3, generator.get_missed_steps());
+    generator.set_catch_up(false, 0);
+    generator.run_due(15 * step_us);
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, output.value);
+    TEST_ASSERT_EQUAL(5, generator.get_missed_steps());
+}
+
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_linear_ramp);
+    RUN_TEST(test_zero_rate_jumps_and_stops_timer);
+    RUN_TEST(test_s_curve_is_smooth_and_settles_exactly);
+    RUN_TEST(test_exponential_settles);
+    RUN_TEST(test_late_wake_up_catch_up);
+    return UNITY_END();
+}
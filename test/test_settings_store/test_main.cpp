@@ -0,0 +1,183 @@
+/* Host tests for the SettingsStore, using the esp_timer stand-in with a
+ * simulated clock and the in-memory NVS stand-in
+ *
+ * License: GPL v.3
+ */
+#include <unity.h>
+
+#include "../../main/json_stream_writer.cpp"
+#include "../../main/app_state_model.cpp"
+// The modules below have their own static log tag
+#define TAG fs_io_TAG
+#include "../../main/fs_io.cpp"
+#undef TAG
+#define TAG settings_store_TAG
+#include "../../main/settings_store.cpp"
+#undef TAG
+
+static constexpr uint32_t save_delay_ms = 500;
+static constexpr uint32_t autosave_delay_ms = 2000;
+
+
+static AppStateSnapshot make_settings(float frequency) {
+    auto settings = AppStateSnapshot{};
+    settings.frequency = frequency;
+    settings.duty = 0.25f;
+    settings.lead_dt = 125e-9f;
+    settings.lag_dt = 125e-9f;
+    return settings;
+}
+
+/* Calls take_due() at the current simulated time
+ */
+static bool take_due_now(SettingsStore &store, AppStateSnapshot *settings,
+                         int64_t *wait_us) {
+    return store.take_due(esp_timer_get_time(), settings, wait_us);
+}
+
+void setUp() {
+    EspTimerStandIn::reset();
+    NvsStandIn::reset();
+}
+
+void tearDown() {}
+
+
+void test_nothing_pending() {
+    auto store = SettingsStore{};
+    auto settings = AppStateSnapshot{};
+    auto wait_us = int64_t{0};
+    TEST_ASSERT_FALSE(take_due_now(store, &settings, &wait_us));
+    TEST_ASSERT_EQUAL(-1, wait_us);
+}
+
+/* Requests in quick succession result in one write of the last settings,
+ * due save_delay_ms after the last request
+ */
+void test_debounce() {
+    auto store = SettingsStore{};
+    auto taken = AppStateSnapshot{};
+    auto wait_us = int64_t{0};
+    for (auto i = 0; i < 3; ++i) {
+        EspTimerStandIn::advance_to(i * 100000);
+        store.request_save(make_settings(100e3f + i * 1e3f), esp_timer_get_time(),
+                           save_delay_ms);
+    }
+    EspTimerStandIn::advance_to(200000 + 499000);
+    TEST_ASSERT_FALSE(take_due_now(store, &taken, &wait_us));
+    TEST_ASSERT_EQUAL(1000, wait_us);
+    EspTimerStandIn::advance_by(wait_us);
+    TEST_ASSERT_TRUE(take_due_now(store, &taken, &wait_us));
+    TEST_ASSERT_EQUAL_FLOAT(102e3f, taken.frequency);
+    TEST_ASSERT_EQUAL(-1, wait_us);
+    // Taken only once
+    TEST_ASSERT_FALSE(take_due_now(store, &taken, &wait_us));
+    TEST_ASSERT_EQUAL(-1, wait_us);
+}
+
+/* An autosave request replaces the settings of a pending explicit save,
+ * but does not postpone it
+ */
+void test_autosave_does_not_postpone_explicit_save() {
+    auto store = SettingsStore{};
+    auto taken = AppStateSnapshot{};
+    auto wait_us = int64_t{0};
+    store.request_save(make_settings(100e3f), esp_timer_get_time(), save_delay_ms);
+    EspTimerStandIn::advance_to(400000);
+    store.request_save(make_settings(110e3f), esp_timer_get_time(),
+                       autosave_delay_ms, true);
+    TEST_ASSERT_FALSE(take_due_now(store, &taken, &wait_us));
+    TEST_ASSERT_EQUAL(100000, wait_us);
+    EspTimerStandIn::advance_to(500000);
+    TEST_ASSERT_TRUE(take_due_now(store, &taken, &wait_us));
+    TEST_ASSERT_EQUAL_FLOAT(110e3f, taken.frequency);
+    // Without a pending explicit save, autosave requests are debounced
+    // using their own delay
+    store.request_save(make_settings(120e3f), esp_timer_get_time(),
+                       autosave_delay_ms, true);
+    EspTimerStandIn::advance_by(1000000);
+    store.request_save(make_settings(130e3f), esp_timer_get_time(),
+                       autosave_delay_ms, true);
+    TEST_ASSERT_FALSE(take_due_now(store, &taken, &wait_us));
+    TEST_ASSERT_EQUAL(int64_t{autosave_delay_ms} * 1000, wait_us);
+}
+
+/* An explicit save requested after an autosave is due after its own delay
+ */
+void test_explicit_save_advances_autosave() {
+    auto store = SettingsStore{};
+    auto taken = AppStateSnapshot{};
+    auto wait_us = int64_t{0};
+    store.request_save(make_settings(100e3f), esp_timer_get_time(),
+                       autosave_delay_ms, true);
+    EspTimerStandIn::advance_to(100000);
+    store.request_save(make_settings(110e3f), esp_timer_get_time(), save_delay_ms);
+    TEST_ASSERT_FALSE(take_due_now(store, &taken, &wait_us));
+    TEST_ASSERT_EQUAL(int64_t{save_delay_ms} * 1000, wait_us);
+    EspTimerStandIn::advance_by(wait_us);
+    TEST_ASSERT_TRUE(take_due_now(store, &taken, &wait_us));
+    TEST_ASSERT_EQUAL_FLOAT(110e3f, taken.frequency);
+}
+
+/* Unchanged settings are not written again. Values which are not persisted
+ * do not count as a change.
+ */
+void test_unchanged_settings_skipped() {
+    auto store = SettingsStore{};
+    auto settings = make_settings(100e3f);
+    TEST_ASSERT_TRUE(store.store(settings));
+    TEST_ASSERT_EQUAL(1, store.get_writes());
+    TEST_ASSERT_EQUAL(1, NvsStandIn::n_set_blob);
+    TEST_ASSERT_FALSE(store.store(settings));
+    settings.fan_duty = 0.5f;
+    settings.power_pwm_active = true;
+    TEST_ASSERT_FALSE(store.store(settings));
+    TEST_ASSERT_EQUAL(1, store.get_writes());
+    TEST_ASSERT_EQUAL(2, store.get_writes_skipped());
+    TEST_ASSERT_EQUAL(1, NvsStandIn::n_set_blob);
+    settings.frequency = 120e3f;
+    TEST_ASSERT_TRUE(store.store(settings));
+    TEST_ASSERT_EQUAL(2, store.get_writes());
+    TEST_ASSERT_EQUAL(2, NvsStandIn::n_set_blob);
+    // Written settings are read back
+    auto restored = AppStateSnapshot{};
+    TEST_ASSERT_EQUAL(ESP_OK, AppState::restore_from_nvs(restored));
+    TEST_ASSERT_EQUAL_FLOAT(120e3f, restored.frequency);
+}
+
+/* begin() reads the stored blob, so saving the same settings after a
+ * restart does not write them again
+ */
+void test_begin_reads_stored_blob() {
+    auto settings = make_settings(100e3f);
+    TEST_ASSERT_TRUE(AppState::save_to_nvs(settings));
+    auto store = SettingsStore{};
+    TEST_ASSERT_EQUAL(ESP_OK, store.begin(3072, 1, PRO_CPU_NUM));
+    TEST_ASSERT_FALSE(store.store(settings));
+    TEST_ASSERT_EQUAL(1, store.get_writes_skipped());
+    TEST_ASSERT_EQUAL(1, NvsStandIn::n_set_blob);
+    // Requests wake the worker task
+    auto &task = TaskStandIn::created.back();
+    store.request_save(settings, esp_timer_get_time(), save_delay_ms);
+    TEST_ASSERT_EQUAL(1, task.n_notifications);
+}
+
+void test_begin_without_stored_blob() {
+    auto store = SettingsStore{};
+    TEST_ASSERT_EQUAL(ESP_OK, store.begin(3072, 1, PRO_CPU_NUM));
+    TEST_ASSERT_TRUE(store.store(make_settings(100e3f)));
+    TEST_ASSERT_EQUAL(1, NvsStandIn::n_set_blob);
+}
+
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_nothing_pending);
+    RUN_TEST(test_debounce);
+    RUN_TEST(test_autosave_does_not_postpone_explicit_save);
+    RUN_TEST(test_explicit_save_advances_autosave);
+    RUN_TEST(test_unchanged_settings_skipped);
+    RUN_TEST(test_begin_reads_stored_blob);
+    RUN_TEST(test_begin_without_stored_blob);
+    return UNITY_END();
+}
@@ -0,0 +1,151 @@
+/* Host tests for the strict text to number and boolean conversion
+ *
+ * License: GPL v.3
+ */
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <unity.h>
+
+#include "strict_parse.hpp"
+
+using namespace StrictParse;
+
+// Value is only written on success, so this shows when it was
+static constexpr int untouched_int = 4711;
+static constexpr float untouched_float = 47.11f;
+
+static void check_int_rejected(const char *text) {
+    auto value = untouched_int;
+    TEST_ASSERT_FALSE_MESSAGE(to_int(text, &value), text);
+    TEST_ASSERT_EQUAL(untouched_int, value);
+}
+
+static void check_float(const char *text, float expected) {
+    auto value = untouched_float;
+    TEST_ASSERT_TRUE_MESSAGE(to_float(text, &value), text);
+    TEST_ASSERT_EQUAL_FLOAT(expected, value);
+}
+
+static void check_float_rejected(const char *text) {
+    auto value = untouched_float;
+    TEST_ASSERT_FALSE_MESSAGE(to_float(text, &value), text);
+    TEST_ASSERT_EQUAL_FLOAT(untouched_float, value);
+}
+
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+
+void test_to_bool() {
+    auto value = false;
+    TEST_ASSERT_TRUE(to_bool("true", &value));
+    TEST_ASSERT_TRUE(value);
+    TEST_ASSERT_TRUE(to_bool("false", &value));
+    TEST_ASSERT_FALSE(value);
+    for (auto text : {"", "1", "True", "TRUE", "true ", " false", "yes"}) {
+        value = true;
+        TEST_ASSERT_FALSE_MESSAGE(to_bool(text, &value), text);
+        TEST_ASSERT_TRUE(value);
+    }
+}
+
+void test_to_int() {
+    auto value = 0;
+    TEST_ASSERT_TRUE(to_int("0", &value));
+    TEST_ASSERT_EQUAL(0, value);
+    TEST_ASSERT_TRUE(to_int("-12", &value));
+    TEST_ASSERT_EQUAL(-12, value);
+    TEST_ASSERT_TRUE(to_int("+12", &value));
+    TEST_ASSERT_EQUAL(12, value);
+    TEST_ASSERT_TRUE(to_int("007", &value));
+    TEST_ASSERT_EQUAL(7, value);
+    TEST_ASSERT_TRUE(to_int("2147483647", &value));
+    TEST_ASSERT_EQUAL(INT_MAX, value);
+    TEST_ASSERT_TRUE(to_int("-2147483648", &value));
+    TEST_ASSERT_EQUAL(INT_MIN, value);
+    // Text needs not be null-terminated
+    TEST_ASSERT_TRUE(to_int(std::string_view{"123456", 3}, &value));
+    TEST_ASSERT_EQUAL(123, value);
+}
+
+void test_to_int_rejects_invalid() {
+    for (auto text : {"", "-", "+", "--1", "+-1", " 1", "1 ", "1.0", "1e3", "0x10",
+                      "12a", "a12", "2147483648", "-2147483649", "99999999999"}) {
+        check_int_rejected(text);
+    }
+}
+
+void test_to_float() {
+    check_float("0", 0.0f);
+    check_float("-12", -12.0f);
+    check_float("+12", 12.0f);
+    check_float("0.25", 0.25f);
+    check_float("1.", 1.0f);
+    check_float(".5", 0.5f);
+    check_float("-.5", -0.5f);
+    check_float("1e-7", 1e-7f);
+    check_float("2.5E3", 2500.0f);
+    check_float("2.5e+3", 2500.0f);
+    check_float("000123.4500", 123.45f);
+    check_float("3.4e38", 3.4e38f);
+    check_float("1e-38", 1e-38f);
+    // More digits than fit into the mantissa
+    check_float("123456789012345678901234567890", 1.2345679e29f);
+    check_float("0.000000000000000000000000000001234", 1.234e-30f);
+    // Zero needs no range check, any exponent
+    check_float("0e-100", 0.0f);
+    auto value = 1.0f;
+    TEST_ASSERT_TRUE(to_float("-0", &value));
+    TEST_ASSERT_TRUE(std::signbit(value));
+}
+
+void test_to_float_rejects_invalid() {
+    for (auto text : {"", "-", "+", ".", "-.", "e5", ".e5", "1e", "1e+", "1e1.5", "1..2",
+                      "1.2.3", " 1", "1 ", "\t1", "1\n", "1f", "0x1p3", "inf", "nan",
+                      "-inf", "--1", "1,5"}) {
+        check_float_rejected(text);
+    }
+}
+
+void test_to_float_rejects_out_of_range() {
+    for (auto text : {"3.5e38", "-3.5e38", "1e39", "1e1000", "1e1001",
+                      "1e-46", "-1e-46", "1e-50", "0.1e-45", "1e-1001"}) {
+        check_float_rejected(text);
+    }
+}
+
+/* Results must be close to the double precision conversion
+ */
+void test_to_float_random_against_strtod() {
+    auto rng = std::mt19937{12345};
+    auto mantissa = std::uniform_int_distribution<long>{-99999999, 99999999};
+    auto exponent = std::uniform_int_distribution<int>{-30, 30};
+    char text[32];
+    for (int i = 0; i < 100000; ++i) {
+        snprintf(text, sizeof(text), "%lde%d", mantissa(rng), exponent(rng));
+        const auto expected = static_cast<float>(std::strtod(text, nullptr));
+        auto value = 0.0f;
+        TEST_ASSERT_TRUE_MESSAGE(to_float(text, &value), text);
+        TEST_ASSERT_FLOAT_WITHIN(std::fabs(expected) * 4 * FLT_EPSILON, expected, value);
+    }
+}
+
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_to_bool);
+    RUN_TEST(test_to_int);
+    RUN_TEST(test_to_int_rejects_invalid);
+    RUN_TEST(test_to_float);
+    RUN_TEST(test_to_float_rejects_invalid);
+    RUN_TEST(test_to_float_rejects_out_of_range);
+    RUN_TEST(test_to_float_random_against_strtod);
+    return UNITY_END();
+}
@@ -0,0 +1,180 @@
+/* Host tests for the SequenceRunner and the SEQ_xxx step function macros,
+ * using the esp_timer stand-in with a simulated clock
+ *
+ * License: GPL v.3
+ */
+#include <array>
+#include <unity.h>
+
+#include "../../main/timed_sequence.cpp"
+
+/* Sequence recording the times of its actions. Optionally restarts
+ * itself from within its second action.
+ */
+class PulseSequence {
+public:
+    static constexpr size_t max_actions = 16;
+    SequenceRunner &runner;
+    size_t n_actions = 0;
+    std::array<int64_t, max_actions> action_times_us{};
+    std::array<int, max_actions> action_ids{};
+    bool restart_in_step_2 = false;
+    TimedSequence seq{
+        [](TimedSequence &seq, void *self) {
+            return static_cast<PulseSequence*>(self)->run(seq);},
+        this};
+
+    explicit PulseSequence(SequenceRunner &runner)
+        : runner{runner}
+    {}
+
+    void record(int id) {
+        TEST_ASSERT_TRUE(n_actions < max_actions);
+        action_times_us[n_actions] = esp_timer_get_time();
+        action_ids[n_actions] = id;
+        ++n_actions;
+    }
+
+    int64_t run(TimedSequence &seq) {
+        SEQ_BEGIN(seq);
+        record(1);
+        SEQ_DELAY_US(seq, 20);
+        record(2);
+        if (restart_in_step_2) {
+            restart_in_step_2 = false;
+            runner.start(this->seq);
+        }
+        SEQ_DELAY_MS(seq, 1);
+        record(3);
+        SEQ_END(seq);
+    }
+};
+
+/* Stand-in for the application task. The wake function only sets a flag,
+ * run_due() is called by the test, possibly later.
+ */
+struct WakeFlag {
+    uint32_t n_wakes = 0;
+    static void wake(void *self) {
+        ++static_cast<WakeFlag*>(self)->n_wakes;
+    }
+};
+
+/* Runs the due steps immediately when woken, i.e. without latency
+ */
+static void run_immediately(void *runner) {
+    static_cast<SequenceRunner*>(runner)->run_due(esp_timer_get_time());
+}
+
+
+void setUp(void) {
+    EspTimerStandIn::reset();
+}
+
+void tearDown(void) {}
+
+
+void test_steps_run_at_scheduled_times() {
+    auto runner = SequenceRunner{};
+    TEST_ASSERT_EQUAL(ESP_OK, runner.begin(run_immediately, &runner));
+    TEST_ASSERT_EQUAL(ESP_TIMER_ISR, EspTimerStandIn::timers[0].dispatch_method);
+    auto pulse = PulseSequence{runner};
+    EspTimerStandIn::advance_to(100);
+    TEST_ASSERT_EQUAL(ESP_OK, runner.start(pulse.seq));
+    TEST_ASSERT_TRUE(pulse.seq.is_active());
+    EspTimerStandIn::advance_to(10000);
+    TEST_ASSERT_EQUAL(3, pulse.n_actions);
+    TEST_ASSERT_EQUAL(100, pulse.action_times_us[0]);
+    TEST_ASSERT_EQUAL(120, pulse.action_times_us[1]);
+    TEST_ASSERT_EQUAL(1120, pulse.action_times_us[2]);
+    TEST_ASSERT_FALSE(pulse.seq.is_active());
+    TEST_ASSERT_EQUAL(0, EspTimerStandIn::n_armed());
+}
+
+void test_timer_only_wakes_task() {
+    auto runner = SequenceRunner{};
+    auto wake_flag = WakeFlag{};
+    runner.begin(WakeFlag::wake, &wake_flag);
+    auto pulse = PulseSequence{runner};
+    runner.start(pulse.seq);
+    EspTimerStandIn::advance_to(0);
+    TEST_ASSERT_EQUAL(1, wake_flag.n_wakes);
+    // Nothing is run from the timer itself
+    TEST_ASSERT_EQUAL(0, pulse.n_actions);
+    // Application task runs 5 µs late
+    TEST_ASSERT_EQUAL(20, runner.run_due(5));
+    TEST_ASSERT_EQUAL(1, pulse.n_actions);
+    EspTimerStandIn::advance_to(20);
+    TEST_ASSERT_EQUAL(2, wake_flag.n_wakes);
+    // Delays are relative to the scheduled time, not to the late wake-up
+    TEST_ASSERT_EQUAL(1020, runner.run_due(27));
+    TEST_ASSERT_EQUAL(TimedSequence::finished, runner.run_due(1020));
+    TEST_ASSERT_EQUAL(3, pulse.n_actions);
+}
+
+void test_restart_from_own_step() {
+    auto runner = SequenceRunner{};
+    runner.begin(run_immediately, &runner);
+    auto pulse = PulseSequence{runner};
+    pulse.restart_in_step_2 = true;
+    runner.start(pulse.seq);
+    EspTimerStandIn::advance_to(10000);
+    // Second step restarted the sequence, its result must be dropped
+    TEST_ASSERT_EQUAL(5, pulse.n_actions);
+    const int expected_ids[] = {1, 2, 1, 2, 3};
+    for (size_t i = 0; i < 5; ++i) {
+        TEST_ASSERT_EQUAL(expected_ids[i], pulse.action_ids[i]);
+    }
+    TEST_ASSERT_EQUAL(20, pulse.action_times_us[2]);
+    TEST_ASSERT_EQUAL(1040, pulse.action_times_us[4]);
+}
+
+void test_restart_and_stop_between_steps() {
+    auto runner = SequenceRunner{};
+    auto wake_flag = WakeFlag{};
+    runner.begin(WakeFlag::wake, &wake_flag);
+    auto pulse = PulseSequence{runner};
+    runner.start(pulse.seq);
+    runner.run_due(0);
+    runner.run_due(20);
+    EspTimerStandIn::advance_to(500);
+    runner.start(pulse.seq);
+    TEST_ASSERT_EQUAL(520, runner.run_due(500));
+    runner.stop(pulse.seq);
+    TEST_ASSERT_FALSE(pulse.seq.is_active());
+    TEST_ASSERT_EQUAL(TimedSequence::finished, runner.run_due(100000));
+    TEST_ASSERT_EQUAL(3, pulse.n_actions);
+    TEST_ASSERT_EQUAL(0, EspTimerStandIn::n_armed());
+}
+
+void test_concurrent_sequences_and_capacity() {
+    auto runner = SequenceRunner{};
+    runner.begin(run_immediately, &runner);
+    std::array<PulseSequence, SequenceRunner::max_sequences + 1> pulses{
+        PulseSequence{runner}, PulseSequence{runner}, PulseSequence{runner},
+        PulseSequence{runner}, PulseSequence{runner}, PulseSequence{runner},
+        PulseSequence{runner}, PulseSequence{runner}, PulseSequence{runner}};
+    for (size_t i = 0; i < SequenceRunner::max_sequences; ++i) {
+        EspTimerStandIn::advance_to(i * 5);
+        TEST_ASSERT_EQUAL(ESP_OK, runner.start(pulses[i].seq));
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, runner.start(pulses.back().seq));
+    EspTimerStandIn::advance_to(100000);
+    for (size_t i = 0; i < SequenceRunner::max_sequences; ++i) {
+        TEST_ASSERT_EQUAL(3, pulses[i].n_actions);
+        TEST_ASSERT_EQUAL(int64_t(i * 5 + 1020), pulses[i].action_times_us[2]);
+    }
+    // Slots are free again
+    TEST_ASSERT_EQUAL(ESP_OK, runner.start(pulses.back().seq));
+}
+
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_steps_run_at_scheduled_times);
+    RUN_TEST(test_timer_only_wakes_task);
+    RUN_TEST(test_restart_from_own_step);
+    RUN_TEST(test_restart_and_stop_between_steps);
+    RUN_TEST(test_concurrent_sequences_and_capacity);
+    return UNITY_END();
+}
@@ -5,6 +5,9 @@
  * Server-Sent Events (SSE) are used to update the application view
  * with state updates sent back from the remote hardware server.
  * 
+ * Alternatively, commands and state updates share one WebSocket connection,
+ * which avoids the overhead of a new HTTP request for every command.
+ * 
  * 2021-01-09 Ulrich Lukas
  * License: GPL v.3
  */
@@ -56,9 +59,11 @@ const sse_reconnect_timeout = 3000;
 /** Asynchronous and rate-limited HTTP GET request generator for single endpoint
  */
 class AsyncRequestGenerator {
-  constructor(endpoint) {
+  constructor(endpoint, batch_endpoint=undefined) {
     // HTTP GET API remote endpoint
     this._endpoint = endpoint;
+    // HTTP POST endpoint for several commands at once
+    this._batch_endpoint = batch_endpoint;
     // For assuring a minimum delay between HTTP requests
     this._rate_limit_active = false;
     // Last request string received which could not be sent due rate limit
@@ -117,6 +122,17 @@ class AsyncRequestGenerator {
     }
     await this.do_passive_get_request(req_str);
   }
+
+  /** Send several commands as one HTTP POST request, e.g.
+   * {set_frequency: 100, set_duty: 45, set_lead_dt: 300, set_lag_dt: 300}.
+   * These are applied together and are not subject to the rate limit.
+   * Returns the state version "cmd_seq" from which on the commands are
+   * applied, or undefined on error.
+   */
+  async send_cmds(cmds) {
+    const response = await do_json_request(this._batch_endpoint, cmds, 'POST');
+    return response.cmd_seq;
+  }
 }
 
 
@@ -190,6 +206,138 @@ class ServerSentEventHandler {
 }
 
 
+/** Commands and state updates on one persistent WebSocket connection.
+ *
+ * Command messages are the commands in the form of a "/cmd" query string,
+ * prefixed with a sequence number, e.g. "17?set_frequency=100&set_duty=45".
+ * These are applied together by the server and acknowledged with
+ * {"ack": 17, "cmd_seq": 1234} or rejected with {"nak": 17, "error": "..."}.
+ * All other messages are state telegrams as for the SSE "hw_app_state" event.
+ *
+ * Commands are sent without rate limit. When the socket is still busy
+ * sending, only the newest value of each command is kept and sent next.
+ *
+ * Same auto-reconnect and watchdog features as ServerSentEventHandler.
+ */
+class WebSocketHandler {
+  constructor(endpoint, callback, watchdog) {
+    this.endpoint = endpoint;
+    this.callback = callback;
+    this.watchdog = watchdog;
+    this.socket = null;
+    this.reconnect_enabled = true;
+    this.reconnect_timer_id = undefined;
+    // Sequence number of the last command message sent
+    this._seq = 0;
+    // Commands not sent yet as the socket was busy, name => value
+    this._pending_cmds = new Map();
+    this._retry_timer_id = undefined;
+    this.connect();
+  }
+
+  get connected() {
+    return this.socket != null && this.socket.readyState == WebSocket.OPEN;
+  }
+
+  /** Connect to the WebSocket server
+   */
+  connect() {
+    clearTimeout(this.reconnect_timer_id);
+    if (this.socket != null) {
+      console.log("Reconnecting WebSocket...");
+      this.socket.onclose = null;
+      this.socket.close();
+    } else {
+      console.log("Connecting WebSocket...");
+    }
+    const url = new URL(this.endpoint, window.location.href);
+    url.protocol = url.protocol === "https:" ? "wss:" : "ws:";
+    this.socket = new WebSocket(url);
+    this.socket.onopen = _ => {
+      console.log("WebSocket Connected");
+      this._send_pending();
+    };
+    this.socket.onmessage = e => this.on_message(e);
+    this.socket.onerror = err => console.error("WebSocket error: ", err);
+    this.socket.onclose = _ => this.on_close();
+  }
+
+  /** For debugging, disable reconnect feature cluttering the console.
+   * Also disables the app watchdog.
+   */
+  disable_reconnect_and_watchdog(bv) {
+    this.reconnect_enabled = !bv;
+    if (bv) {
+      clearTimeout(this.reconnect_timer_id);
+      this.watchdog.disable();
+    } else {
+      this.connect();
+      this.watchdog.enable();
+    }
+  }
+
+  /** Send name=value pair, value can be undefined for action commands
+   */
+  send_cmd(name, value) {
+    this.send_cmds({[name]: value});
+  }
+
+  /** Send several commands, these are applied together by the server
+   */
+  send_cmds(cmds) {
+    for (const [name, value] of Object.entries(cmds)) {
+      // Re-inserted so that the order of the commands is kept
+      this._pending_cmds.delete(name);
+      this._pending_cmds.set(name, value);
+    }
+    this._send_pending();
+  }
+
+  _send_pending() {
+    if (!this.connected || this._pending_cmds.size == 0) {
+      return;
+    }
+    if (this.socket.bufferedAmount > 0) {
+      // Retried when the previous message has been sent
+      if (this._retry_timer_id === undefined) {
+        this._retry_timer_id = setTimeout(() => {
+          this._retry_timer_id = undefined;
+          this._send_pending();
+        }, 5);
+      }
+      return;
+    }
+    const query = Array.from(this._pending_cmds,
+      ([name, value]) => value === undefined ? name : `${name}=${value}`
+    ).join("&");
+    this._pending_cmds.clear();
+    this._seq = (this._seq + 1) % 0x7fffffff;
+    this.socket.send(`${this._seq}?${query}`);
+  }
+
+  on_message(e) {
+    // Since app state update telegram is emitted
+    // periodically, we use this to reset the watchdog.
+    this.watchdog.reset();
+    const msg = JSON.parse(e.data);
+    if (msg.hasOwnProperty("nak")) {
+      console.error(`Command ${msg.nak} rejected: ${msg.error}`);
+    } else if (msg.hasOwnProperty("hw_fault")) {
+      console.warn("Hardware fault: ", msg.hw_fault);
+    } else if (!msg.hasOwnProperty("ack") && !msg.hasOwnProperty("error")) {
+      this.callback(msg);
+    }
+  }
+
+  on_close() {
+    console.error("WebSocket disconnected!");
+    if (this.reconnect_enabled) {
+      this.reconnect_timer_id = setTimeout(() => this.connect(), sse_reconnect_timeout);
+    }
+  }
+}
+
+
 /** Watchdog calls "on_timeout" callback with "true" argument when expired,
  * and calls with "false" when reset is needed
  */
@@ -231,5 +379,6 @@ export {
   do_json_request,
   AsyncRequestGenerator,
   ServerSentEventHandler,
+  WebSocketHandler,
   AppWatchdog
 };
\ No newline at end of file
@@ -0,0 +1,89 @@
+/** Decoder for the binary application state telegram
+ *
+ * The binary telegram is available on the "/state.bin" endpoint and as
+ * base64-encoded "hw_app_state_bin" events on the "/events_bin" SSE endpoint
+ * and as binary messages on the "/ws_bin" WebSocket.
+ * Keys, types and scales of the values are read from the "/state.schema"
+ * endpoint, so this does not need to be changed when the firmware adds values.
+ *
+ * Decoded values are in the same units as in the JSON telegram.
+ *
+ * License: GPL v.3
+ */
+
+const supported_format_version = 1;
+const header_len = 8;
+const type_sizes = {bool: 1, u8: 1, u32: 4, f32: 4};
+
+/** Fetch the telegram schema from the server
+ */
+async function fetch_state_schema(host = "") {
+  const response = await fetch(`${host}/state.schema`, {cache: 'no-cache'});
+  if (!response.ok) {
+    throw new Error("Could not fetch the state telegram schema");
+  }
+  const schema = await response.json();
+  if (schema.version !== supported_format_version) {
+    throw new Error(`Unsupported state telegram version: ${schema.version}`);
+  }
+  return schema;
+}
+
+/** Decode a binary telegram given as ArrayBuffer into an object.
+ * Throws when the telegram does not match the schema, e.g. after a firmware
+ * update. Fetch the schema again in this case.
+ */
+function decode_state_telegram(buffer, schema) {
+  const view = new DataView(buffer);
+  if (buffer.byteLength < header_len
+      || view.getUint8(0) !== schema.version
+      || view.getUint16(2, true) !== schema.fields.length
+      || view.getUint32(4, true) !== schema.hash
+      || buffer.byteLength !== schema.size) {
+    throw new Error("State telegram does not match the schema");
+  }
+  const state = {};
+  let pos = header_len;
+  for (const field of schema.fields) {
+    let value;
+    switch (field.type) {
+      case "bool": value = view.getUint8(pos) !== 0; break;
+      case "u8": value = view.getUint8(pos); break;
+      case "u32": value = view.getUint32(pos, true); break;
+      case "f32": value = view.getFloat32(pos, true); break;
+      default: throw new Error(`Unknown field type: ${field.type}`);
+    }
+    if (field.type === "f32" || (field.type === "u32" && field.scale !== 1)) {
+      const factor = 10 ** field.decimals;
+      value = Math.round(value * field.scale * factor) / factor;
+    }
+    state[field.key] = value;
+    pos += type_sizes[field.type];
+  }
+  return state;
+}
+
+/** Decode a base64-encoded binary telegram, i.e. the data of an SSE event
+ */
+function decode_state_telegram_base64(text, schema) {
+  const bytes = Uint8Array.from(atob(text), c => c.charCodeAt(0));
+  return decode_state_telegram(bytes.buffer, schema);
+}
+
+/** Fetch and decode the current state from the "/state.bin" endpoint
+ */
+async function fetch_state_bin(schema, host = "") {
+  const response = await fetch(`${host}/state.bin`, {cache: 'no-cache'});
+  if (!response.ok) {
+    throw new Error("Could not fetch the binary state telegram");
+  }
+  return decode_state_telegram(await response.arrayBuffer(), schema);
+}
+
+
+export {
+  fetch_state_schema,
+  decode_state_telegram,
+  decode_state_telegram_base64,
+  fetch_state_bin
+};
@@ -3,9 +3,14 @@ import { reactive, ref, watch } from "vue";
 import {
   AsyncRequestGenerator,
   ServerSentEventHandler,
+  WebSocketHandler,
   AppWatchdog
 } from "./async_requests_sse.js";
 
+// Send commands and receive state updates via one WebSocket connection.
+// When false, HTTP GET requests and Server-Sent Events are used.
+const use_websocket = true;
+
 export default function useApiStore() {
   const debug = ref(false);
   // Disable all controls by default, is enabled on watchdog reset
@@ -78,7 +83,23 @@ export default function useApiStore() {
     if (debug.value) {
       console.log(`Dispatching action "${name}" with value: ${value}`);
     }
-    request_generator.send_cmd(name, value);
+    if (use_websocket) {
+      event_handler.send_cmd(name, value);
+    } else {
+      request_generator.send_cmd(name, value);
+    }
+  }
+
+  // Several commands applied together, e.g. {set_frequency: 100, set_duty: 45}
+  function dispatch_actions(cmds) {
+    if (debug.value) {
+      console.log("Dispatching actions: ", cmds);
+    }
+    if (use_websocket) {
+      event_handler.send_cmds(cmds);
+    } else {
+      return request_generator.send_cmds(cmds);
+    }
   }
 
   function update_computed_values() {
@@ -93,12 +114,14 @@ export default function useApiStore() {
 
   update_computed_values();
 
-  const request_generator = new AsyncRequestGenerator("/cmd");
+  const request_generator = new AsyncRequestGenerator("/cmd", "/cmd_batch");
   const app_watchdog = new AppWatchdog(1500, val => disabled.value = val);
-  const sse_handler = new ServerSentEventHandler("/events", update_state, app_watchdog);
+  const event_handler = use_websocket
+    ? new WebSocketHandler("/ws", update_state, app_watchdog)
+    : new ServerSentEventHandler("/events", update_state, app_watchdog);
 
   // When debug set to boolean true value, enable UI and disable auto-reconnect
-  watch(debug, val => sse_handler.disable_reconnect_and_watchdog(val));
+  watch(debug, val => event_handler.disable_reconnect_and_watchdog(val));
 
   return {
     debug,
@@ -107,6 +130,7 @@ export default function useApiStore() {
     update_state,
     update_computed_values,
     dispatch_action,
-    sse_handler,
+    dispatch_actions,
+    event_handler,
   }
 }